@@ -0,0 +1,354 @@
+#include "send_epaper_data.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+struct epaper_async_job
+{
+    struct epaper_async_job *next;
+    int fd;
+    char *image_path;           // owned copy, NULL for a buffer job
+    const void *data;           // caller's buffer, valid until the callback
+    size_t size;
+    epaper_convert_options_t options;
+    char *cache_dir;            // owned copy behind options.cache_dir
+    epaper_async_callback_t callback;
+    void *user_data;
+    int status;
+    bool sending;               // guarded by the executor lock
+    bool cancelled;             // guarded by the executor lock
+};
+
+struct epaper_async
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_t *threads;
+    epaper_ctx_t **ctxs;
+    epaper_async_job_t **running;   // per worker, NULL when idle
+    int num_workers;
+    int event_fd;
+    epaper_async_job_t *queue;      // submission order
+    epaper_async_job_t *done;       // completion order, drained by dispatch
+    epaper_async_job_t **done_tail;
+    bool stop;
+};
+
+typedef struct
+{
+    epaper_async_t *async;
+    int index;
+} worker_arg_t;
+
+static void append_done_locked(epaper_async_t *async, epaper_async_job_t *job) {
+    job->next = NULL;
+    *async->done_tail = job;
+    async->done_tail = &job->next;
+}
+
+static void signal_completion(epaper_async_t *async) {
+    uint64_t one = 1;
+    if (write(async->event_fd, &one, sizeof(one)) < 0) {
+        // The counter only saturates after 2^64 - 1 unread completions
+    }
+}
+
+static bool fd_busy_locked(epaper_async_t *async, int fd) {
+    for (int i = 0; i < async->num_workers; i++) {
+        if (async->running[i] && async->running[i]->fd == fd) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The TX driver answers a second concurrent writer with EBUSY, so a device
+// already being served by one worker is skipped; its frames keep their order
+static epaper_async_job_t *take_job_locked(epaper_async_t *async) {
+    for (epaper_async_job_t **link = &async->queue; *link; link = &(*link)->next) {
+        epaper_async_job_t *job = *link;
+        if (!fd_busy_locked(async, job->fd)) {
+            *link = job->next;
+            job->next = NULL;
+            return job;
+        }
+    }
+    return NULL;
+}
+
+static int run_job(epaper_async_t *async, epaper_ctx_t *ctx, epaper_async_job_t *job) {
+    epaper_frame_t frame;
+    bool converted;
+
+    errno = 0;
+    if (job->image_path) {
+        converted = epaper_ctx_convert_image(ctx, job->image_path, &job->options, &frame);
+    } else {
+        converted = epaper_ctx_convert_encoded_buffer(ctx, job->data, job->size, &job->options,
+                                                      &frame);
+    }
+    if (!converted) {
+        return errno ? -errno : -EIO;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    bool cancelled = job->cancelled;
+    job->sending = !cancelled;
+    pthread_mutex_unlock(&async->lock);
+    if (cancelled) {
+        return -ECANCELED;
+    }
+
+    errno = 0;
+    if (!epaper_send_frame(job->fd, &frame)) {
+        return errno ? -errno : -EIO;
+    }
+    return 0;
+}
+
+static void *worker_thread(void *arg) {
+    worker_arg_t *worker = arg;
+    epaper_async_t *async = worker->async;
+    int index = worker->index;
+    free(worker);
+
+    pthread_mutex_lock(&async->lock);
+    for (;;) {
+        epaper_async_job_t *job = take_job_locked(async);
+        if (!job) {
+            if (async->stop) {
+                break;
+            }
+            pthread_cond_wait(&async->work_cond, &async->lock);
+            continue;
+        }
+
+        async->running[index] = job;
+        pthread_mutex_unlock(&async->lock);
+
+        int status = run_job(async, async->ctxs[index], job);
+
+        pthread_mutex_lock(&async->lock);
+        async->running[index] = NULL;
+        job->status = status;
+        job->sending = false;
+        append_done_locked(async, job);
+        // The device is free again, which may unblock a queued job for it
+        pthread_cond_broadcast(&async->work_cond);
+        pthread_mutex_unlock(&async->lock);
+        signal_completion(async);
+        pthread_mutex_lock(&async->lock);
+    }
+    pthread_mutex_unlock(&async->lock);
+    return NULL;
+}
+
+static void free_job(epaper_async_job_t *job) {
+    free(job->image_path);
+    free(job->cache_dir);
+    free(job);
+}
+
+epaper_async_t *epaper_async_create(int num_workers, int convert_threads) {
+    epaper_async_t *async = calloc(1, sizeof(*async));
+    if (!async) {
+        return NULL;
+    }
+    if (num_workers < 1) {
+        num_workers = 1;
+    }
+
+    async->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    async->threads = calloc(num_workers, sizeof(*async->threads));
+    async->ctxs = calloc(num_workers, sizeof(*async->ctxs));
+    async->running = calloc(num_workers, sizeof(*async->running));
+    async->done_tail = &async->done;
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->work_cond, NULL);
+    if (async->event_fd < 0 || !async->threads || !async->ctxs || !async->running) {
+        epaper_async_destroy(async);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        worker_arg_t *worker = malloc(sizeof(*worker));
+        async->ctxs[i] = epaper_ctx_create(convert_threads);
+        if (!worker || !async->ctxs[i]) {
+            free(worker);
+            epaper_async_destroy(async);
+            return NULL;
+        }
+        worker->async = async;
+        worker->index = i;
+        if (pthread_create(&async->threads[i], NULL, worker_thread, worker) != 0) {
+            free(worker);
+            epaper_async_destroy(async);
+            return NULL;
+        }
+        async->num_workers = i + 1;
+    }
+    return async;
+}
+
+void epaper_async_destroy(epaper_async_t *async) {
+    if (!async) {
+        return;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    while (async->queue) {
+        epaper_async_job_t *job = async->queue;
+        async->queue = job->next;
+        job->status = -ECANCELED;
+        append_done_locked(async, job);
+    }
+    async->stop = true;
+    pthread_cond_broadcast(&async->work_cond);
+    pthread_mutex_unlock(&async->lock);
+
+    for (int i = 0; i < async->num_workers; i++) {
+        pthread_join(async->threads[i], NULL);
+    }
+
+    // Every job still gets its callback, queued ones with ECANCELED
+    if (async->event_fd >= 0) {
+        epaper_async_dispatch(async);
+        close(async->event_fd);
+    }
+    if (async->ctxs) {
+        for (int i = 0; i < async->num_workers; i++) {
+            epaper_ctx_destroy(async->ctxs[i]);
+        }
+    }
+    pthread_cond_destroy(&async->work_cond);
+    pthread_mutex_destroy(&async->lock);
+    free(async->running);
+    free(async->ctxs);
+    free(async->threads);
+    free(async);
+}
+
+int epaper_async_fd(const epaper_async_t *async) {
+    return async->event_fd;
+}
+
+static epaper_async_job_t *submit(epaper_async_t *async, int fd, const char *image_path,
+                                  const void *data, size_t size,
+                                  const epaper_convert_options_t *options,
+                                  epaper_async_callback_t callback, void *user_data) {
+    epaper_async_job_t *job = calloc(1, sizeof(*job));
+    if (!job) {
+        return NULL;
+    }
+
+    job->fd = fd;
+    job->data = data;
+    job->size = size;
+    job->callback = callback;
+    job->user_data = user_data;
+    if (options) {
+        job->options = *options;
+    }
+    if (image_path && !(job->image_path = strdup(image_path))) {
+        free_job(job);
+        return NULL;
+    }
+    if (job->options.cache_dir) {
+        job->cache_dir = strdup(job->options.cache_dir);
+        if (!job->cache_dir) {
+            free_job(job);
+            return NULL;
+        }
+        job->options.cache_dir = job->cache_dir;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    if (async->stop) {
+        pthread_mutex_unlock(&async->lock);
+        free_job(job);
+        errno = ESHUTDOWN;
+        return NULL;
+    }
+    epaper_async_job_t **link = &async->queue;
+    while (*link) {
+        link = &(*link)->next;
+    }
+    *link = job;
+    pthread_cond_broadcast(&async->work_cond);
+    pthread_mutex_unlock(&async->lock);
+    return job;
+}
+
+epaper_async_job_t *epaper_send_async(epaper_async_t *async, int fd, const char *image_path,
+                                      const epaper_convert_options_t *options,
+                                      epaper_async_callback_t callback, void *user_data) {
+    return submit(async, fd, image_path, NULL, 0, options, callback, user_data);
+}
+
+epaper_async_job_t *epaper_send_encoded_buffer_async(epaper_async_t *async, int fd,
+                                                     const void *data, size_t size,
+                                                     const epaper_convert_options_t *options,
+                                                     epaper_async_callback_t callback,
+                                                     void *user_data) {
+    return submit(async, fd, NULL, data, size, options, callback, user_data);
+}
+
+bool epaper_async_cancel(epaper_async_t *async, epaper_async_job_t *job) {
+    bool cancelled = false;
+
+    pthread_mutex_lock(&async->lock);
+    for (epaper_async_job_t **link = &async->queue; *link; link = &(*link)->next) {
+        if (*link == job) {
+            *link = job->next;
+            job->status = -ECANCELED;
+            append_done_locked(async, job);
+            pthread_mutex_unlock(&async->lock);
+            signal_completion(async);
+            return true;
+        }
+    }
+
+    for (int i = 0; i < async->num_workers; i++) {
+        if (async->running[i] == job && !job->cancelled) {
+            job->cancelled = true;
+            cancelled = true;
+            // Still converting: the worker sees the flag before writing
+            if (job->sending) {
+                epaper_abort(job->fd);
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&async->lock);
+    return cancelled;
+}
+
+int epaper_async_dispatch(epaper_async_t *async) {
+    uint64_t count;
+    int dispatched = 0;
+
+    if (read(async->event_fd, &count, sizeof(count)) < 0) {
+        // EAGAIN: nothing signalled, but the done list is checked anyway
+    }
+
+    pthread_mutex_lock(&async->lock);
+    epaper_async_job_t *done = async->done;
+    async->done = NULL;
+    async->done_tail = &async->done;
+    pthread_mutex_unlock(&async->lock);
+
+    while (done) {
+        epaper_async_job_t *job = done;
+        done = job->next;
+        if (job->callback) {
+            job->callback(job, job->status, job->user_data);
+        }
+        free_job(job);
+        dispatched++;
+    }
+    return dispatched;
+}
@@ -0,0 +1,401 @@
+#define _GNU_SOURCE
+#include "send_epaper_data.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/resource.h>
+
+// Conversion pipeline benchmark behind "make bench". Per-stage times come
+// from the library's stats callback, so the stages are measured exactly as
+// epaper_send_*() runs them; "total" is the wall time of the whole call.
+
+#define DEFAULT_ITERATIONS 20
+#define MAX_ITERATIONS 1000
+#define MAX_IMAGES 16
+#define MAX_RESULTS 256
+#define TARGET_WIDTH 800
+#define TARGET_HEIGHT 480
+#define NUM_COLUMNS (EPAPER_STAGE_COUNT + 1)   // stages plus the end-to-end time
+#define TOTAL_COLUMN EPAPER_STAGE_COUNT
+
+static const char *const column_names[NUM_COLUMNS] = {
+    "decode", "resize", "gray", "dither", "pack", "write", "total"
+};
+
+typedef struct
+{
+    char name[128];
+    const char *stage;
+    uint64_t pixels;
+    double ns_per_pixel;
+    double mpix_per_s;
+    long peak_rss_kb;
+} bench_result_t;
+
+typedef struct
+{
+    int iterations;
+    int threads;
+    bench_result_t results[MAX_RESULTS];
+    int num_results;
+} bench_t;
+
+typedef struct
+{
+    double ns[MAX_ITERATIONS][NUM_COLUMNS];
+    uint64_t pixels[NUM_COLUMNS];
+    int iteration;
+} bench_case_t;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Pixels are counted at each stage's output: the decoded plane for decode,
+// the source for gray and the target for the stages after resize
+static void record_stages(const epaper_stage_stats_t *stats, void *user_data) {
+    bench_case_t *c = user_data;
+    static const uint64_t bytes_per_pixel[EPAPER_STAGE_COUNT] = { 1, 1, 1, sizeof(float), 0, 0 };
+
+    for (int s = 0; s < EPAPER_STAGE_COUNT; s++) {
+        c->ns[c->iteration][s] = stats->ns[s];
+        if (bytes_per_pixel[s] && stats->bytes[s]) {
+            c->pixels[s] = stats->bytes[s] / bytes_per_pixel[s];
+        }
+    }
+}
+
+static void add_results(bench_t *bench, const char *name, bench_case_t *c, uint64_t total_pixels) {
+    double samples[MAX_ITERATIONS];
+    long rss = peak_rss_kb();
+
+    c->pixels[EPAPER_STAGE_PACK] = (uint64_t)TARGET_WIDTH * TARGET_HEIGHT;
+    c->pixels[TOTAL_COLUMN] = total_pixels ? total_pixels : c->pixels[EPAPER_STAGE_DECODE];
+    for (int col = 0; col < NUM_COLUMNS; col++) {
+        if (col == EPAPER_STAGE_WRITE || !c->pixels[col] || bench->num_results == MAX_RESULTS) {
+            continue;
+        }
+        for (int i = 0; i < bench->iterations; i++) {
+            samples[i] = c->ns[i][col];
+        }
+        qsort(samples, bench->iterations, sizeof(double), compare_double);
+        double median = samples[bench->iterations / 2];
+        if (median <= 0) {
+            continue;
+        }
+
+        bench_result_t *r = &bench->results[bench->num_results++];
+        snprintf(r->name, sizeof(r->name), "%s", name);
+        r->stage = column_names[col];
+        r->pixels = c->pixels[col];
+        r->ns_per_pixel = median / c->pixels[col];
+        r->mpix_per_s = c->pixels[col] / median * 1e3;
+        r->peak_rss_kb = rss;
+    }
+}
+
+// One warm-up call grows the context's scratch memory, then every timed
+// iteration runs allocation-free as it does in a long-running sender
+static bool run_case(bench_t *bench, epaper_ctx_t *ctx, const char *name, bench_case_t *c,
+                     epaper_convert_options_t *options, const void *data, size_t size,
+                     int width, int height, uint64_t total_pixels) {
+    epaper_frame_t frame;
+
+    memset(c, 0, sizeof(*c));
+    options->stats_callback = record_stages;
+    options->stats_user_data = c;
+
+    for (int i = -1; i < bench->iterations; i++) {
+        c->iteration = i < 0 ? 0 : i;
+        double start = now_ns();
+        bool ok = width > 0
+            ? epaper_ctx_convert_pixels(ctx, data, width, height, (size_t)width * 3,
+                                        EPAPER_PIXEL_RGB24, options, &frame)
+            : epaper_ctx_convert_encoded_buffer(ctx, data, size, options, &frame);
+        if (!ok) {
+            fprintf(stderr, "Error: Conversion failed in case %s\n", name);
+            return false;
+        }
+        c->ns[c->iteration][TOTAL_COLUMN] = now_ns() - start;
+    }
+    add_results(bench, name, c, total_pixels);
+    return true;
+}
+
+// Gradient with pseudo-random noise, so thresholding and dithering see
+// realistic mixed content rather than flat areas
+static unsigned char *make_synthetic(int width, int height) {
+    unsigned char *pixels = malloc((size_t)width * height * 3);
+    uint32_t state = 0x12345678;
+
+    if (!pixels) {
+        return NULL;
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char *p = pixels + ((size_t)y * width + x) * 3;
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            int noise = (int)(state & 31) - 16;
+            int base = (x * 255 / width + y * 255 / height) / 2 + noise;
+            p[0] = (unsigned char)(base < 0 ? 0 : base > 255 ? 255 : base);
+            p[1] = (unsigned char)((x ^ y) & 0xFF);
+            p[2] = (unsigned char)(255 - p[0]);
+        }
+    }
+    return pixels;
+}
+
+static unsigned char *read_file(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    unsigned char *data = NULL;
+    long length;
+
+    if (!f) {
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) == 0 && (length = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = malloc(length);
+        if (data && fread(data, 1, length, f) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+        *size = length;
+    }
+    fclose(f);
+    return data;
+}
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static bool write_json(const bench_t *bench, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    // One result per line, which is also what the baseline reader relies on
+    fprintf(f, "{\n  \"iterations\": %d,\n  \"threads\": %d,\n  \"target\": \"%dx%d\",\n",
+            bench->iterations, bench->threads, TARGET_WIDTH, TARGET_HEIGHT);
+    fprintf(f, "  \"peak_rss_kb\": %ld,\n  \"results\": [\n", peak_rss_kb());
+    for (int i = 0; i < bench->num_results; i++) {
+        const bench_result_t *r = &bench->results[i];
+        fprintf(f, "    {\"case\": \"%s\", \"stage\": \"%s\", \"pixels\": %llu, "
+                "\"ns_per_pixel\": %.4f, \"mpix_per_s\": %.2f, \"peak_rss_kb\": %ld}%s\n",
+                r->name, r->stage, (unsigned long long)r->pixels, r->ns_per_pixel,
+                r->mpix_per_s, r->peak_rss_kb, i + 1 < bench->num_results ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+static void print_table(const bench_t *bench) {
+    fprintf(stderr, "%-40s %-8s %12s %12s %10s\n", "case", "stage", "ns/pixel", "MPix/s", "RSS KB");
+    for (int i = 0; i < bench->num_results; i++) {
+        const bench_result_t *r = &bench->results[i];
+        fprintf(stderr, "%-40s %-8s %12.3f %12.2f %10ld\n", r->name, r->stage, r->ns_per_pixel,
+                r->mpix_per_s, r->peak_rss_kb);
+    }
+}
+
+// Returns the number of results more than tolerance percent slower per
+// pixel than the same case and stage in the baseline file
+static int compare_baseline(const bench_t *bench, const char *path, double tolerance) {
+    char line[512];
+    int regressions = 0;
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(stderr, "\nAgainst %s (tolerance %.0f%%):\n", path, tolerance);
+    while (fgets(line, sizeof(line), f)) {
+        char name[128], stage[16];
+        double base_ns;
+        if (sscanf(line, " {\"case\": \"%127[^\"]\", \"stage\": \"%15[^\"]\", \"pixels\": %*u, "
+                         "\"ns_per_pixel\": %lf", name, stage, &base_ns) != 3) {
+            continue;
+        }
+        for (int i = 0; i < bench->num_results; i++) {
+            const bench_result_t *r = &bench->results[i];
+            if (strcmp(r->name, name) != 0 || strcmp(r->stage, stage) != 0) {
+                continue;
+            }
+            double change = (r->ns_per_pixel / base_ns - 1.0) * 100.0;
+            bool regressed = change > tolerance;
+            fprintf(stderr, "%-40s %-8s %+8.1f%%%s\n", name, stage, change,
+                    regressed ? "  REGRESSION" : "");
+            regressions += regressed;
+        }
+    }
+    fclose(f);
+    return regressions;
+}
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s [options] [image_file...]\n", prog_name);
+    printf("Options:\n");
+    printf("  -n, --iterations <n>    Timed iterations per case (default: %d)\n",
+           DEFAULT_ITERATIONS);
+    printf("  -j, --threads <n>       Conversion threads (default: 1)\n");
+    printf("  -o, --output <file>     JSON results (default: bench.json)\n");
+    printf("  -b, --baseline <file>   Compare with an earlier JSON result\n");
+    printf("  -t, --tolerance <pct>   Allowed slowdown per pixel (default: 10)\n");
+    printf("  --help                  Show this help\n");
+}
+
+int main(int argc, char *argv[]) {
+    static const int sizes[][2] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 } };
+    static bench_t bench;
+    static bench_case_t bench_case;
+    const char *output = "bench.json";
+    const char *baseline = NULL;
+    double tolerance = 10.0;
+    int exit_code = 0;
+
+    bench.iterations = DEFAULT_ITERATIONS;
+    bench.threads = 1;
+
+    static struct option long_options[] = {
+        {"iterations", required_argument, 0, 'n'},
+        {"threads",    required_argument, 0, 'j'},
+        {"output",     required_argument, 0, 'o'},
+        {"baseline",   required_argument, 0, 'b'},
+        {"tolerance",  required_argument, 0, 't'},
+        {"help",       no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:j:o:b:t:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'n':
+            bench.iterations = atoi(optarg);
+            if (bench.iterations < 1 || bench.iterations > MAX_ITERATIONS) {
+                fprintf(stderr, "Error: Iterations must be 1-%d\n", MAX_ITERATIONS);
+                return 1;
+            }
+            break;
+        case 'j':
+            bench.threads = atoi(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'b':
+            baseline = optarg;
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind > MAX_IMAGES) {
+        fprintf(stderr, "Error: At most %d images\n", MAX_IMAGES);
+        return 1;
+    }
+
+    // The library reports progress on stdout for every frame
+    if (!freopen("/dev/null", "w", stdout)) {
+        perror("freopen");
+        return 1;
+    }
+
+    epaper_ctx_t *ctx = epaper_ctx_create(bench.threads);
+    if (!ctx) {
+        fprintf(stderr, "Error: Failed to create conversion context\n");
+        return 1;
+    }
+
+    epaper_convert_options_t options = {
+        .target_width = TARGET_WIDTH,
+        .target_height = TARGET_HEIGHT,
+        .threshold = 128,
+        .resize_filter = EPAPER_FILTER_AUTO,
+        .scale_mode = EPAPER_SCALE_STRETCH
+    };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int width = sizes[s][0], height = sizes[s][1];
+        unsigned char *pixels = make_synthetic(width, height);
+        if (!pixels) {
+            exit_code = 1;
+            break;
+        }
+        for (int dither = 0; dither <= 1; dither++) {
+            char name[128];
+            snprintf(name, sizeof(name), "rgb24_%dx%d_%s", width, height,
+                     dither ? "dither" : "threshold");
+            options.use_dithering = dither;
+            if (!run_case(&bench, ctx, name, &bench_case, &options, pixels, 0, width, height,
+                          (uint64_t)width * height)) {
+                exit_code = 1;
+            }
+        }
+        free(pixels);
+    }
+
+    for (int i = optind; i < argc; i++) {
+        size_t size = 0;
+        unsigned char *data = read_file(argv[i], &size);
+        if (!data) {
+            fprintf(stderr, "Error: Cannot read %s\n", argv[i]);
+            exit_code = 1;
+            continue;
+        }
+        for (int dither = 0; dither <= 1; dither++) {
+            char name[128];
+            snprintf(name, sizeof(name), "%s_%s", base_name(argv[i]),
+                     dither ? "dither" : "threshold");
+            options.use_dithering = dither;
+            // End-to-end pixels are the decoded ones, taken from the decode stage
+            if (!run_case(&bench, ctx, name, &bench_case, &options, data, size, 0, 0, 0)) {
+                exit_code = 1;
+            }
+        }
+        free(data);
+    }
+    epaper_ctx_destroy(ctx);
+
+    print_table(&bench);
+    if (!write_json(&bench, output)) {
+        return 1;
+    }
+    fprintf(stderr, "\nResults written to %s\n", output);
+
+    if (baseline) {
+        int regressions = compare_baseline(&bench, baseline, tolerance);
+        if (regressions < 0) {
+            return 1;
+        }
+        if (regressions > 0) {
+            fprintf(stderr, "%d result(s) slower than the baseline\n", regressions);
+            return 2;
+        }
+    }
+    return exit_code;
+}
@@ -0,0 +1,384 @@
+#include "cache_epaper_frame.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CACHE_FORMAT_VERSION 1
+#define CACHE_SUFFIX ".frame"
+
+// Decoders differ in their rounding, so a frame cached by one build must not
+// be served to a build that would decode the source through another
+#ifdef EPAPER_USE_LIBJPEG
+#define CACHE_BACKEND_JPEG "+libjpeg"
+#else
+#define CACHE_BACKEND_JPEG ""
+#endif
+#ifdef EPAPER_USE_LIBSPNG
+#define CACHE_BACKEND_PNG "+libspng"
+#else
+#define CACHE_BACKEND_PNG ""
+#endif
+#define CACHE_BACKEND_ID "stb_image" CACHE_BACKEND_JPEG CACHE_BACKEND_PNG
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+typedef struct
+{
+    char name[64];
+    struct timespec mtime;
+    off_t size;
+} cache_entry_t;
+
+// Running size of one cache directory, taken by a full scan the first time
+// the directory is stored into and kept up to date by each store after that
+typedef struct cache_usage
+{
+    struct cache_usage *next;
+    size_t total;
+    char dir[];
+} cache_usage_t;
+
+static unsigned int tmp_sequence;
+static cache_usage_t *usage_list;
+static pthread_mutex_t usage_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+// XXH64: hashes several GB/s, so keying a multi-megabyte source costs far
+// less than decoding it
+static uint64_t xxh64(const void *input, size_t len, uint64_t seed) {
+    const unsigned char *p = input;
+    const unsigned char *end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        const unsigned char *limit = end - 32;
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        do {
+            v1 = xxh64_round(v1, read64(p));
+            v2 = xxh64_round(v2, read64(p + 8));
+            v3 = xxh64_round(v3, read64(p + 16));
+            v4 = xxh64_round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+
+    h += (uint64_t)len;
+
+    while (p + 8 <= end) {
+        h ^= xxh64_round(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t epaper_cache_key(const void *source, size_t source_size,
+                          const epaper_convert_options_t *options) {
+    // Only fields that change the packed output take part in the key
+    int32_t fields[10] = {
+        CACHE_FORMAT_VERSION, 0, 0, 0, 0, 128, EPAPER_FILTER_AUTO, EPAPER_SCALE_STRETCH, 0, 0
+    };
+    fields[9] = (int32_t)xxh64(CACHE_BACKEND_ID, sizeof(CACHE_BACKEND_ID) - 1, 0);
+    if (options) {
+        fields[1] = options->target_width;
+        fields[2] = options->target_height;
+        fields[3] = options->use_dithering;
+        fields[4] = options->invert_colors;
+        fields[5] = options->threshold;
+        fields[6] = options->resize_filter;
+        fields[7] = options->scale_mode;
+        fields[8] = options->letterbox_black;
+    }
+    return xxh64(fields, sizeof(fields), xxh64(source, source_size, 0));
+}
+
+bool epaper_cache_key_file(const char *image_path, const epaper_convert_options_t *options,
+                           uint64_t *key) {
+    int fd = open(image_path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    *key = epaper_cache_key(map, st.st_size, options);
+    munmap(map, st.st_size);
+    return true;
+}
+
+static void entry_path(char *path, size_t len, const char *cache_dir, uint64_t key) {
+    snprintf(path, len, "%s/%016llx" CACHE_SUFFIX, cache_dir, (unsigned long long)key);
+}
+
+bool epaper_cache_lookup(const char *cache_dir, uint64_t key, epaper_cached_frame_t *frame) {
+    char path[4096];
+    struct stat st;
+
+    memset(frame, 0, sizeof(*frame));
+    entry_path(path, sizeof(path), cache_dir, key);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(image_header_t)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    image_header_t header;
+    memcpy(&header, map, sizeof(header));
+    if (header.data_length != st.st_size - sizeof(header)) {
+        munmap(map, st.st_size);
+        close(fd);
+        unlink(path);
+        return false;
+    }
+
+    // Hits refresh the mtime, which is what LRU eviction orders by
+    futimens(fd, NULL);
+    close(fd);
+
+    frame->data = map;
+    frame->size = st.st_size;
+    return true;
+}
+
+void epaper_cache_release(epaper_cached_frame_t *frame) {
+    if (frame && frame->data) {
+        munmap((void *)frame->data, frame->size);
+        frame->data = NULL;
+        frame->size = 0;
+    }
+}
+
+static int compare_entry_age(const void *a, const void *b) {
+    const cache_entry_t *ea = a, *eb = b;
+    if (ea->mtime.tv_sec != eb->mtime.tv_sec) {
+        return ea->mtime.tv_sec < eb->mtime.tv_sec ? -1 : 1;
+    }
+    if (ea->mtime.tv_nsec != eb->mtime.tv_nsec) {
+        return ea->mtime.tv_nsec < eb->mtime.tv_nsec ? -1 : 1;
+    }
+    return strcmp(ea->name, eb->name);
+}
+
+// Scans the directory, and if it holds more than max_bytes removes the least
+// recently used entries until it is down to low_bytes. Returns what is left.
+static size_t scan_entries(const char *cache_dir, size_t max_bytes, size_t low_bytes) {
+    DIR *dir = opendir(cache_dir);
+    if (!dir) {
+        return 0;
+    }
+
+    cache_entry_t *entries = NULL;
+    size_t count = 0, capacity = 0;
+    size_t total = 0;
+    struct dirent *de;
+
+    while ((de = readdir(dir)) != NULL) {
+        size_t name_len = strlen(de->d_name);
+        size_t suffix_len = strlen(CACHE_SUFFIX);
+        if (name_len <= suffix_len || name_len >= sizeof(entries->name) ||
+            strcmp(de->d_name + name_len - suffix_len, CACHE_SUFFIX) != 0) {
+            continue;
+        }
+
+        struct stat st;
+        if (fstatat(dirfd(dir), de->d_name, &st, 0) < 0) {
+            continue;
+        }
+
+        if (count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 64;
+            cache_entry_t *grown = realloc(entries, new_capacity * sizeof(*entries));
+            if (!grown) break;
+            entries = grown;
+            capacity = new_capacity;
+        }
+        strcpy(entries[count].name, de->d_name);
+        entries[count].mtime = st.st_mtim;
+        entries[count].size = st.st_size;
+        total += st.st_size;
+        count++;
+    }
+
+    if (total > max_bytes) {
+        qsort(entries, count, sizeof(*entries), compare_entry_age);
+        for (size_t i = 0; i < count && total > low_bytes; i++) {
+            if (unlinkat(dirfd(dir), entries[i].name, 0) == 0) {
+                total -= entries[i].size;
+            }
+        }
+    }
+
+    closedir(dir);
+    free(entries);
+    return total;
+}
+
+// Adds a stored entry to the running total and only rescans the directory
+// once the total passes the cap. Eviction goes down to 3/4 of the cap so that
+// a full cache does not rescan on every store. Entries other processes add or
+// remove are picked up by the next rescan.
+static void account_store(const char *cache_dir, size_t added, size_t replaced,
+                          size_t max_bytes) {
+    cache_usage_t *usage;
+
+    pthread_mutex_lock(&usage_lock);
+    for (usage = usage_list; usage; usage = usage->next) {
+        if (strcmp(usage->dir, cache_dir) == 0) {
+            break;
+        }
+    }
+
+    if (usage) {
+        usage->total += added;
+        usage->total -= replaced < usage->total ? replaced : usage->total;
+        if (usage->total > max_bytes) {
+            usage->total = scan_entries(cache_dir, max_bytes, max_bytes - max_bytes / 4);
+        }
+    } else {
+        // The first scan already counts the entry just stored
+        size_t total = scan_entries(cache_dir, max_bytes, max_bytes - max_bytes / 4);
+        size_t len = strlen(cache_dir) + 1;
+        usage = malloc(sizeof(*usage) + len);
+        if (usage) {
+            memcpy(usage->dir, cache_dir, len);
+            usage->total = total;
+            usage->next = usage_list;
+            usage_list = usage;
+        }
+    }
+    pthread_mutex_unlock(&usage_lock);
+}
+
+bool epaper_cache_store(const char *cache_dir, uint64_t key, const unsigned char *data,
+                        size_t size, size_t max_bytes) {
+    char path[4096], tmp_path[4096 + 32];
+
+    if (max_bytes == 0) {
+        max_bytes = EPAPER_CACHE_DEFAULT_MAX_BYTES;
+    }
+    if (size > max_bytes) {
+        return false;
+    }
+
+    if (mkdir(cache_dir, 0755) < 0 && errno != EEXIST) {
+        return false;
+    }
+
+    entry_path(path, sizeof(path), cache_dir, key);
+    // Conversions may run on several threads, so the pid alone is not unique
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%d.%u", path, (int)getpid(),
+             __atomic_fetch_add(&tmp_sequence, 1, __ATOMIC_RELAXED));
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < size) {
+        ssize_t ret = write(fd, data + written, size - written);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += ret;
+    }
+    close(fd);
+
+    // An entry rewritten under the same key replaces the old one's size
+    struct stat old;
+    size_t replaced = stat(path, &old) == 0 ? (size_t)old.st_size : 0;
+
+    // Readers only ever see complete entries thanks to the atomic rename
+    if (written != size || rename(tmp_path, path) < 0) {
+        unlink(tmp_path);
+        return false;
+    }
+
+    account_store(cache_dir, size, replaced, max_bytes);
+    return true;
+}
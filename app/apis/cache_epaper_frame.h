@@ -0,0 +1,28 @@
+#ifndef CACHE_EPAPER_FRAME_H
+#define CACHE_EPAPER_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "send_epaper_data.h"
+
+#define EPAPER_CACHE_DEFAULT_MAX_BYTES (64UL * 1024 * 1024)
+
+// A cached frame is the exact header + packed 1-bit payload passed to write(),
+// mapped read-only from its entry file.
+typedef struct
+{
+    const unsigned char *data;
+    size_t size;
+} epaper_cached_frame_t;
+
+uint64_t epaper_cache_key(const void *source, size_t source_size,
+                          const epaper_convert_options_t *options);
+bool epaper_cache_key_file(const char *image_path, const epaper_convert_options_t *options,
+                           uint64_t *key);
+bool epaper_cache_lookup(const char *cache_dir, uint64_t key, epaper_cached_frame_t *frame);
+void epaper_cache_release(epaper_cached_frame_t *frame);
+bool epaper_cache_store(const char *cache_dir, uint64_t key, const unsigned char *data,
+                        size_t size, size_t max_bytes);
+
+#endif
@@ -0,0 +1,388 @@
+#include "decode_epaper_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#ifdef EPAPER_USE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+#ifdef EPAPER_USE_LIBSPNG
+#include <spng.h>
+#endif
+
+// Route stb_image's buffers through the hooks so that a decode running with
+// an arena bound allocates nothing from the heap
+#define STBI_MALLOC(size) epaper_arena_hook_malloc(size)
+#define STBI_REALLOC(ptr, size) epaper_arena_hook_realloc(ptr, size)
+#define STBI_FREE(ptr) epaper_arena_hook_free(ptr)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// Encoded input is either an open file or a caller-owned memory buffer
+typedef struct
+{
+    FILE *fp;
+    const unsigned char *data;
+    size_t size;
+} decode_source_t;
+
+#if defined(EPAPER_USE_LIBJPEG) || defined(EPAPER_USE_LIBSPNG)
+static void rewind_source(const decode_source_t *src) {
+    if (src->fp) {
+        rewind(src->fp);
+    }
+}
+#endif
+
+// stb_image has no P4 support; 1-bit inputs expand to a black/white plane
+static bool decode_packed(const epaper_packed_image_t *packed, epaper_decoded_image_t *image) {
+    image->pixels = epaper_arena_hook_malloc((size_t)packed->width * packed->height);
+    if (!image->pixels) {
+        return false;
+    }
+    epaper_packed_to_gray(packed, image->pixels);
+
+    image->width = packed->width;
+    image->height = packed->height;
+    image->channels = 1;
+    image->full_width = packed->width;
+    image->full_height = packed->height;
+    image->backend = "packed";
+    return true;
+}
+
+static bool decode_with_stb(const decode_source_t *src, int desired_channels,
+                            epaper_decoded_image_t *image) {
+    if (src->fp) {
+        image->pixels = stbi_load_from_file(src->fp, &image->width, &image->height,
+                                            &image->channels, desired_channels);
+    } else if (src->size <= 0x7FFFFFFF) {
+        image->pixels = stbi_load_from_memory(src->data, (int)src->size, &image->width,
+                                              &image->height, &image->channels, desired_channels);
+    }
+    if (!image->pixels) {
+        return false;
+    }
+    if (desired_channels) {
+        image->channels = desired_channels;
+    }
+    image->full_width = image->width;
+    image->full_height = image->height;
+    image->backend = "stb_image";
+    return true;
+}
+
+#ifdef EPAPER_USE_LIBJPEG
+typedef struct
+{
+    struct jpeg_error_mgr base;
+    jmp_buf escape;
+} jpeg_error_t;
+
+static void jpeg_error_exit(j_common_ptr cinfo) {
+    jpeg_error_t *err = (jpeg_error_t *)cinfo->err;
+    (*cinfo->err->output_message)(cinfo);
+    longjmp(err->escape, 1);
+}
+
+// libjpeg can only scale down by 1/2, 1/4 or 1/8 in the DCT domain
+static int pick_jpeg_denom(int width, int height, int target_width, int target_height) {
+    if (target_width <= 0 || target_height <= 0) {
+        return 1;
+    }
+    for (int denom = 8; denom > 1; denom /= 2) {
+        if ((width + denom - 1) / denom >= target_width &&
+            (height + denom - 1) / denom >= target_height) {
+            return denom;
+        }
+    }
+    return 1;
+}
+
+static bool decode_with_libjpeg(const decode_source_t *src, int target_width, int target_height,
+                                int desired_channels, epaper_decoded_image_t *image) {
+    struct jpeg_decompress_struct cinfo;
+    jpeg_error_t jerr;
+    unsigned char *volatile pixels = NULL;
+
+    cinfo.err = jpeg_std_error(&jerr.base);
+    jerr.base.error_exit = jpeg_error_exit;
+    if (setjmp(jerr.escape)) {
+        jpeg_destroy_decompress(&cinfo);
+        epaper_arena_hook_free(pixels);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    if (src->fp) {
+        jpeg_stdio_src(&cinfo, src->fp);
+    } else {
+        jpeg_mem_src(&cinfo, src->data, src->size);
+    }
+    jpeg_read_header(&cinfo, TRUE);
+
+    if (cinfo.num_components != 1 && cinfo.num_components != 3) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    // For YCbCr input JCS_GRAYSCALE just keeps the Y plane and skips colour conversion
+    cinfo.out_color_space = (cinfo.num_components == 1 || desired_channels == 1) ?
+                            JCS_GRAYSCALE : JCS_RGB;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = pick_jpeg_denom(cinfo.image_width, cinfo.image_height,
+                                        target_width, target_height);
+    cinfo.dct_method = JDCT_ISLOW;
+    jpeg_start_decompress(&cinfo);
+
+    size_t stride = (size_t)cinfo.output_width * cinfo.output_components;
+    pixels = epaper_arena_hook_malloc(stride * cinfo.output_height);
+    if (!pixels) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = pixels + stride * cinfo.output_scanline;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    image->pixels = pixels;
+    image->width = cinfo.output_width;
+    image->height = cinfo.output_height;
+    image->channels = cinfo.output_components;
+    image->full_width = cinfo.image_width;
+    image->full_height = cinfo.image_height;
+    image->backend = "libjpeg";
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+#endif
+
+#ifdef EPAPER_USE_LIBSPNG
+static void rgb_row_to_gray(const unsigned char *src, int src_channels,
+                            unsigned char *dst, int width) {
+    for (int x = 0; x < width; x++) {
+        const unsigned char *p = src + x * src_channels;
+        dst[x] = (unsigned char)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+}
+
+static bool decode_with_libspng(const decode_source_t *src, int desired_channels,
+                                epaper_decoded_image_t *image) {
+    struct spng_alloc alloc = {
+        .malloc_fn = epaper_arena_hook_malloc,
+        .realloc_fn = epaper_arena_hook_realloc,
+        .calloc_fn = epaper_arena_hook_calloc,
+        .free_fn = epaper_arena_hook_free
+    };
+    spng_ctx *ctx = spng_ctx_new2(&alloc, 0);
+    struct spng_ihdr ihdr;
+    unsigned char *pixels = NULL;
+    unsigned char *row = NULL;
+    bool success = false;
+
+    if (!ctx) {
+        return false;
+    }
+    spng_set_crc_action(ctx, SPNG_CRC_USE, SPNG_CRC_USE);
+
+    int ret = src->fp ? spng_set_png_file(ctx, src->fp) :
+                        spng_set_png_buffer(ctx, src->data, src->size);
+    if (ret || spng_get_ihdr(ctx, &ihdr)) {
+        goto out;
+    }
+
+    int fmt, channels;
+    struct spng_trns trns;
+    bool has_trns = spng_get_trns(ctx, &trns) == 0;
+    if (ihdr.color_type == SPNG_COLOR_TYPE_GRAYSCALE && ihdr.bit_depth <= 8 && !has_trns) {
+        fmt = SPNG_FMT_G8;
+        channels = 1;
+    } else if (ihdr.color_type == SPNG_COLOR_TYPE_TRUECOLOR && !has_trns) {
+        fmt = SPNG_FMT_RGB8;
+        channels = 3;
+    } else {
+        fmt = SPNG_FMT_RGBA8;
+        channels = 4;
+    }
+
+    size_t image_size;
+    if (spng_decoded_image_size(ctx, fmt, &image_size)) {
+        goto out;
+    }
+    size_t stride = image_size / ihdr.height;
+    int out_channels = desired_channels == 1 ? 1 : channels;
+    pixels = epaper_arena_hook_malloc((size_t)ihdr.width * ihdr.height * out_channels);
+    if (!pixels) {
+        goto out;
+    }
+
+    // Non-interlaced images are inflated one row at a time straight into the
+    // output (through a single row buffer when converting to luminance), so no
+    // second full-size scratch buffer is needed
+    if (ihdr.interlace_method == SPNG_INTERLACE_NONE) {
+        struct spng_row_info row_info;
+        bool convert = out_channels != channels;
+        if (convert) {
+            row = epaper_arena_hook_malloc(stride);
+            if (!row) goto out;
+        }
+        if (spng_decode_image(ctx, NULL, 0, fmt, SPNG_DECODE_PROGRESSIVE)) {
+            goto out;
+        }
+        do {
+            if (spng_get_row_info(ctx, &row_info)) break;
+            unsigned char *out_row = pixels + (size_t)ihdr.width * out_channels * row_info.row_num;
+            ret = spng_decode_row(ctx, convert ? row : out_row, stride);
+            if (convert && (ret == 0 || ret == SPNG_EOI)) {
+                rgb_row_to_gray(row, channels, out_row, ihdr.width);
+            }
+        } while (ret == 0);
+        if (ret != SPNG_EOI) {
+            goto out;
+        }
+    } else {
+        if (out_channels != channels) {
+            unsigned char *full = epaper_arena_hook_realloc(pixels, image_size);
+            if (!full) goto out;
+            pixels = full;
+        }
+        if (spng_decode_image(ctx, pixels, image_size, fmt, 0)) {
+            goto out;
+        }
+        if (out_channels != channels) {
+            // Gray output never overtakes the RGB input, so convert in place
+            for (uint32_t y = 0; y < ihdr.height; y++) {
+                rgb_row_to_gray(pixels + stride * y, channels, pixels + (size_t)ihdr.width * y,
+                                ihdr.width);
+            }
+        }
+    }
+    channels = out_channels;
+
+    image->pixels = pixels;
+    image->width = ihdr.width;
+    image->height = ihdr.height;
+    image->channels = channels;
+    image->full_width = ihdr.width;
+    image->full_height = ihdr.height;
+    image->backend = "libspng";
+    pixels = NULL;
+    success = true;
+
+out:
+    epaper_arena_hook_free(row);
+    epaper_arena_hook_free(pixels);
+    spng_ctx_free(ctx);
+    return success;
+}
+#endif
+
+static bool decode_source(const decode_source_t *src, const unsigned char *magic, size_t magic_len,
+                          int target_width, int target_height, int desired_channels,
+                          epaper_decoded_image_t *image) {
+    bool decoded = false;
+#ifdef EPAPER_USE_LIBJPEG
+    if (!decoded && magic_len >= 3 && magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF) {
+        decoded = decode_with_libjpeg(src, target_width, target_height, desired_channels, image);
+        if (!decoded) rewind_source(src);
+    }
+#endif
+#ifdef EPAPER_USE_LIBSPNG
+    if (!decoded && magic_len >= 8 && memcmp(magic, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        decoded = decode_with_libspng(src, desired_channels, image);
+        if (!decoded) rewind_source(src);
+    }
+#endif
+    (void)magic;
+    (void)magic_len;
+    (void)target_width;
+    (void)target_height;
+
+    if (!decoded) {
+        decoded = decode_with_stb(src, desired_channels, image);
+    }
+    return decoded;
+}
+
+static bool decode_file(const char *path, int target_width, int target_height,
+                        int desired_channels, epaper_decoded_image_t *image) {
+    unsigned char magic[8] = {0};
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    size_t magic_len = fread(magic, 1, sizeof(magic), fp);
+    rewind(fp);
+
+    decode_source_t src = { .fp = fp, .data = NULL, .size = 0 };
+    bool decoded = decode_source(&src, magic, magic_len, target_width, target_height,
+                                 desired_channels, image);
+
+    fclose(fp);
+    return decoded;
+}
+
+bool epaper_decode_image_file(const char *path, int target_width, int target_height,
+                              int desired_channels, epaper_arena_t *arena,
+                              epaper_decoded_image_t *image) {
+    memset(image, 0, sizeof(*image));
+
+    epaper_arena_bind(arena);
+    bool decoded = decode_file(path, target_width, target_height, desired_channels, image);
+    epaper_arena_bind(NULL);
+
+    image->arena = arena;
+    return decoded;
+}
+
+bool epaper_decode_image_memory(const unsigned char *data, size_t size, int target_width,
+                                int target_height, int desired_channels, epaper_arena_t *arena,
+                                epaper_decoded_image_t *image) {
+    memset(image, 0, sizeof(*image));
+
+    if (!data || size == 0) {
+        return false;
+    }
+
+    epaper_arena_bind(arena);
+    decode_source_t src = { .fp = NULL, .data = data, .size = size };
+    bool decoded = decode_source(&src, data, size < 8 ? size : 8, target_width, target_height,
+                                 desired_channels, image);
+    epaper_arena_bind(NULL);
+
+    image->arena = arena;
+    return decoded;
+}
+
+bool epaper_decode_packed_image(const epaper_packed_image_t *packed, epaper_arena_t *arena,
+                                epaper_decoded_image_t *image) {
+    memset(image, 0, sizeof(*image));
+
+    epaper_arena_bind(arena);
+    bool decoded = decode_packed(packed, image);
+    epaper_arena_bind(NULL);
+
+    image->arena = arena;
+    return decoded;
+}
+
+void epaper_free_decoded_image(epaper_decoded_image_t *image) {
+    if (image) {
+        // Arena-backed pixels go away with the next arena reset
+        if (image->pixels && !image->arena) {
+            free(image->pixels);
+        }
+        image->pixels = NULL;
+        image->arena = NULL;
+        image->width = 0;
+        image->height = 0;
+        image->channels = 0;
+    }
+}
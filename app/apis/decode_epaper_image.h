@@ -0,0 +1,42 @@
+#ifndef DECODE_EPAPER_IMAGE_H
+#define DECODE_EPAPER_IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "scratch_epaper_arena.h"
+#include "packed_epaper_image.h"
+
+typedef struct
+{
+    unsigned char *pixels;
+    int width;
+    int height;
+    int channels;
+    int full_width;
+    int full_height;
+    const char *backend;
+    epaper_arena_t *arena;      // owner of pixels, or NULL for the heap
+} epaper_decoded_image_t;
+
+// Decodes an image file to 8-bit interleaved pixels. When target_width and
+// target_height are positive, backends that can decode at reduced scale
+// (libjpeg DCT scaling) return the smallest size that still covers the target.
+// desired_channels is 0 for the native layout or 1 to have the decoder
+// produce a single luminance plane directly.
+// Falls back to stb_image for formats or builds without a faster backend.
+// With a non-NULL arena the pixels and the decoders' own working buffers are
+// carved from it; the pixels then stay valid until the arena is reset.
+bool epaper_decode_image_file(const char *path, int target_width, int target_height,
+                              int desired_channels, epaper_arena_t *arena,
+                              epaper_decoded_image_t *image);
+bool epaper_decode_image_memory(const unsigned char *data, size_t size, int target_width,
+                                int target_height, int desired_channels, epaper_arena_t *arena,
+                                epaper_decoded_image_t *image);
+// 1-bit PBM P4 and raw inputs are not recognised by the two calls above;
+// probe them once with epaper_packed_open()/epaper_packed_parse() and
+// expand the result here to a single black/white plane
+bool epaper_decode_packed_image(const epaper_packed_image_t *packed, epaper_arena_t *arena,
+                                epaper_decoded_image_t *image);
+void epaper_free_decoded_image(epaper_decoded_image_t *image);
+
+#endif
@@ -0,0 +1,914 @@
+#define _GNU_SOURCE
+#include "gpiod_epaper_link.h"
+#include "send_epaper_data.h"
+#include "transport_epaper_link.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define MAX_IMAGE_SIZE (1920 * 1080)    // as in the drivers
+
+void epaper_gpiod_config_init(epaper_gpiod_config_t *config) {
+    memset(config, 0, sizeof(*config));
+    config->rt_priority = 50;
+    config->cpu = -1;
+}
+
+bool epaper_gpiod_parse_lines(const char *spec, epaper_gpiod_config_t *config) {
+    const char *comma = strchr(spec, ',');
+    size_t chip_len = comma ? (size_t)(comma - spec) : 0;
+
+    if (chip_len == 0 || chip_len + sizeof("/dev/") > sizeof(config->chip)) {
+        return false;
+    }
+    snprintf(config->chip, sizeof(config->chip), "%s%.*s", spec[0] == '/' ? "" : "/dev/",
+             (int)chip_len, spec);
+
+    const char *p = comma + 1;
+    for (int pin = 0; pin < EPAPER_GPIOD_PINS; pin++) {
+        char *end;
+        unsigned long offset = strtoul(p, &end, 10);
+        if (end == p || offset > 1023 || *end != (pin + 1 < EPAPER_GPIOD_PINS ? ',' : '\0')) {
+            return false;
+        }
+        config->lines[pin] = (unsigned int)offset;
+        p = end + 1;
+    }
+    return true;
+}
+
+#ifdef EPAPER_USE_GPIOD
+
+#include <gpiod.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+// Protocol timing and limits, matching tx_driver.c / rx_driver.c
+#define DEFAULT_BIT_PERIOD_US 40
+#define START_STOP_HOLD_MS 5
+#define ACK_PULSE_MS 10
+#define TX_TIMEOUT_MS 2000
+#define RX_TIMEOUT_MS 5000
+#define MAX_RETRIES 3
+#define MAX_CHUNK_SIZE 1024
+#define BOND_HEADER_SIZE 16        // struct bond_header in both drivers, packed
+#define EVENT_BUFFER_SIZE 1024      // the kernel's cap for a request
+#define IDLE_POLL_MS 100            // how quickly the RX thread notices close()
+
+typedef enum
+{
+    RX_STATE_HEADER = 0,
+    RX_STATE_DATA,
+    RX_STATE_CRC32
+} rx_state_t;
+
+// Receive state machine, only touched by the RX thread
+typedef struct
+{
+    rx_state_t state;
+    bool receiving;
+    int data_level;             // data line as of the last event processed
+    int bit_count;
+    unsigned char current_byte;
+    unsigned char header_buf[BOND_HEADER_SIZE];
+    uint32_t byte_count;
+    unsigned char *block;       // where this block's bytes go
+    uint32_t block_room;
+    image_header_t header;
+    unsigned char *buffer;      // data followed by the received CRC32
+    uint32_t received;
+    uint64_t block_deadline_ns;
+    uint64_t pulse_release_ns;  // 0 when neither ACK nor NACK is raised
+} rx_machine_t;
+
+struct epaper_gpiod_link
+{
+    epaper_gpiod_config_t config;
+    bool is_tx;
+    struct gpiod_chip *chip;
+    struct gpiod_line_request *request;
+    struct gpiod_edge_event_buffer *events;
+    uint64_t bit_period_ns;
+    pthread_t thread;
+    bool thread_started;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        // CLOCK_MONOTONIC
+    bool stop;
+    epaper_gpiod_stats_t stats;
+    int abort_requested;        // __atomic, set under lock only while job_pending
+
+    // TX: one frame handed to the timing thread at a time
+    const unsigned char *job;
+    size_t job_size;
+    bool job_pending;
+    bool job_done;
+    int job_status;             // 0 or a negative errno
+
+    // RX: the last complete frame, header followed by data
+    rx_machine_t rx;
+    unsigned char *frame;
+    size_t frame_size;
+    uint64_t frame_seq;
+    uint64_t read_seq;
+};
+
+typedef struct
+{
+    enum gpiod_line_direction direction;
+    enum gpiod_line_edge edge;
+} pin_setup_t;
+
+static const pin_setup_t tx_setup[EPAPER_GPIOD_PINS] = {
+    [EPAPER_GPIOD_CLOCK]      = { GPIOD_LINE_DIRECTION_OUTPUT, GPIOD_LINE_EDGE_NONE },
+    [EPAPER_GPIOD_DATA]       = { GPIOD_LINE_DIRECTION_OUTPUT, GPIOD_LINE_EDGE_NONE },
+    [EPAPER_GPIOD_START_STOP] = { GPIOD_LINE_DIRECTION_OUTPUT, GPIOD_LINE_EDGE_NONE },
+    [EPAPER_GPIOD_ACK]        = { GPIOD_LINE_DIRECTION_INPUT, GPIOD_LINE_EDGE_RISING },
+    [EPAPER_GPIOD_NACK]       = { GPIOD_LINE_DIRECTION_INPUT, GPIOD_LINE_EDGE_RISING },
+};
+
+// Data edges are watched too, so each clock edge is decoded with the data
+// level at its own timestamp rather than whenever the event is read
+static const pin_setup_t rx_setup[EPAPER_GPIOD_PINS] = {
+    [EPAPER_GPIOD_CLOCK]      = { GPIOD_LINE_DIRECTION_INPUT, GPIOD_LINE_EDGE_RISING },
+    [EPAPER_GPIOD_DATA]       = { GPIOD_LINE_DIRECTION_INPUT, GPIOD_LINE_EDGE_BOTH },
+    [EPAPER_GPIOD_START_STOP] = { GPIOD_LINE_DIRECTION_INPUT, GPIOD_LINE_EDGE_BOTH },
+    [EPAPER_GPIOD_ACK]        = { GPIOD_LINE_DIRECTION_OUTPUT, GPIOD_LINE_EDGE_NONE },
+    [EPAPER_GPIOD_NACK]       = { GPIOD_LINE_DIRECTION_OUTPUT, GPIOD_LINE_EDGE_NONE },
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Spins instead of sleeping: nanosleep overshoots a 10 us phase by more
+// than the phase itself, even under SCHED_FIFO
+static void wait_until(uint64_t deadline_ns) {
+    while (now_ns() < deadline_ns) {
+    }
+}
+
+// The kernel's crc32(0, ...): reflected 0xEDB88320 without the pre- and
+// post-inversion zlib applies
+static uint32_t crc32_le(uint32_t crc, const unsigned char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return crc;
+}
+
+static uint16_t header_checksum(const image_header_t *h) {
+    return (uint16_t)(h->width + h->height + (h->data_length & 0xFFFF) + (h->data_length >> 16));
+}
+
+static int pin_of(const epaper_gpiod_link_t *link, unsigned int offset) {
+    for (int pin = 0; pin < EPAPER_GPIOD_PINS; pin++) {
+        if (link->config.lines[pin] == offset) return pin;
+    }
+    return -1;
+}
+
+static void set_pin(epaper_gpiod_link_t *link, int pin, int value) {
+    gpiod_line_request_set_value(link->request, link->config.lines[pin],
+                                 value ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+}
+
+static void note_event_lag(epaper_gpiod_link_t *link, uint64_t timestamp_ns) {
+    uint64_t now = now_ns();
+    if (now > timestamp_ns && now - timestamp_ns > link->stats.max_event_lag_ns) {
+        pthread_mutex_lock(&link->lock);
+        link->stats.max_event_lag_ns = now - timestamp_ns;
+        pthread_mutex_unlock(&link->lock);
+    }
+}
+
+static void count(epaper_gpiod_link_t *link, uint64_t *counter, uint64_t amount) {
+    pthread_mutex_lock(&link->lock);
+    *counter += amount;
+    pthread_mutex_unlock(&link->lock);
+}
+
+static bool request_lines(epaper_gpiod_link_t *link, const pin_setup_t *setup,
+                          const char *consumer) {
+    struct gpiod_line_settings *settings = gpiod_line_settings_new();
+    struct gpiod_line_config *line_config = gpiod_line_config_new();
+    struct gpiod_request_config *request_config = gpiod_request_config_new();
+    bool ok = settings && line_config && request_config;
+
+    for (int pin = 0; ok && pin < EPAPER_GPIOD_PINS; pin++) {
+        gpiod_line_settings_reset(settings);
+        gpiod_line_settings_set_direction(settings, setup[pin].direction);
+        if (setup[pin].direction == GPIOD_LINE_DIRECTION_OUTPUT) {
+            gpiod_line_settings_set_output_value(settings, GPIOD_LINE_VALUE_INACTIVE);
+        } else {
+            gpiod_line_settings_set_edge_detection(settings, setup[pin].edge);
+            gpiod_line_settings_set_event_clock(settings, GPIOD_LINE_CLOCK_MONOTONIC);
+        }
+        ok = gpiod_line_config_add_line_settings(line_config, &link->config.lines[pin], 1,
+                                                 settings) == 0;
+    }
+    if (ok) {
+        gpiod_request_config_set_consumer(request_config, consumer);
+        gpiod_request_config_set_event_buffer_size(request_config, EVENT_BUFFER_SIZE);
+        link->request = gpiod_chip_request_lines(link->chip, request_config, line_config);
+        ok = link->request != NULL;
+    }
+
+    gpiod_request_config_free(request_config);
+    gpiod_line_config_free(line_config);
+    gpiod_line_settings_free(settings);
+    return ok;
+}
+
+static int start_thread(epaper_gpiod_link_t *link, void *(*fn)(void *)) {
+    pthread_attr_t attr;
+    int ret;
+
+    pthread_attr_init(&attr);
+    if (link->config.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(link->config.cpu, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+    if (link->config.rt_priority > 0) {
+        struct sched_param param = { .sched_priority = link->config.rt_priority };
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+    }
+    ret = pthread_create(&link->thread, &attr, fn, link);
+    if (ret == EPERM && link->config.rt_priority > 0) {
+        fprintf(stderr, "Warning: No permission for SCHED_FIFO, GPIO timing thread runs "
+                        "without real-time priority\n");
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        ret = pthread_create(&link->thread, &attr, fn, link);
+    }
+    pthread_attr_destroy(&attr);
+    link->thread_started = ret == 0;
+    return ret;
+}
+
+static epaper_gpiod_link_t *open_link(const epaper_gpiod_config_t *config, bool is_tx) {
+    epaper_gpiod_link_t *link = calloc(1, sizeof(*link));
+    pthread_condattr_t cond_attr;
+
+    if (!link) return NULL;
+    link->config = *config;
+    link->is_tx = is_tx;
+    link->bit_period_ns = (config->bit_period_us > 0 ? config->bit_period_us :
+                           DEFAULT_BIT_PERIOD_US) * 1000ULL;
+    pthread_mutex_init(&link->lock, NULL);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&link->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    link->chip = gpiod_chip_open(config->chip);
+    if (!link->chip) {
+        fprintf(stderr, "Failed to open %s: %s\n", config->chip, strerror(errno));
+        epaper_gpiod_close(link);
+        return NULL;
+    }
+    if (!request_lines(link, is_tx ? tx_setup : rx_setup, is_tx ? "libepaper-tx" : "libepaper-rx")) {
+        fprintf(stderr, "Failed to request lines on %s: %s\n", config->chip, strerror(errno));
+        epaper_gpiod_close(link);
+        return NULL;
+    }
+    link->events = gpiod_edge_event_buffer_new(EVENT_BUFFER_SIZE);
+    if (!link->events) {
+        epaper_gpiod_close(link);
+        return NULL;
+    }
+    return link;
+}
+
+// ---- TX ----
+
+static void drain_events(epaper_gpiod_link_t *link) {
+    while (gpiod_line_request_wait_edge_events(link->request, 0) > 0) {
+        if (gpiod_line_request_read_edge_events(link->request, link->events,
+                                                EVENT_BUFFER_SIZE) <= 0) {
+            break;
+        }
+    }
+}
+
+static int wait_for_response(epaper_gpiod_link_t *link) {
+    uint64_t deadline = now_ns() + TX_TIMEOUT_MS * 1000000ULL;
+
+    for (;;) {
+        uint64_t now = now_ns();
+        if (now >= deadline) return -ETIMEDOUT;
+
+        int ret = gpiod_line_request_wait_edge_events(link->request, deadline - now);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret < 0) return -EIO;
+        if (ret == 0) return -ETIMEDOUT;
+
+        int n = gpiod_line_request_read_edge_events(link->request, link->events,
+                                                    EVENT_BUFFER_SIZE);
+        for (int i = 0; i < n; i++) {
+            struct gpiod_edge_event *event = gpiod_edge_event_buffer_get_event(link->events, i);
+            int pin = pin_of(link, gpiod_edge_event_get_line_offset(event));
+            note_event_lag(link, gpiod_edge_event_get_timestamp_ns(event));
+            if (pin == EPAPER_GPIOD_NACK) return -ECOMM;
+            if (pin == EPAPER_GPIOD_ACK) return 0;
+        }
+    }
+}
+
+// Clock and data change in one request each half of the bit: data is set
+// together with the falling clock a quarter period before the rising edge,
+// and held through the high phase, which gives the receiver the same
+// setup time and the same window after the edge as tx_driver's send_bit()
+static int send_block(epaper_gpiod_link_t *link, const unsigned char *data, size_t length) {
+    const unsigned int offsets[2] = {
+        link->config.lines[EPAPER_GPIOD_CLOCK], link->config.lines[EPAPER_GPIOD_DATA]
+    };
+    uint64_t setup_ns = link->bit_period_ns / 4;
+    uint64_t high_ns = link->bit_period_ns - setup_ns;
+    enum gpiod_line_value values[2];
+
+    drain_events(link);
+    set_pin(link, EPAPER_GPIOD_START_STOP, 1);
+    usleep(START_STOP_HOLD_MS * 1000);
+
+    uint64_t t = now_ns();
+    for (size_t i = 0; i < length; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            values[1] = (data[i] >> bit) & 1 ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+            values[0] = GPIOD_LINE_VALUE_INACTIVE;
+            gpiod_line_request_set_values_subset(link->request, 2, offsets, values);
+            t += setup_ns;
+            wait_until(t);
+            values[0] = GPIOD_LINE_VALUE_ACTIVE;
+            gpiod_line_request_set_values_subset(link->request, 2, offsets, values);
+            t += high_ns;
+            wait_until(t);
+        }
+    }
+    set_pin(link, EPAPER_GPIOD_CLOCK, 0);
+    wait_until(t + setup_ns);
+
+    set_pin(link, EPAPER_GPIOD_START_STOP, 0);
+    usleep(START_STOP_HOLD_MS * 1000);
+
+    int ret = wait_for_response(link);
+    if (ret == -ETIMEDOUT) {
+        count(link, &link->stats.timeouts, 1);
+    } else if (ret == -ECOMM) {
+        count(link, &link->stats.nacks, 1);
+    }
+    return ret;
+}
+
+// Mirrors tx_write(): the whole frame is restarted from the header on a
+// failed block, up to MAX_RETRIES times
+static int transmit_frame(epaper_gpiod_link_t *link, const unsigned char *frame, size_t size) {
+    image_header_t header;
+    int ret = 0;
+
+    if (size < sizeof(header) || size > MAX_IMAGE_SIZE + sizeof(header)) return -EINVAL;
+    memcpy(&header, frame, sizeof(header));
+    if (header.data_length != size - sizeof(header)) return -EINVAL;
+
+    header.header_checksum = header_checksum(&header);
+    const unsigned char *data = frame + sizeof(header);
+    uint32_t crc = crc32_le(0, data, header.data_length);
+
+    for (int retry = 0; retry < MAX_RETRIES; retry++) {
+        // Like tx_driver: checked before every header, and after a failed
+        // attempt the receiver is told to drop what it has
+        if (__atomic_exchange_n(&link->abort_requested, 0, __ATOMIC_RELAXED)) {
+            if (retry > 0) send_block(link, NULL, 0);
+            ret = -ECANCELED;
+            break;
+        }
+        if (retry > 0) count(link, &link->stats.retries, 1);
+
+        ret = send_block(link, (const unsigned char *)&header, sizeof(header));
+        if (ret == -ETIMEDOUT || ret == -ECOMM) continue;
+        if (ret) break;
+
+        for (uint32_t sent = 0; sent < header.data_length; sent += MAX_CHUNK_SIZE) {
+            if (__atomic_exchange_n(&link->abort_requested, 0, __ATOMIC_RELAXED)) {
+                send_block(link, NULL, 0);
+                ret = -ECANCELED;
+                break;
+            }
+            uint32_t chunk = header.data_length - sent;
+            ret = send_block(link, data + sent, chunk < MAX_CHUNK_SIZE ? chunk : MAX_CHUNK_SIZE);
+            if (ret) break;
+        }
+        if (ret == -ECANCELED) break;
+        if (ret) continue;
+
+        ret = send_block(link, (const unsigned char *)&crc, sizeof(crc));
+        if (ret == 0) break;
+        if (ret == -ECOMM) count(link, &link->stats.crc_failures, 1);
+    }
+
+    pthread_mutex_lock(&link->lock);
+    if (ret) {
+        link->stats.frames_failed++;
+    } else {
+        link->stats.frames++;
+        link->stats.bytes += size;
+    }
+    pthread_mutex_unlock(&link->lock);
+    return ret;
+}
+
+static void *tx_thread(void *arg) {
+    epaper_gpiod_link_t *link = arg;
+
+    pthread_mutex_lock(&link->lock);
+    for (;;) {
+        while (!link->job_pending && !link->stop) {
+            pthread_cond_wait(&link->cond, &link->lock);
+        }
+        if (link->stop) break;
+
+        const unsigned char *job = link->job;
+        size_t size = link->job_size;
+        pthread_mutex_unlock(&link->lock);
+        int status = transmit_frame(link, job, size);
+        pthread_mutex_lock(&link->lock);
+
+        // An abort only ever targets the frame that was on the wire
+        __atomic_store_n(&link->abort_requested, 0, __ATOMIC_RELAXED);
+        link->job_status = status;
+        link->job_pending = false;
+        link->job_done = true;
+        pthread_cond_broadcast(&link->cond);
+    }
+    pthread_mutex_unlock(&link->lock);
+    return NULL;
+}
+
+epaper_gpiod_link_t *epaper_gpiod_tx_open(const epaper_gpiod_config_t *config) {
+    epaper_gpiod_link_t *link = open_link(config, true);
+
+    if (link && start_thread(link, tx_thread) != 0) {
+        epaper_gpiod_close(link);
+        return NULL;
+    }
+    return link;
+}
+
+ssize_t epaper_gpiod_write(epaper_gpiod_link_t *link, const void *frame, size_t size) {
+    if (!link || !link->is_tx) {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock(&link->lock);
+    if (link->job_pending) {
+        pthread_mutex_unlock(&link->lock);
+        errno = EBUSY;
+        return -1;
+    }
+    link->job = frame;
+    link->job_size = size;
+    link->job_pending = true;
+    link->job_done = false;
+    pthread_cond_broadcast(&link->cond);
+    while (!link->job_done) {
+        pthread_cond_wait(&link->cond, &link->lock);
+    }
+    int status = link->job_status;
+    pthread_mutex_unlock(&link->lock);
+
+    if (status) {
+        errno = -status;
+        return -1;
+    }
+    return (ssize_t)size;
+}
+
+// Dropped when no frame is being sent, as with the driver
+bool epaper_gpiod_abort(epaper_gpiod_link_t *link) {
+    if (!link || !link->is_tx) return false;
+    pthread_mutex_lock(&link->lock);
+    if (link->job_pending) {
+        __atomic_store_n(&link->abort_requested, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&link->lock);
+    return true;
+}
+
+// ---- RX ----
+
+static void respond(epaper_gpiod_link_t *link, bool nack) {
+    rx_machine_t *rx = &link->rx;
+
+    // A response still being held is cut short rather than merged
+    if (rx->pulse_release_ns) {
+        set_pin(link, EPAPER_GPIOD_ACK, 0);
+        set_pin(link, EPAPER_GPIOD_NACK, 0);
+    }
+    if (nack) count(link, &link->stats.nacks, 1);
+    set_pin(link, nack ? EPAPER_GPIOD_NACK : EPAPER_GPIOD_ACK, 1);
+    rx->pulse_release_ns = now_ns() + ACK_PULSE_MS * 1000000ULL;
+}
+
+static void publish_frame(epaper_gpiod_link_t *link) {
+    rx_machine_t *rx = &link->rx;
+    size_t size = sizeof(rx->header) + rx->header.data_length;
+    unsigned char *frame = malloc(size);
+
+    if (!frame) return;
+    memcpy(frame, &rx->header, sizeof(rx->header));
+    memcpy(frame + sizeof(rx->header), rx->buffer, rx->header.data_length);
+
+    pthread_mutex_lock(&link->lock);
+    free(link->frame);
+    link->frame = frame;
+    link->frame_size = size;
+    link->frame_seq++;
+    link->stats.frames++;
+    link->stats.bytes += size;
+    pthread_cond_broadcast(&link->cond);
+    pthread_mutex_unlock(&link->lock);
+}
+
+static void start_block(epaper_gpiod_link_t *link, uint64_t now) {
+    rx_machine_t *rx = &link->rx;
+
+    rx->receiving = true;
+    rx->bit_count = 0;
+    rx->byte_count = 0;
+    rx->current_byte = 0;
+    rx->block = NULL;
+    rx->block_room = 0;
+    if (rx->state == RX_STATE_HEADER) {
+        rx->block = rx->header_buf;
+        rx->block_room = sizeof(rx->header_buf);
+    } else if (rx->state == RX_STATE_DATA && rx->buffer) {
+        rx->block = rx->buffer + rx->received;
+        rx->block_room = rx->header.data_length - rx->received;
+    } else if (rx->state == RX_STATE_CRC32 && rx->buffer) {
+        rx->block = rx->buffer + rx->header.data_length;
+        rx->block_room = sizeof(uint32_t);
+    }
+    rx->block_deadline_ns = now + RX_TIMEOUT_MS * 1000000ULL;
+}
+
+static void clock_edge(rx_machine_t *rx, uint64_t now) {
+    rx->current_byte |= rx->data_level << rx->bit_count;
+    if (++rx->bit_count < 8) return;
+
+    if (rx->byte_count < rx->block_room) {
+        rx->block[rx->byte_count] = rx->current_byte;
+    }
+    rx->byte_count++;
+    rx->bit_count = 0;
+    rx->current_byte = 0;
+    rx->block_deadline_ns = now + RX_TIMEOUT_MS * 1000000ULL;
+}
+
+// Same decisions as rx_driver.c's falling START/STOP edge, minus bonding
+static void end_block(epaper_gpiod_link_t *link) {
+    rx_machine_t *rx = &link->rx;
+
+    rx->receiving = false;
+    if (rx->byte_count == 0 && rx->bit_count == 0) {
+        rx->state = RX_STATE_HEADER;
+        rx->received = 0;
+        respond(link, false);
+        return;
+    }
+
+    if (rx->state == RX_STATE_HEADER) {
+        if (rx->byte_count != sizeof(rx->header)) {
+            // Includes bonded headers: bonding is only done by the kernel drivers
+            count(link, &link->stats.header_errors, 1);
+            respond(link, true);
+            return;
+        }
+        memcpy(&rx->header, rx->header_buf, sizeof(rx->header));
+        if (rx->header.header_checksum != header_checksum(&rx->header) ||
+            rx->header.data_length > MAX_IMAGE_SIZE) {
+            count(link, &link->stats.header_errors, 1);
+            respond(link, true);
+            return;
+        }
+        free(rx->buffer);
+        rx->buffer = malloc(rx->header.data_length + sizeof(uint32_t));
+        if (!rx->buffer) {
+            respond(link, true);
+            return;
+        }
+        respond(link, false);
+        rx->state = rx->header.data_length ? RX_STATE_DATA : RX_STATE_CRC32;
+        rx->received = 0;
+    } else if (rx->state == RX_STATE_DATA) {
+        rx->received += rx->byte_count;
+        if (rx->received > rx->header.data_length) {
+            respond(link, true);
+            rx->state = RX_STATE_HEADER;
+            return;
+        }
+        respond(link, false);
+        if (rx->received == rx->header.data_length) {
+            rx->state = RX_STATE_CRC32;
+        }
+    } else {
+        if (rx->byte_count != sizeof(uint32_t)) {
+            respond(link, true);
+            rx->state = RX_STATE_HEADER;
+            return;
+        }
+        uint32_t received_crc;
+        memcpy(&received_crc, rx->buffer + rx->header.data_length, sizeof(received_crc));
+        if (received_crc == crc32_le(0, rx->buffer, rx->header.data_length)) {
+            respond(link, false);
+            publish_frame(link);
+        } else {
+            count(link, &link->stats.crc_failures, 1);
+            respond(link, true);
+        }
+        rx->state = RX_STATE_HEADER;
+    }
+}
+
+static void handle_event(epaper_gpiod_link_t *link, struct gpiod_edge_event *event) {
+    rx_machine_t *rx = &link->rx;
+    int pin = pin_of(link, gpiod_edge_event_get_line_offset(event));
+    bool rising = gpiod_edge_event_get_event_type(event) == GPIOD_EDGE_EVENT_RISING_EDGE;
+    uint64_t timestamp = gpiod_edge_event_get_timestamp_ns(event);
+
+    note_event_lag(link, timestamp);
+    switch (pin) {
+    case EPAPER_GPIOD_DATA:
+        rx->data_level = rising;
+        break;
+    case EPAPER_GPIOD_CLOCK:
+        if (rx->receiving) clock_edge(rx, timestamp);
+        break;
+    case EPAPER_GPIOD_START_STOP:
+        if (rising) {
+            start_block(link, timestamp);
+        } else if (rx->receiving) {
+            end_block(link);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Sleeps in the kernel until an edge, a pending ACK/NACK release or a block
+// timeout, whichever comes first
+static void *rx_thread(void *arg) {
+    epaper_gpiod_link_t *link = arg;
+    rx_machine_t *rx = &link->rx;
+
+    rx->data_level = gpiod_line_request_get_value(link->request,
+                         link->config.lines[EPAPER_GPIOD_DATA]) == GPIOD_LINE_VALUE_ACTIVE;
+    for (;;) {
+        pthread_mutex_lock(&link->lock);
+        bool stop = link->stop;
+        pthread_mutex_unlock(&link->lock);
+        if (stop) break;
+
+        uint64_t now = now_ns();
+        uint64_t wake = now + IDLE_POLL_MS * 1000000ULL;
+        if (rx->pulse_release_ns && rx->pulse_release_ns < wake) wake = rx->pulse_release_ns;
+        if (rx->receiving && rx->block_deadline_ns < wake) wake = rx->block_deadline_ns;
+
+        int ret = wake > now ? gpiod_line_request_wait_edge_events(link->request, wake - now) : 0;
+        if (ret < 0 && errno != EINTR) {
+            fprintf(stderr, "GPIO event wait failed: %s\n", strerror(errno));
+            break;
+        }
+        if (ret > 0) {
+            int n = gpiod_line_request_read_edge_events(link->request, link->events,
+                                                        EVENT_BUFFER_SIZE);
+            for (int i = 0; i < n; i++) {
+                handle_event(link, gpiod_edge_event_buffer_get_event(link->events, i));
+            }
+        }
+
+        now = now_ns();
+        if (rx->pulse_release_ns && now >= rx->pulse_release_ns) {
+            set_pin(link, EPAPER_GPIOD_ACK, 0);
+            set_pin(link, EPAPER_GPIOD_NACK, 0);
+            rx->pulse_release_ns = 0;
+        }
+        // Like the driver's timeout timer: give up on the block, keep the state
+        if (rx->receiving && now >= rx->block_deadline_ns) {
+            rx->receiving = false;
+            count(link, &link->stats.timeouts, 1);
+            respond(link, true);
+        }
+    }
+    set_pin(link, EPAPER_GPIOD_ACK, 0);
+    set_pin(link, EPAPER_GPIOD_NACK, 0);
+    free(rx->buffer);
+    rx->buffer = NULL;
+    return NULL;
+}
+
+epaper_gpiod_link_t *epaper_gpiod_rx_open(const epaper_gpiod_config_t *config) {
+    epaper_gpiod_link_t *link = open_link(config, false);
+
+    if (link && start_thread(link, rx_thread) != 0) {
+        epaper_gpiod_close(link);
+        return NULL;
+    }
+    return link;
+}
+
+ssize_t epaper_gpiod_read(epaper_gpiod_link_t *link, void *buffer, size_t size, int timeout_ms) {
+    struct timespec deadline;
+
+    if (!link || link->is_tx) {
+        errno = EINVAL;
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if (timeout_ms >= 0) {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&link->lock);
+    while (link->frame_seq == link->read_seq) {
+        int ret = timeout_ms < 0 ? pthread_cond_wait(&link->cond, &link->lock) :
+                  pthread_cond_timedwait(&link->cond, &link->lock, &deadline);
+        if (ret == ETIMEDOUT) {
+            pthread_mutex_unlock(&link->lock);
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+    size_t copy = size < link->frame_size ? size : link->frame_size;
+    memcpy(buffer, link->frame, copy);
+    link->read_seq = link->frame_seq;
+    pthread_mutex_unlock(&link->lock);
+    return (ssize_t)copy;
+}
+
+void epaper_gpiod_get_stats(epaper_gpiod_link_t *link, epaper_gpiod_stats_t *stats) {
+    pthread_mutex_lock(&link->lock);
+    *stats = link->stats;
+    pthread_mutex_unlock(&link->lock);
+}
+
+void epaper_gpiod_close(epaper_gpiod_link_t *link) {
+    if (!link) return;
+    if (link->thread_started) {
+        pthread_mutex_lock(&link->lock);
+        link->stop = true;
+        pthread_cond_broadcast(&link->cond);
+        pthread_mutex_unlock(&link->lock);
+        pthread_join(link->thread, NULL);
+    }
+    if (link->events) gpiod_edge_event_buffer_free(link->events);
+    if (link->request) gpiod_line_request_release(link->request);
+    if (link->chip) gpiod_chip_close(link->chip);
+    pthread_cond_destroy(&link->cond);
+    pthread_mutex_destroy(&link->lock);
+    free(link->frame);
+    free(link);
+}
+
+#else
+
+// Built without libgpiod: the API stays linkable so callers can fall back
+// to the kernel drivers at run time
+
+epaper_gpiod_link_t *epaper_gpiod_tx_open(const epaper_gpiod_config_t *config) {
+    (void)config;
+    fprintf(stderr, "libepaper was built without GPIO character device support, rebuild with USE_GPIOD=1\n");
+    errno = ENOTSUP;
+    return NULL;
+}
+
+epaper_gpiod_link_t *epaper_gpiod_rx_open(const epaper_gpiod_config_t *config) {
+    return epaper_gpiod_tx_open(config);
+}
+
+void epaper_gpiod_close(epaper_gpiod_link_t *link) {
+    (void)link;
+}
+
+ssize_t epaper_gpiod_write(epaper_gpiod_link_t *link, const void *frame, size_t size) {
+    (void)link;
+    (void)frame;
+    (void)size;
+    errno = ENOTSUP;
+    return -1;
+}
+
+bool epaper_gpiod_abort(epaper_gpiod_link_t *link) {
+    (void)link;
+    return false;
+}
+
+ssize_t epaper_gpiod_read(epaper_gpiod_link_t *link, void *buffer, size_t size, int timeout_ms) {
+    (void)link;
+    (void)buffer;
+    (void)size;
+    (void)timeout_ms;
+    errno = ENOTSUP;
+    return -1;
+}
+
+void epaper_gpiod_get_stats(epaper_gpiod_link_t *link, epaper_gpiod_stats_t *stats) {
+    (void)link;
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif
+
+// ---- "gpiod:" transport ----
+
+// RX frames arrive whole; reads are served from the last one until it is
+// used up, then the next frame is waited for
+typedef struct
+{
+    epaper_gpiod_link_t *link;
+    unsigned char *frame;
+    size_t size;
+    size_t offset;
+} gpiod_transport_t;
+
+static bool gpiod_transport_open(epaper_transport_t *t, const char *address, bool receive) {
+    epaper_gpiod_config_t config;
+    gpiod_transport_t *gt;
+
+    epaper_gpiod_config_init(&config);
+    if (!epaper_gpiod_parse_lines(address, &config)) {
+        errno = EINVAL;
+        return false;
+    }
+    gt = calloc(1, sizeof(*gt));
+    if (!gt) return false;
+    gt->link = receive ? epaper_gpiod_rx_open(&config) : epaper_gpiod_tx_open(&config);
+    if (!gt->link) {
+        free(gt);
+        return false;
+    }
+    t->priv = gt;
+    return true;
+}
+
+static ssize_t gpiod_transport_write(epaper_transport_t *t, const void *frame, size_t size) {
+    return epaper_gpiod_write(((gpiod_transport_t *)t->priv)->link, frame, size);
+}
+
+static ssize_t gpiod_transport_read(epaper_transport_t *t, void *buffer, size_t size, int timeout_ms) {
+    gpiod_transport_t *gt = t->priv;
+
+    if (gt->offset == gt->size) {
+        if (!gt->frame) {
+            gt->frame = malloc(sizeof(image_header_t) + MAX_IMAGE_SIZE);
+            if (!gt->frame) return -1;
+        }
+        ssize_t n = epaper_gpiod_read(gt->link, gt->frame, sizeof(image_header_t) + MAX_IMAGE_SIZE,
+                                      timeout_ms);
+        if (n < 0) return -1;
+        gt->size = n;
+        gt->offset = 0;
+    }
+
+    size_t n = gt->size - gt->offset < size ? gt->size - gt->offset : size;
+    memcpy(buffer, gt->frame + gt->offset, n);
+    gt->offset += n;
+    return (ssize_t)n;
+}
+
+static bool gpiod_transport_abort(epaper_transport_t *t) {
+    return epaper_gpiod_abort(((gpiod_transport_t *)t->priv)->link);
+}
+
+static void gpiod_transport_close(epaper_transport_t *t) {
+    gpiod_transport_t *gt = t->priv;
+
+    epaper_gpiod_close(gt->link);
+    free(gt->frame);
+    free(gt);
+}
+
+const epaper_transport_ops_t epaper_transport_gpiod = {
+    .scheme = "gpiod",
+    .open = gpiod_transport_open,
+    .write = gpiod_transport_write,
+    .read = gpiod_transport_read,
+    .abort = gpiod_transport_abort,
+    .close = gpiod_transport_close,
+};
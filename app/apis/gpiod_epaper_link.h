@@ -0,0 +1,65 @@
+#ifndef GPIOD_EPAPER_LINK_H
+#define GPIOD_EPAPER_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// The 5-pin protocol in userspace on the GPIO character device (libgpiod
+// v2), as an alternative to tx_driver/rx_driver. A link writes and reads
+// the same bytes as /dev/epaper_txN and /dev/epaper_rxN (header followed by
+// the packed data) and interoperates with the kernel drivers on the other
+// end. Built with USE_GPIOD=1; otherwise every open fails with ENOTSUP.
+
+typedef enum
+{
+    EPAPER_GPIOD_CLOCK = 0,
+    EPAPER_GPIOD_DATA,
+    EPAPER_GPIOD_START_STOP,
+    EPAPER_GPIOD_ACK,
+    EPAPER_GPIOD_NACK,
+    EPAPER_GPIOD_PINS
+} epaper_gpiod_pin_t;
+
+typedef struct
+{
+    char chip[64];                          // "/dev/gpiochipN"; all five lines on this chip
+    unsigned int lines[EPAPER_GPIOD_PINS];  // line offsets by epaper_gpiod_pin_t
+    int bit_period_us;                      // 0 selects 40, the kernel driver's period
+    int rt_priority;                        // SCHED_FIFO priority of the timing thread, 0 for none
+    int cpu;                                // CPU to pin the timing thread to, -1 for none
+} epaper_gpiod_config_t;
+
+typedef struct
+{
+    uint64_t frames;
+    uint64_t frames_failed;     // TX only
+    uint64_t bytes;
+    uint64_t retries;           // TX only
+    uint64_t nacks;             // sent by RX, received by TX
+    uint64_t timeouts;
+    uint64_t crc_failures;
+    uint64_t header_errors;     // RX only
+    uint64_t max_event_lag_ns;  // longest time an edge event waited to be read
+} epaper_gpiod_stats_t;
+
+typedef struct epaper_gpiod_link epaper_gpiod_link_t;
+
+void epaper_gpiod_config_init(epaper_gpiod_config_t *config);
+// "chip,clock,data,start-stop,ack,nack", e.g. "gpiochip0,13,5,6,16,12"
+bool epaper_gpiod_parse_lines(const char *spec, epaper_gpiod_config_t *config);
+
+epaper_gpiod_link_t *epaper_gpiod_tx_open(const epaper_gpiod_config_t *config);
+epaper_gpiod_link_t *epaper_gpiod_rx_open(const epaper_gpiod_config_t *config);
+void epaper_gpiod_close(epaper_gpiod_link_t *link);
+
+// Same contract as write() on a TX device: one whole frame, returns size or
+// -1 with errno (ETIMEDOUT, ECOMM, ECANCELED, EINVAL, EBUSY)
+ssize_t epaper_gpiod_write(epaper_gpiod_link_t *link, const void *frame, size_t size);
+bool epaper_gpiod_abort(epaper_gpiod_link_t *link);  // from any thread, like EPAPER_TX_IOC_ABORT
+// Waits for a frame newer than the last one read; -1 with ETIMEDOUT after timeout_ms (< 0 waits forever)
+ssize_t epaper_gpiod_read(epaper_gpiod_link_t *link, void *buffer, size_t size, int timeout_ms);
+void epaper_gpiod_get_stats(epaper_gpiod_link_t *link, epaper_gpiod_stats_t *stats);
+
+#endif
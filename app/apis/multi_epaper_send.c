@@ -0,0 +1,112 @@
+#include "send_epaper_data.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+typedef struct
+{
+    epaper_multi_target_t *target;
+    epaper_frame_t frame;       // shared by every target showing the same image
+    pthread_t thread;
+    bool claimed;               // converted or failed, status owned by the send thread
+    bool started;
+} multi_link_t;
+
+static void *send_link(void *arg) {
+    multi_link_t *link = arg;
+
+    errno = 0;
+    if (epaper_send_frame(link->target->fd, &link->frame)) {
+        link->target->status = 0;
+    } else {
+        link->target->status = errno ? -errno : -EIO;
+    }
+    return NULL;
+}
+
+// Frames are copied out of the context so that the next distinct image can
+// be converted while the links already given theirs are transmitting
+static unsigned char *convert_copy(epaper_ctx_t *ctx, const char *image_path,
+                                   const epaper_convert_options_t *options,
+                                   epaper_frame_t *frame) {
+    epaper_frame_t converted;
+
+    if (!epaper_ctx_convert_image(ctx, image_path, options, &converted)) {
+        return NULL;
+    }
+    unsigned char *copy = malloc(converted.size);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, converted.data, converted.size);
+    *frame = converted;
+    frame->data = copy;
+    return copy;
+}
+
+int epaper_ctx_send_multi(epaper_ctx_t *ctx, epaper_multi_target_t *targets, int count,
+                          const epaper_convert_options_t *options) {
+    multi_link_t *links = calloc(count, sizeof(*links));
+    unsigned char **frames = calloc(count, sizeof(*frames));
+    int failed = 0;
+
+    if (!links || !frames) {
+        free(links);
+        free(frames);
+        for (int i = 0; i < count; i++) {
+            targets[i].status = -ENOMEM;
+        }
+        return count;
+    }
+
+    for (int i = 0; i < count; i++) {
+        targets[i].status = -EINPROGRESS;
+        links[i].target = &targets[i];
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (links[i].claimed) {
+            continue;  // already handled with an earlier target's image
+        }
+
+        epaper_frame_t frame;
+        errno = 0;
+        frames[i] = convert_copy(ctx, targets[i].image_path, options, &frame);
+        int status = frames[i] ? 0 : (errno ? -errno : -EIO);
+
+        for (int j = i; j < count; j++) {
+            if (links[j].claimed || strcmp(targets[j].image_path, targets[i].image_path) != 0) {
+                continue;
+            }
+            links[j].claimed = true;
+            if (status != 0) {
+                targets[j].status = status;
+                continue;
+            }
+            links[j].frame = frame;
+            if (pthread_create(&links[j].thread, NULL, send_link, &links[j]) == 0) {
+                links[j].started = true;
+            } else {
+                send_link(&links[j]);
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (links[i].started) {
+            pthread_join(links[i].thread, NULL);
+        }
+        if (targets[i].status != 0) {
+            failed++;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(frames[i]);
+    }
+    free(frames);
+    free(links);
+    return failed;
+}
@@ -0,0 +1,244 @@
+#include "packed_epaper_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <endian.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAX_PACKED_DIMENSION 10000
+
+static size_t packed_size(int width, int height) {
+    return ((size_t)width * height + 7) / 8;
+}
+
+static bool read_pbm_number(const unsigned char *data, size_t size, size_t *pos, int *value) {
+    // Whitespace and '#' comments may appear between header fields
+    while (*pos < size) {
+        if (data[*pos] == '#') {
+            while (*pos < size && data[*pos] != '\n') (*pos)++;
+        } else if (isspace(data[*pos])) {
+            (*pos)++;
+        } else {
+            break;
+        }
+    }
+
+    long v = 0;
+    size_t start = *pos;
+    while (*pos < size && isdigit(data[*pos]) && v <= MAX_PACKED_DIMENSION) {
+        v = v * 10 + (data[*pos] - '0');
+        (*pos)++;
+    }
+    if (*pos == start || v <= 0 || v > MAX_PACKED_DIMENSION) {
+        return false;
+    }
+    *value = (int)v;
+    return true;
+}
+
+static bool parse_pbm(const unsigned char *data, size_t size, epaper_packed_image_t *image) {
+    size_t pos = 2;
+    int width, height;
+
+    if (size < 3 || data[0] != 'P' || data[1] != '4' || !isspace(data[2])) {
+        return false;
+    }
+    if (!read_pbm_number(data, size, &pos, &width) ||
+        !read_pbm_number(data, size, &pos, &height)) {
+        return false;
+    }
+    if (pos >= size || !isspace(data[pos])) {
+        return false;
+    }
+    pos++;
+
+    size_t remaining = size - pos;
+    size_t row_bytes = ((size_t)width + 7) / 8;
+
+    if (remaining >= row_bytes * height) {
+        image->row_bytes = row_bytes;
+    } else if (remaining >= packed_size(width, height)) {
+        // epaper_save_image_pbm() writes the unpadded wire payload
+        image->row_bytes = 0;
+    } else {
+        return false;
+    }
+
+    image->bits = data + pos;
+    image->width = width;
+    image->height = height;
+    return true;
+}
+
+// The raw format has no magic, so the size must match the header exactly
+static bool raw_header_matches(const unsigned char *head, size_t size,
+                               uint32_t *width, uint32_t *height) {
+    uint32_t net_width, net_height;
+
+    if (size < 8) {
+        return false;
+    }
+    memcpy(&net_width, head, sizeof(net_width));
+    memcpy(&net_height, head + 4, sizeof(net_height));
+    *width = be32toh(net_width);
+    *height = be32toh(net_height);
+    return *width > 0 && *height > 0 && *width <= MAX_PACKED_DIMENSION &&
+           *height <= MAX_PACKED_DIMENSION && size == 8 + packed_size(*width, *height);
+}
+
+static bool parse_raw(const unsigned char *data, size_t size, epaper_packed_image_t *image) {
+    uint32_t width, height;
+
+    if (!raw_header_matches(data, size, &width, &height)) {
+        return false;
+    }
+
+    image->bits = data + 8;
+    image->width = (int)width;
+    image->height = (int)height;
+    image->row_bytes = 0;
+    return true;
+}
+
+bool epaper_packed_parse(const unsigned char *data, size_t size, epaper_packed_image_t *image) {
+    memset(image, 0, sizeof(*image));
+    return parse_pbm(data, size, image) || parse_raw(data, size, image);
+}
+
+bool epaper_packed_open(const char *path, epaper_packed_image_t *image) {
+    struct stat st;
+
+    memset(image, 0, sizeof(*image));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    // Only the first bytes are read before deciding to map, so probing an
+    // encoded image costs one small read
+    unsigned char head[8];
+    uint32_t width, height;
+    if (fstat(fd, &st) < 0 || st.st_size < 8 || pread(fd, head, sizeof(head), 0) != sizeof(head) ||
+        !((head[0] == 'P' && head[1] == '4' && isspace(head[2])) ||
+          raw_header_matches(head, st.st_size, &width, &height))) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    if (!epaper_packed_parse(map, st.st_size, image)) {
+        munmap(map, st.st_size);
+        return false;
+    }
+    image->map = map;
+    image->map_size = st.st_size;
+    return true;
+}
+
+void epaper_packed_close(epaper_packed_image_t *image) {
+    if (image && image->map) {
+        munmap(image->map, image->map_size);
+        image->map = NULL;
+        image->map_size = 0;
+        image->bits = NULL;
+    }
+}
+
+static inline uint64_t load_be64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return be64toh(v);
+}
+
+static inline void store_be64(unsigned char *p, uint64_t v) {
+    v = htobe64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+// ORs `bits` bits from a byte-aligned src into a zeroed dst starting at
+// bit offset dst_bit. Eight bytes move per step as one big-endian word.
+static void append_row_bits(const unsigned char *src, size_t bits, unsigned char *dst, size_t dst_bit) {
+    unsigned char *out = dst + dst_bit / 8;
+    int shift = dst_bit % 8;
+    size_t nbytes = (bits + 7) / 8;
+    int tail_bits = bits % 8;
+    size_t i = 0;
+
+    if (shift == 0) {
+        memcpy(out, src, nbytes);
+        if (tail_bits) out[nbytes - 1] &= (unsigned char)(0xFF << (8 - tail_bits));
+        return;
+    }
+
+    for (; i + 9 <= nbytes; i += 8) {
+        uint64_t v = load_be64(src + i);
+        store_be64(out + i, load_be64(out + i) | (v >> shift));
+        out[i + 8] = (unsigned char)(v << (8 - shift));
+    }
+
+    for (; i < nbytes; i++) {
+        unsigned char b = src[i];
+        int valid = 8;
+        if (i == nbytes - 1 && tail_bits) {
+            b &= (unsigned char)(0xFF << (8 - tail_bits));
+            valid = tail_bits;
+        }
+        out[i] |= b >> shift;
+        if (shift + valid > 8) {
+            out[i + 1] = (unsigned char)(b << (8 - shift));
+        }
+    }
+}
+
+void epaper_packed_repack(const epaper_packed_image_t *image, bool invert, unsigned char *dst) {
+    size_t total_bits = (size_t)image->width * image->height;
+    size_t size = packed_size(image->width, image->height);
+
+    if (image->row_bytes == 0 || image->row_bytes * 8 == (size_t)image->width) {
+        memcpy(dst, image->bits, size);
+    } else {
+        memset(dst, 0, size);
+        for (int y = 0; y < image->height; y++) {
+            append_row_bits(image->bits + (size_t)y * image->row_bytes, image->width,
+                            dst, (size_t)y * image->width);
+        }
+    }
+
+    if (invert) {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t v;
+            memcpy(&v, dst + i, sizeof(v));
+            v = ~v;
+            memcpy(dst + i, &v, sizeof(v));
+        }
+        for (; i < size; i++) {
+            dst[i] = ~dst[i];
+        }
+    }
+
+    if (total_bits % 8) {
+        dst[size - 1] &= (unsigned char)(0xFF << (8 - total_bits % 8));
+    }
+}
+
+void epaper_packed_to_gray(const epaper_packed_image_t *image, unsigned char *gray) {
+    for (int y = 0; y < image->height; y++) {
+        size_t bit = image->row_bytes ? (size_t)y * image->row_bytes * 8 : (size_t)y * image->width;
+        unsigned char *row = gray + (size_t)y * image->width;
+        for (int x = 0; x < image->width; x++, bit++) {
+            bool black = (image->bits[bit / 8] >> (7 - bit % 8)) & 1;
+            row[x] = black ? 0 : 255;
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef PACKED_EPAPER_IMAGE_H
+#define PACKED_EPAPER_IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A 1-bit image that is already in (or close to) the wire format: PBM P4 with
+// byte-padded rows, or the raw format written by epaper_save_image_raw().
+// Bits are MSB first and 1 means black, as in the protocol payload.
+typedef struct
+{
+    const unsigned char *bits;
+    int width;
+    int height;
+    size_t row_bytes;           // 0 when rows are packed back to back
+    void *map;                  // set when the image was mapped from a file
+    size_t map_size;
+} epaper_packed_image_t;
+
+bool epaper_packed_parse(const unsigned char *data, size_t size, epaper_packed_image_t *image);
+bool epaper_packed_open(const char *path, epaper_packed_image_t *image);
+void epaper_packed_close(epaper_packed_image_t *image);
+
+// Writes (width * height + 7) / 8 bytes of continuous MSB-first bits to dst
+void epaper_packed_repack(const epaper_packed_image_t *image, bool invert, unsigned char *dst);
+// Expands to one 8-bit plane, black = 0 and white = 255
+void epaper_packed_to_gray(const epaper_packed_image_t *image, unsigned char *gray);
+
+#endif
@@ -1,15 +1,15 @@
 #include "receive_epaper_data.h"
+#include "transport_epaper_link.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
 #include <arpa/inet.h>
-#include <poll.h>
 #include <errno.h>
 
 int epaper_rx_open(const char* device_path) {
-    int fd = open(device_path, O_RDONLY);
+    int fd = epaper_transport_open(device_path, true);
     if (fd < 0) {
         perror("Failed to open RX device");
     }
@@ -17,29 +17,21 @@ int epaper_rx_open(const char* device_path) {
 }
 
 void epaper_rx_close(int fd) {
-    if (fd >= 0) {
-        close(fd);
-    }
+    epaper_transport_close(fd);
 }
 
-static bool wait_for_data(int fd, int timeout_ms) {
-    struct pollfd pfd = {
-        .fd = fd,
-        .events = POLLIN,
-        .revents = 0
-    };
-    
-    int ret = poll(&pfd, 1, timeout_ms);
-    if (ret < 0) {
-        perror("Poll failed");
-        return false;
-    }
-    if (ret == 0) {
-        fprintf(stderr, "Timeout waiting for data\n");
-        return false;
+// Waits up to timeout_ms for each piece, like poll() before every read()
+static ssize_t read_some(int fd, void *buffer, size_t size, int timeout_ms) {
+    ssize_t bytes_read = epaper_transport_read(fd, buffer, size, timeout_ms);
+    
+    if (bytes_read < 0) {
+        if (errno == ETIMEDOUT) {
+            fprintf(stderr, "Timeout waiting for data\n");
+        } else {
+            perror("Read failed");
+        }
     }
-    
-    return (pfd.revents & POLLIN) != 0;
+    return bytes_read;
 }
 
 static bool read_exact(int fd, void *buffer, size_t size, int timeout_ms) {
@@ -47,16 +39,8 @@ static bool read_exact(int fd, void *buffer, size_t size, int timeout_ms) {
     size_t total_read = 0;
     
     while (total_read < size) {
-        if (!wait_for_data(fd, timeout_ms)) {
-            return false;
-        }
-        
-        ssize_t bytes_read = read(fd, buf + total_read, size - total_read);
+        ssize_t bytes_read = read_some(fd, buf + total_read, size - total_read, timeout_ms);
         if (bytes_read < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue;
-            }
-            perror("Read failed");
             return false;
         }
         if (bytes_read == 0) {
@@ -130,18 +114,9 @@ bool epaper_receive_image_advanced(int fd, epaper_image_t *image, const epaper_r
     
     size_t received = 0;
     while (received < image->data_size) {
-        if (!wait_for_data(fd, timeout)) {
-            free(image->data);
-            image->data = NULL;
-            return false;
-        }
-        
-        ssize_t bytes_read = read(fd, image->data + received, image->data_size - received);
+        ssize_t bytes_read = read_some(fd, image->data + received, image->data_size - received,
+                                       timeout);
         if (bytes_read < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue;
-            }
-            perror("Read failed");
             free(image->data);
             image->data = NULL;
             return false;
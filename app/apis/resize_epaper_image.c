@@ -0,0 +1,383 @@
+#include "resize_epaper_image.h"
+#include "scratch_epaper_arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESIZE_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RESIZE_USE_SSE2 1
+#endif
+
+#define WEIGHT_BITS 14
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+#define MAX_RESIZE_THREADS 8
+#define MIN_ROWS_PER_BAND 32
+
+// Per-output-coordinate filter taps in 2.14 fixed point
+typedef struct
+{
+    int *start;
+    int *count;
+    int16_t *weights;
+    int max_taps;
+} weight_table_t;
+
+typedef struct
+{
+    const unsigned char *src;
+    size_t src_stride;
+    int src_w;
+    int channels;
+    unsigned char *dst;
+    size_t dst_stride;
+    int dst_w;
+    const weight_table_t *x_table;
+    const weight_table_t *y_table;
+    int y_begin;
+    int y_end;
+    unsigned char *ring;
+    const unsigned char **rows;
+} resize_band_t;
+
+static double filter_box(double x) {
+    return (x >= -0.5 && x < 0.5) ? 1.0 : 0.0;
+}
+
+static double filter_triangle(double x) {
+    x = fabs(x);
+    return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+static double sinc(double x) {
+    if (x == 0.0) return 1.0;
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+static double filter_lanczos3(double x) {
+    if (x <= -3.0 || x >= 3.0) return 0.0;
+    return sinc(x) * sinc(x / 3.0);
+}
+
+static bool build_weight_table(weight_table_t *t, int src_len, int dst_len,
+                               epaper_resize_filter_t filter, epaper_arena_t *arena) {
+    double scale = (double)src_len / dst_len;
+    double filter_scale = scale > 1.0 ? scale : 1.0;
+    double (*kernel)(double) = NULL;
+    double support = 0.0;
+
+    if (filter == EPAPER_FILTER_AUTO) {
+        filter = scale > 1.0 ? EPAPER_FILTER_BOX : EPAPER_FILTER_BILINEAR;
+    }
+
+    switch (filter) {
+    case EPAPER_FILTER_BOX:
+        kernel = filter_box;
+        support = 0.5;
+        break;
+    case EPAPER_FILTER_BILINEAR:
+        kernel = filter_triangle;
+        support = 1.0;
+        break;
+    case EPAPER_FILTER_LANCZOS3:
+        kernel = filter_lanczos3;
+        support = 3.0;
+        break;
+    default:
+        break;
+    }
+
+    double radius = support * filter_scale;
+    t->max_taps = kernel ? (int)ceil(radius * 2.0) + 2 : 1;
+    t->start = epaper_arena_alloc(arena, dst_len * sizeof(int));
+    t->count = epaper_arena_alloc(arena, dst_len * sizeof(int));
+    t->weights = epaper_arena_alloc(arena, (size_t)dst_len * t->max_taps * sizeof(int16_t));
+    double *tmp = epaper_arena_alloc(arena, t->max_taps * sizeof(double));
+    if (!t->start || !t->count || !t->weights || !tmp) {
+        return false;
+    }
+
+    for (int i = 0; i < dst_len; i++) {
+        double center = (i + 0.5) * scale;
+        int16_t *w = t->weights + (size_t)i * t->max_taps;
+        int lo = 0, n = 0;
+        double sum = 0.0;
+
+        if (kernel) {
+            lo = (int)floor(center - radius);
+            int hi = (int)ceil(center + radius);
+            if (lo < 0) lo = 0;
+            if (hi > src_len) hi = src_len;
+            if (hi - lo > t->max_taps) hi = lo + t->max_taps;
+
+            for (int j = lo; j < hi; j++) {
+                tmp[j - lo] = kernel((j + 0.5 - center) / filter_scale);
+                sum += tmp[j - lo];
+            }
+            n = hi - lo;
+
+            // Drop zero taps at both ends so the inner loops do less work
+            while (n > 0 && tmp[0] == 0.0) {
+                memmove(tmp, tmp + 1, (n - 1) * sizeof(double));
+                lo++;
+                n--;
+            }
+            while (n > 0 && tmp[n - 1] == 0.0) {
+                n--;
+            }
+        }
+
+        if (n == 0 || sum == 0.0) {
+            int nearest = (int)center;
+            if (nearest >= src_len) nearest = src_len - 1;
+            t->start[i] = nearest;
+            t->count[i] = 1;
+            w[0] = WEIGHT_ONE;
+            continue;
+        }
+
+        // Quantize the running sum so the taps always add up to exactly WEIGHT_ONE
+        double cumulative = 0.0;
+        long prev = 0;
+        for (int k = 0; k < n; k++) {
+            cumulative += tmp[k];
+            long next = k == n - 1 ? WEIGHT_ONE : lround(cumulative / sum * WEIGHT_ONE);
+            w[k] = (int16_t)(next - prev);
+            prev = next;
+        }
+
+        t->start[i] = lo;
+        t->count[i] = n;
+    }
+
+    return true;
+}
+
+static inline unsigned char clamp_fixed(int32_t acc) {
+    acc >>= WEIGHT_BITS;
+    if (acc < 0) return 0;
+    if (acc > 255) return 255;
+    return (unsigned char)acc;
+}
+
+static void resample_row_h(const unsigned char *src, unsigned char *dst, int channels,
+                           const weight_table_t *t, int dst_w) {
+    if (channels == 1) {
+        for (int x = 0; x < dst_w; x++) {
+            const unsigned char *p = src + t->start[x];
+            const int16_t *w = t->weights + (size_t)x * t->max_taps;
+            int32_t acc = 1 << (WEIGHT_BITS - 1);
+            for (int k = 0; k < t->count[x]; k++) {
+                acc += w[k] * p[k];
+            }
+            dst[x] = clamp_fixed(acc);
+        }
+        return;
+    }
+
+    for (int x = 0; x < dst_w; x++) {
+        const unsigned char *p = src + t->start[x] * channels;
+        const int16_t *w = t->weights + (size_t)x * t->max_taps;
+        int32_t acc[4] = {
+            1 << (WEIGHT_BITS - 1), 1 << (WEIGHT_BITS - 1),
+            1 << (WEIGHT_BITS - 1), 1 << (WEIGHT_BITS - 1)
+        };
+        for (int k = 0; k < t->count[x]; k++) {
+            for (int c = 0; c < channels; c++) {
+                acc[c] += w[k] * p[k * channels + c];
+            }
+        }
+        for (int c = 0; c < channels; c++) {
+            dst[x * channels + c] = clamp_fixed(acc[c]);
+        }
+    }
+}
+
+static void resample_row_v(const unsigned char *const *rows, const int16_t *w, int n,
+                           unsigned char *dst, int len) {
+    int x = 0;
+
+#if defined(RESIZE_USE_NEON)
+    for (; x + 8 <= len; x += 8) {
+        int32x4_t acc_lo = vdupq_n_s32(1 << (WEIGHT_BITS - 1));
+        int32x4_t acc_hi = acc_lo;
+        for (int k = 0; k < n; k++) {
+            int16x8_t v = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[k] + x)));
+            acc_lo = vmlal_n_s16(acc_lo, vget_low_s16(v), w[k]);
+            acc_hi = vmlal_n_s16(acc_hi, vget_high_s16(v), w[k]);
+        }
+        int16x8_t s = vcombine_s16(vqshrn_n_s32(acc_lo, WEIGHT_BITS),
+                                   vqshrn_n_s32(acc_hi, WEIGHT_BITS));
+        vst1_u8(dst + x, vqmovun_s16(s));
+    }
+#elif defined(RESIZE_USE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 8 <= len; x += 8) {
+        __m128i acc_lo = _mm_set1_epi32(1 << (WEIGHT_BITS - 1));
+        __m128i acc_hi = acc_lo;
+        int k = 0;
+        // Interleave two rows so one madd applies a pair of taps
+        for (; k + 1 < n; k += 2) {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(rows[k] + x)), zero);
+            __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(rows[k + 1] + x)), zero);
+            __m128i wab = _mm_set1_epi32((int)((uint16_t)w[k] | ((uint32_t)(uint16_t)w[k + 1] << 16)));
+            acc_lo = _mm_add_epi32(acc_lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), wab));
+            acc_hi = _mm_add_epi32(acc_hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), wab));
+        }
+        if (k < n) {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(rows[k] + x)), zero);
+            __m128i wa = _mm_set1_epi32((int)(uint16_t)w[k]);
+            acc_lo = _mm_add_epi32(acc_lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, zero), wa));
+            acc_hi = _mm_add_epi32(acc_hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, zero), wa));
+        }
+        acc_lo = _mm_srai_epi32(acc_lo, WEIGHT_BITS);
+        acc_hi = _mm_srai_epi32(acc_hi, WEIGHT_BITS);
+        __m128i packed = _mm_packs_epi32(acc_lo, acc_hi);
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(packed, packed));
+    }
+#endif
+
+    for (; x < len; x++) {
+        int32_t acc = 1 << (WEIGHT_BITS - 1);
+        for (int k = 0; k < n; k++) {
+            acc += w[k] * rows[k][x];
+        }
+        dst[x] = clamp_fixed(acc);
+    }
+}
+
+// Resamples output rows [y_begin, y_end). Horizontally filtered source rows
+// live in a ring of y_table->max_taps rows, so memory stays O(taps * width).
+static void *resize_band(void *arg) {
+    resize_band_t *band = arg;
+    const weight_table_t *yt = band->y_table;
+    size_t row_len = (size_t)band->dst_w * band->channels;
+    bool same_width = band->src_w == band->dst_w;
+    int ring_rows = yt->max_taps;
+    unsigned char *ring = band->ring;
+    const unsigned char **rows = band->rows;
+
+    int next_row = 0;
+    for (int y = band->y_begin; y < band->y_end; y++) {
+        int start = yt->start[y];
+        int count = yt->count[y];
+
+        for (int k = 0; k < count; k++) {
+            int sy = start + k;
+            const unsigned char *src_row = band->src + (size_t)sy * band->src_stride;
+            if (same_width) {
+                rows[k] = src_row;
+                continue;
+            }
+            unsigned char *slot = ring + (size_t)(sy % ring_rows) * row_len;
+            if (sy >= next_row) {
+                resample_row_h(src_row, slot, band->channels, band->x_table, band->dst_w);
+                next_row = sy + 1;
+            }
+            rows[k] = slot;
+        }
+
+        resample_row_v(rows, yt->weights + (size_t)y * yt->max_taps, count,
+                       band->dst + (size_t)y * band->dst_stride, (int)row_len);
+    }
+
+    return NULL;
+}
+
+static int pick_thread_count(int threads, int dst_h) {
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threads > MAX_RESIZE_THREADS) threads = MAX_RESIZE_THREADS;
+    if (threads > dst_h / MIN_ROWS_PER_BAND) threads = dst_h / MIN_ROWS_PER_BAND;
+    return threads < 1 ? 1 : threads;
+}
+
+bool epaper_resample_image_scratch(const unsigned char *src, int src_w, int src_h,
+                                   size_t src_stride, int channels, unsigned char *dst,
+                                   int dst_w, int dst_h, size_t dst_stride,
+                                   epaper_resize_filter_t filter, int threads,
+                                   epaper_arena_t *arena, epaper_pool_t *pool) {
+    if (!src || !dst || src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0 ||
+        channels < 1 || channels > 4) {
+        return false;
+    }
+
+    weight_table_t x_table = {0}, y_table = {0};
+    if (!build_weight_table(&x_table, src_w, dst_w, filter, arena) ||
+        !build_weight_table(&y_table, src_h, dst_h, filter, arena)) {
+        fprintf(stderr, "Error: Failed to allocate resize weight tables\n");
+        return false;
+    }
+
+    int num_bands = pick_thread_count(threads, dst_h);
+    resize_band_t bands[MAX_RESIZE_THREADS];
+    size_t row_len = (size_t)dst_w * channels;
+
+    // Every band's ring is carved out up front so workers never allocate
+    for (int i = 0; i < num_bands; i++) {
+        bands[i] = (resize_band_t){
+            .src = src,
+            .src_stride = src_stride,
+            .src_w = src_w,
+            .channels = channels,
+            .dst = dst,
+            .dst_stride = dst_stride,
+            .dst_w = dst_w,
+            .x_table = &x_table,
+            .y_table = &y_table,
+            .y_begin = (int)((long)dst_h * i / num_bands),
+            .y_end = (int)((long)dst_h * (i + 1) / num_bands),
+            .ring = src_w == dst_w ? NULL : epaper_arena_alloc(arena, row_len * y_table.max_taps),
+            .rows = epaper_arena_alloc(arena, y_table.max_taps * sizeof(unsigned char *))
+        };
+        if ((src_w != dst_w && !bands[i].ring) || !bands[i].rows) {
+            fprintf(stderr, "Error: Failed to allocate resize buffers\n");
+            return false;
+        }
+    }
+
+    if (pool || num_bands == 1) {
+        epaper_pool_run(pool, resize_band, bands, sizeof(bands[0]), num_bands);
+        return true;
+    }
+
+    // Without a pool the calling thread takes band 0 and falls back to
+    // inline work if a thread cannot start
+    pthread_t tids[MAX_RESIZE_THREADS];
+    bool started[MAX_RESIZE_THREADS] = {false};
+    for (int i = 1; i < num_bands; i++) {
+        started[i] = pthread_create(&tids[i], NULL, resize_band, &bands[i]) == 0;
+    }
+    resize_band(&bands[0]);
+    for (int i = 1; i < num_bands; i++) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        } else {
+            resize_band(&bands[i]);
+        }
+    }
+    return true;
+}
+
+bool epaper_resample_image(const unsigned char *src, int src_w, int src_h, size_t src_stride,
+                           int channels, unsigned char *dst, int dst_w, int dst_h,
+                           size_t dst_stride, epaper_resize_filter_t filter, int threads) {
+    epaper_arena_t arena;
+
+    epaper_arena_init(&arena);
+    bool success = epaper_resample_image_scratch(src, src_w, src_h, src_stride, channels,
+                                                 dst, dst_w, dst_h, dst_stride, filter,
+                                                 threads, &arena, NULL);
+    epaper_arena_release(&arena);
+    return success;
+}
@@ -0,0 +1,23 @@
+#ifndef RESIZE_EPAPER_IMAGE_H
+#define RESIZE_EPAPER_IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum
+{
+    EPAPER_FILTER_AUTO = 0,
+    EPAPER_FILTER_NEAREST,
+    EPAPER_FILTER_BOX,
+    EPAPER_FILTER_BILINEAR,
+    EPAPER_FILTER_LANCZOS3
+} epaper_resize_filter_t;
+
+// Separable resampler over 8-bit interleaved pixels (1-4 channels).
+// EPAPER_FILTER_AUTO picks box/area averaging for downscales and bilinear otherwise.
+// threads <= 0 selects a thread count from the number of online CPUs.
+bool epaper_resample_image(const unsigned char *src, int src_w, int src_h, size_t src_stride,
+                           int channels, unsigned char *dst, int dst_w, int dst_h,
+                           size_t dst_stride, epaper_resize_filter_t filter, int threads);
+
+#endif
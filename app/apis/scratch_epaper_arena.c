@@ -0,0 +1,302 @@
+#include "scratch_epaper_arena.h"
+#include "send_epaper_data.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HOOK_HEADER EPAPER_ARENA_ALIGN
+
+static __thread epaper_arena_t *bound_arena;
+
+static size_t align_up(size_t size) {
+    return (size + EPAPER_ARENA_ALIGN - 1) & ~(size_t)(EPAPER_ARENA_ALIGN - 1);
+}
+
+static void *aligned_block(size_t size) {
+    void *p = NULL;
+    if (posix_memalign(&p, EPAPER_ARENA_ALIGN, size) != 0) {
+        return NULL;
+    }
+    return p;
+}
+
+void epaper_arena_init(epaper_arena_t *arena) {
+    memset(arena, 0, sizeof(*arena));
+    arena->last_offset = SIZE_MAX;
+}
+
+void *epaper_arena_alloc(epaper_arena_t *arena, size_t size) {
+    size = align_up(size ? size : 1);
+
+    if (arena->used + size <= arena->capacity) {
+        void *p = arena->base + arena->used;
+        arena->last_offset = arena->used;
+        arena->used += size;
+        if (arena->used + arena->overflow_bytes > arena->high_water) {
+            arena->high_water = arena->used + arena->overflow_bytes;
+        }
+        return p;
+    }
+
+    epaper_arena_block_t *block = malloc(sizeof(*block));
+    if (!block) {
+        return NULL;
+    }
+    block->data = aligned_block(size);
+    if (!block->data) {
+        free(block);
+        return NULL;
+    }
+    block->next = arena->overflow;
+    arena->overflow = block;
+    arena->overflow_bytes += size;
+    arena->last_offset = SIZE_MAX;
+    if (arena->used + arena->overflow_bytes > arena->high_water) {
+        arena->high_water = arena->used + arena->overflow_bytes;
+    }
+    return block->data;
+}
+
+static void free_overflow(epaper_arena_t *arena) {
+    while (arena->overflow) {
+        epaper_arena_block_t *next = arena->overflow->next;
+        free(arena->overflow->data);
+        free(arena->overflow);
+        arena->overflow = next;
+    }
+    arena->overflow_bytes = 0;
+}
+
+void epaper_arena_reset(epaper_arena_t *arena) {
+    free_overflow(arena);
+
+    if (arena->high_water > arena->capacity) {
+        size_t capacity = align_up(arena->high_water);
+        unsigned char *base = aligned_block(capacity);
+        if (base) {
+            free(arena->base);
+            arena->base = base;
+            arena->capacity = capacity;
+        }
+    }
+
+    arena->used = 0;
+    arena->last_offset = SIZE_MAX;
+}
+
+void epaper_arena_release(epaper_arena_t *arena) {
+    free_overflow(arena);
+    free(arena->base);
+    epaper_arena_init(arena);
+}
+
+static void *pool_worker(void *arg) {
+    epaper_pool_t *pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop) {
+        while (pool->next < pool->count) {
+            int i = pool->next++;
+            pthread_mutex_unlock(&pool->lock);
+            pool->fn(pool->args + (size_t)i * pool->arg_size);
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0) {
+                pthread_cond_signal(&pool->done_cond);
+            }
+        }
+        if (!pool->stop) {
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+epaper_pool_t *epaper_pool_create(int num_threads) {
+    if (num_threads <= 0) {
+        return NULL;
+    }
+
+    epaper_pool_t *pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->threads = calloc(num_threads, sizeof(pthread_t));
+    if (!pool->threads) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, pool) != 0) {
+            break;
+        }
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0) {
+        epaper_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void epaper_pool_run(epaper_pool_t *pool, void *(*fn)(void *), void *args, size_t arg_size, int count) {
+    if (!pool) {
+        for (int i = 0; i < count; i++) {
+            fn((unsigned char *)args + (size_t)i * arg_size);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->args = args;
+    pool->arg_size = arg_size;
+    pool->count = count;
+    pool->next = 0;
+    pool->pending = count;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    while (pool->next < pool->count) {
+        int i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        fn((unsigned char *)args + (size_t)i * arg_size);
+        pthread_mutex_lock(&pool->lock);
+        pool->pending--;
+    }
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    pool->count = 0;
+    pool->next = 0;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void epaper_pool_destroy(epaper_pool_t *pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+void epaper_arena_bind(epaper_arena_t *arena) {
+    bound_arena = arena;
+}
+
+bool epaper_arena_bound(void) {
+    return bound_arena != NULL;
+}
+
+// Arena-backed hook allocations carry their size in a header block so that
+// realloc callers that do not pass the old size still work
+void *epaper_arena_hook_malloc(size_t size) {
+    if (!bound_arena) {
+        return malloc(size);
+    }
+    unsigned char *p = epaper_arena_alloc(bound_arena, size + HOOK_HEADER);
+    if (!p) {
+        return NULL;
+    }
+    memcpy(p, &size, sizeof(size));
+    return p + HOOK_HEADER;
+}
+
+void *epaper_arena_hook_realloc(void *ptr, size_t size) {
+    if (!bound_arena) {
+        return realloc(ptr, size);
+    }
+    if (!ptr) {
+        return epaper_arena_hook_malloc(size);
+    }
+
+    unsigned char *header = (unsigned char *)ptr - HOOK_HEADER;
+    size_t old_size;
+    memcpy(&old_size, header, sizeof(old_size));
+
+    epaper_arena_t *arena = bound_arena;
+    if (arena->last_offset != SIZE_MAX && header == arena->base + arena->last_offset) {
+        size_t needed = align_up(size + HOOK_HEADER);
+        if (arena->last_offset + needed <= arena->capacity) {
+            arena->used = arena->last_offset + needed;
+            if (arena->used + arena->overflow_bytes > arena->high_water) {
+                arena->high_water = arena->used + arena->overflow_bytes;
+            }
+            memcpy(header, &size, sizeof(size));
+            return ptr;
+        }
+    }
+
+    void *grown = epaper_arena_hook_malloc(size);
+    if (grown) {
+        memcpy(grown, ptr, old_size < size ? old_size : size);
+    }
+    return grown;
+}
+
+void *epaper_arena_hook_calloc(size_t count, size_t size) {
+    if (!bound_arena) {
+        return calloc(count, size);
+    }
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *p = epaper_arena_hook_malloc(count * size);
+    if (p) {
+        memset(p, 0, count * size);
+    }
+    return p;
+}
+
+void epaper_arena_hook_free(void *ptr) {
+    if (!bound_arena) {
+        free(ptr);
+    }
+}
+
+epaper_ctx_t *epaper_ctx_create(int num_threads) {
+    epaper_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        return NULL;
+    }
+
+    epaper_arena_init(&ctx->arena);
+    ctx->num_threads = num_threads > 0 ? num_threads : 1;
+
+    // The calling thread always takes part, so n threads need n - 1 workers
+    if (ctx->num_threads > 1) {
+        ctx->pool = epaper_pool_create(ctx->num_threads - 1);
+        if (!ctx->pool) {
+            fprintf(stderr, "Warning: Failed to start conversion thread pool\n");
+            ctx->num_threads = 1;
+        }
+    }
+    return ctx;
+}
+
+void epaper_ctx_destroy(epaper_ctx_t *ctx) {
+    if (ctx) {
+        epaper_pool_destroy(ctx->pool);
+        epaper_arena_release(&ctx->arena);
+        free(ctx);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef SCRATCH_EPAPER_ARENA_H
+#define SCRATCH_EPAPER_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "resize_epaper_image.h"
+#include "send_epaper_data.h"
+
+#define EPAPER_ARENA_ALIGN 64
+
+typedef struct epaper_arena_block
+{
+    struct epaper_arena_block *next;
+    unsigned char *data;
+} epaper_arena_block_t;
+
+// Bump allocator reset once per frame. Requests that do not fit go to
+// overflow blocks for the current frame; the next reset regrows the main
+// block to the high-water mark, so a steady workload stops calling malloc.
+typedef struct
+{
+    unsigned char *base;
+    size_t capacity;
+    size_t used;
+    size_t high_water;
+    size_t last_offset;
+    size_t overflow_bytes;
+    epaper_arena_block_t *overflow;
+} epaper_arena_t;
+
+// Persistent workers that run `count` calls of fn(args + i * arg_size);
+// the calling thread works through the same queue until all are done.
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    pthread_t *threads;
+    int num_threads;
+    void *(*fn)(void *);
+    unsigned char *args;
+    size_t arg_size;
+    int count;
+    int next;
+    int pending;
+    bool stop;
+} epaper_pool_t;
+
+struct epaper_ctx
+{
+    epaper_arena_t arena;
+    epaper_pool_t *pool;
+    int num_threads;
+    epaper_stage_stats_t stats;     // of the current call, reset with the arena
+};
+
+void epaper_arena_init(epaper_arena_t *arena);
+void *epaper_arena_alloc(epaper_arena_t *arena, size_t size);
+void epaper_arena_reset(epaper_arena_t *arena);
+void epaper_arena_release(epaper_arena_t *arena);
+
+epaper_pool_t *epaper_pool_create(int num_threads);
+void epaper_pool_run(epaper_pool_t *pool, void *(*fn)(void *), void *args, size_t arg_size, int count);
+void epaper_pool_destroy(epaper_pool_t *pool);
+
+// malloc/realloc/free replacements for third-party decoders. While an arena
+// is bound to the calling thread they allocate from it (free is a no-op and
+// realloc of the newest block grows in place); otherwise they use the heap.
+void epaper_arena_bind(epaper_arena_t *arena);
+bool epaper_arena_bound(void);
+void *epaper_arena_hook_malloc(size_t size);
+void *epaper_arena_hook_realloc(void *ptr, size_t size);
+void *epaper_arena_hook_calloc(size_t count, size_t size);
+void epaper_arena_hook_free(void *ptr);
+
+// Arena/pool aware variant of epaper_resample_image(); pool may be NULL
+bool epaper_resample_image_scratch(const unsigned char *src, int src_w, int src_h,
+                                   size_t src_stride, int channels, unsigned char *dst,
+                                   int dst_w, int dst_h, size_t dst_stride,
+                                   epaper_resize_filter_t filter, int threads,
+                                   epaper_arena_t *arena, epaper_pool_t *pool);
+
+#endif
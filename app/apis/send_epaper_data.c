@@ -1,4 +1,5 @@
 #include "send_epaper_data.h"
+#include "transport_epaper_link.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -12,11 +13,14 @@
 #define ECOMM 70
 #endif
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "decode_epaper_image.h"
+#include "cache_epaper_frame.h"
+#include "packed_epaper_image.h"
+#include "scratch_epaper_arena.h"
+#include "trace_epaper_stage.h"
 
 int epaper_open(const char* device_path) {
-    int fd = open(device_path, O_WRONLY);
+    int fd = epaper_transport_open(device_path, false);
     if (fd < 0) {
         perror("Failed to open device");
     }
@@ -24,39 +28,66 @@ int epaper_open(const char* device_path) {
 }
 
 void epaper_close(int fd) {
-    if (fd >= 0) {
-        close(fd);
-    }
+    epaper_transport_close(fd);
 }
 
-static unsigned char rgb_to_gray(const unsigned char *pixel, int channels) {
-    if (channels == 1) {
-        return pixel[0];
-    } else if (channels >= 3) {
-        return (unsigned char)(0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2]);
-    } else {
-        return pixel[0];
-    }
+bool epaper_abort(int fd) {
+    return epaper_transport_abort(fd);
 }
 
-static void resize_image(const unsigned char *src, int src_w, int src_h, int channels,
-                        unsigned char *dst, int dst_w, int dst_h) {
-    float x_ratio = (float)src_w / dst_w;
-    float y_ratio = (float)src_h / dst_h;
-    
-    for (int y = 0; y < dst_h; y++) {
-        for (int x = 0; x < dst_w; x++) {
-            int src_x = (int)(x * x_ratio);
-            int src_y = (int)(y * y_ratio);
-            
-            if (src_x >= src_w) src_x = src_w - 1;
-            if (src_y >= src_h) src_y = src_h - 1;
-            
-            for (int c = 0; c < channels; c++) {
-                dst[(y * dst_w + x) * channels + c] = 
-                    src[(src_y * src_w + src_x) * channels + c];
-            }
+static bool scale_gray_plane(epaper_ctx_t *ctx, const unsigned char *src, int src_w, int src_h,
+                             size_t src_stride, const epaper_convert_options_t *options,
+                             unsigned char *dst, int dst_w, int dst_h) {
+    unsigned char background = options->letterbox_black ? 0 : 255;
+    
+    switch (options->scale_mode) {
+    case EPAPER_SCALE_FIT: {
+        int w = dst_w;
+        int h = (int)((long)src_h * dst_w / src_w);
+        if (h > dst_h) {
+            h = dst_h;
+            w = (int)((long)src_w * dst_h / src_h);
+        }
+        if (w < 1) w = 1;
+        if (h < 1) h = 1;
+        
+        memset(dst, background, (size_t)dst_w * dst_h);
+        unsigned char *origin = dst + (size_t)((dst_h - h) / 2) * dst_w + (dst_w - w) / 2;
+        return epaper_resample_image_scratch(src, src_w, src_h, src_stride, 1, origin, w, h,
+                                             dst_w, options->resize_filter, ctx->num_threads,
+                                             &ctx->arena, ctx->pool);
+    }
+    case EPAPER_SCALE_FILL: {
+        int crop_w = src_w;
+        int crop_h = (int)((long)src_w * dst_h / dst_w);
+        if (crop_h > src_h) {
+            crop_h = src_h;
+            crop_w = (int)((long)src_h * dst_w / dst_h);
         }
+        if (crop_w < 1) crop_w = 1;
+        if (crop_h < 1) crop_h = 1;
+        
+        const unsigned char *origin = src + (size_t)((src_h - crop_h) / 2) * src_stride + (src_w - crop_w) / 2;
+        return epaper_resample_image_scratch(origin, crop_w, crop_h, src_stride, 1, dst, dst_w,
+                                             dst_h, dst_w, options->resize_filter, ctx->num_threads,
+                                             &ctx->arena, ctx->pool);
+    }
+    case EPAPER_SCALE_CROP: {
+        int copy_w = src_w < dst_w ? src_w : dst_w;
+        int copy_h = src_h < dst_h ? src_h : dst_h;
+        const unsigned char *from = src + (size_t)((src_h - copy_h) / 2) * src_stride + (src_w - copy_w) / 2;
+        unsigned char *to = dst + (size_t)((dst_h - copy_h) / 2) * dst_w + (dst_w - copy_w) / 2;
+        
+        memset(dst, background, (size_t)dst_w * dst_h);
+        for (int y = 0; y < copy_h; y++) {
+            memcpy(to + (size_t)y * dst_w, from + (size_t)y * src_stride, copy_w);
+        }
+        return true;
+    }
+    default:
+        return epaper_resample_image_scratch(src, src_w, src_h, src_stride, 1, dst, dst_w, dst_h,
+                                             dst_w, options->resize_filter, ctx->num_threads,
+                                             &ctx->arena, ctx->pool);
     }
 }
 
@@ -85,10 +116,14 @@ static void apply_dithering(float *gray, int width, int height) {
 static bool send_with_progress(int fd, const unsigned char *data, size_t size) {
     printf("Sending %zu bytes to TX driver...\n", size);
     
-    ssize_t bytes_written = write(fd, data, size);
+    EPAPER_PROBE(write_start, fd, size);
+    ssize_t bytes_written = epaper_transport_write(fd, data, size);
+    EPAPER_PROBE(write_done, fd, bytes_written);
     if (bytes_written != (ssize_t)size) {
+        // Callers such as the async workers report errno, so keep it intact
+        int err = bytes_written < 0 ? errno : EIO;
         if (bytes_written < 0) {
-            switch (errno) {
+            switch (err) {
             case ETIMEDOUT:
                 fprintf(stderr, "Error: Connection timeout during transmission\n");
                 break;
@@ -101,14 +136,18 @@ static bool send_with_progress(int fd, const unsigned char *data, size_t size) {
             case EINVAL:
                 fprintf(stderr, "Error: Invalid data size or format\n");
                 break;
+            case ECANCELED:
+                fprintf(stderr, "Transmission aborted\n");
+                break;
             default:
-                fprintf(stderr, "Write failed: %s\n", strerror(errno));
+                fprintf(stderr, "Write failed: %s\n", strerror(err));
                 break;
             }
         } else {
             fprintf(stderr, "Error: Partial write (%zd/%zu bytes written)\n", 
                    bytes_written, size);
         }
+        errno = err;
         return false;
     }
     
@@ -116,6 +155,39 @@ static bool send_with_progress(int fd, const unsigned char *data, size_t size) {
     return true;
 }
 
+static bool pack_packed_image(epaper_ctx_t *ctx, const epaper_packed_image_t *packed,
+                              bool invert, epaper_frame_t *frame) {
+    size_t mono_size = ((size_t)packed->width * packed->height + 7) / 8;
+    image_header_t header = {
+        .width = (uint16_t)packed->width,
+        .height = (uint16_t)packed->height,
+        .data_length = (uint32_t)mono_size,
+        .header_checksum = 0
+    };
+    
+    unsigned char *send_buffer = epaper_arena_alloc(&ctx->arena, sizeof(header) + mono_size);
+    if (!send_buffer) {
+        fprintf(stderr, "Error: Failed to allocate send buffer\n");
+        return false;
+    }
+    
+    memcpy(send_buffer, &header, sizeof(header));
+    EPAPER_PROBE(pack_start, packed->width, packed->height);
+    uint64_t pack_ns = epaper_now_ns();
+    epaper_packed_repack(packed, invert, send_buffer + sizeof(header));
+    epaper_stage_add(&ctx->stats, EPAPER_STAGE_PACK, pack_ns, mono_size);
+    EPAPER_PROBE(pack_done, mono_size);
+    
+    printf("Using pre-packed image: %dx%d, %zu bytes data\n",
+           packed->width, packed->height, mono_size);
+    
+    frame->data = send_buffer;
+    frame->size = sizeof(header) + mono_size;
+    frame->width = packed->width;
+    frame->height = packed->height;
+    return true;
+}
+
 bool epaper_send_image(int fd, const char* image_path) {
     return epaper_send_image_advanced(fd, image_path, NULL);
 }
@@ -125,43 +197,36 @@ bool epaper_send_image_resized(int fd, const char *image_path, int target_width,
         .target_height = target_height,
         .use_dithering = false,
         .invert_colors = false,
-        .threshold = 128
+        .threshold = 128,
+        .resize_filter = EPAPER_FILTER_AUTO,
+        .num_threads = 0,
+        .scale_mode = EPAPER_SCALE_STRETCH,
+        .letterbox_black = false,
+        .cache_dir = NULL,
+        .cache_max_bytes = 0
     };
     return epaper_send_image_advanced(fd, image_path, &options);
 }
 
-bool epaper_send_image_advanced(int fd, const char *image_path, const epaper_convert_options_t *options) {
-    int width, height, channels;
-    
-    unsigned char *img = stbi_load(image_path, &width, &height, &channels, 0);
-    if (img == NULL) {
-        fprintf(stderr, "Error: Failed to load image %s\n", image_path);
-        return false;
-    }
-    
-    if (channels < 1 || channels > 4) {
-        fprintf(stderr, "Error: Unsupported image format (%d channels)\n", channels);
-        stbi_image_free(img);
-        return false;
-    }
+// Resizes (if requested), thresholds or dithers and packs a gray plane
+// directly behind the header in the send buffer
+static bool pack_gray_plane(epaper_ctx_t *ctx, const unsigned char *gray_img, int width, int height,
+                            size_t stride, const epaper_convert_options_t *options,
+                            const uint64_t *cache_key, epaper_frame_t *frame) {
+    const unsigned char *processed_img = gray_img;
+    size_t processed_stride = stride;
+    int final_width = width;
+    int final_height = height;
     
     if (width <= 0 || height <= 0) {
         fprintf(stderr, "Error: Invalid image dimensions (%dx%d)\n", width, height);
-        stbi_image_free(img);
         return false;
     }
     
-    printf("Image loaded: %dx%d, %d channels\n", width, height, channels);
-    
-    unsigned char *processed_img = img;
-    int final_width = width;
-    int final_height = height;
-    
     if (options && options->target_width > 0 && options->target_height > 0) {
         if (options->target_width > 10000 || options->target_height > 10000) {
             fprintf(stderr, "Error: Target dimensions too large (%dx%d)\n", 
                    options->target_width, options->target_height);
-            stbi_image_free(img);
             return false;
         }
         
@@ -169,24 +234,48 @@ bool epaper_send_image_advanced(int fd, const char *image_path, const epaper_con
         final_height = options->target_height;
         
         if (final_width != width || final_height != height) {
-            processed_img = malloc(final_width * final_height * channels);
-            if (!processed_img) {
-                stbi_image_free(img);
+            unsigned char *scaled_img = epaper_arena_alloc(&ctx->arena, (size_t)final_width * final_height);
+            if (!scaled_img) {
                 return false;
             }
             
-            resize_image(img, width, height, channels, processed_img, final_width, final_height);
+            EPAPER_PROBE(resize_start, width, height, final_width, final_height);
+            uint64_t resize_ns = epaper_now_ns();
+            if (!scale_gray_plane(ctx, gray_img, width, height, stride, options,
+                                  scaled_img, final_width, final_height)) {
+                fprintf(stderr, "Error: Failed to resize image\n");
+                return false;
+            }
+            epaper_stage_add(&ctx->stats, EPAPER_STAGE_RESIZE, resize_ns,
+                             (size_t)final_width * final_height);
+            EPAPER_PROBE(resize_done, final_width, final_height);
+            processed_img = scaled_img;
+            processed_stride = final_width;
             printf("Resized to: %dx%d\n", final_width, final_height);
         }
     }
     
-    size_t mono_size = (final_width * final_height + 7) / 8;
-    unsigned char *mono_buffer = malloc(mono_size);
-    if (!mono_buffer) {
-        if (processed_img != img) free(processed_img);
-        stbi_image_free(img);
+    size_t mono_size = ((size_t)final_width * final_height + 7) / 8;
+    if (mono_size > 0xFFFFFFFF) {
+        fprintf(stderr, "Error: Image data too large for protocol\n");
+        return false;
+    }
+    
+    image_header_t header;
+    header.width = (uint16_t)final_width;
+    header.height = (uint16_t)final_height;
+    header.data_length = (uint32_t)mono_size;
+    header.header_checksum = 0;
+    
+    size_t total_size = sizeof(header) + mono_size;
+    unsigned char *send_buffer = epaper_arena_alloc(&ctx->arena, total_size);
+    if (!send_buffer) {
+        fprintf(stderr, "Error: Failed to allocate send buffer\n");
         return false;
     }
+    
+    memcpy(send_buffer, &header, sizeof(header));
+    unsigned char *mono_buffer = send_buffer + sizeof(header);
     memset(mono_buffer, 0, mono_size);
     
     printf("Converting to 1-bit monochrome (%zu bytes)...\n", mono_size);
@@ -197,24 +286,28 @@ bool epaper_send_image_advanced(int fd, const char *image_path, const epaper_con
     bool invert = options ? options->invert_colors : false;
     
     if (use_dithering) {
-        float *gray = malloc(final_width * final_height * sizeof(float));
+        float *gray = epaper_arena_alloc(&ctx->arena,
+                                         (size_t)final_width * final_height * sizeof(float));
         if (!gray) {
-            free(mono_buffer);
-            if (processed_img != img) free(processed_img);
-            stbi_image_free(img);
             return false;
         }
         
+        EPAPER_PROBE(dither_start, final_width, final_height);
+        uint64_t dither_ns = epaper_now_ns();
         for (int y = 0; y < final_height; y++) {
+            const unsigned char *row = processed_img + (size_t)y * processed_stride;
             for (int x = 0; x < final_width; x++) {
-                unsigned char* pixel = processed_img + (y * final_width + x) * channels;
-                gray[y * final_width + x] = rgb_to_gray(pixel, channels);
-                if (invert) gray[y * final_width + x] = 255.0f - gray[y * final_width + x];
+                gray[y * final_width + x] = invert ? 255.0f - row[x] : row[x];
             }
         }
         
         apply_dithering(gray, final_width, final_height);
+        epaper_stage_add(&ctx->stats, EPAPER_STAGE_DITHER, dither_ns,
+                         (size_t)final_width * final_height * sizeof(float));
+        EPAPER_PROBE(dither_done, final_width, final_height);
         
+        EPAPER_PROBE(pack_start, final_width, final_height);
+        uint64_t pack_ns = epaper_now_ns();
         for (int y = 0; y < final_height; y++) {
             for (int x = 0; x < final_width; x++) {
                 if (gray[y * final_width + x] < 127.5f) {
@@ -224,13 +317,15 @@ bool epaper_send_image_advanced(int fd, const char *image_path, const epaper_con
                 }
             }
         }
-        
-        free(gray);
+        epaper_stage_add(&ctx->stats, EPAPER_STAGE_PACK, pack_ns, mono_size);
+        EPAPER_PROBE(pack_done, mono_size);
     } else {
+        EPAPER_PROBE(pack_start, final_width, final_height);
+        uint64_t pack_ns = epaper_now_ns();
         for (int y = 0; y < final_height; y++) {
+            const unsigned char *row = processed_img + (size_t)y * processed_stride;
             for (int x = 0; x < final_width; x++) {
-                unsigned char* pixel = processed_img + (y * final_width + x) * channels;
-                int avg = rgb_to_gray(pixel, channels);
+                int avg = row[x];
                 if (invert) avg = 255 - avg;
                 
                 if (avg < threshold) {
@@ -240,43 +335,351 @@ bool epaper_send_image_advanced(int fd, const char *image_path, const epaper_con
                 }
             }
         }
+        epaper_stage_add(&ctx->stats, EPAPER_STAGE_PACK, pack_ns, mono_size);
+        EPAPER_PROBE(pack_done, mono_size);
     }
     
-    if (processed_img != img) free(processed_img);
-    stbi_image_free(img);
+    if (cache_key &&
+        !epaper_cache_store(options->cache_dir, *cache_key, send_buffer, total_size,
+                            options->cache_max_bytes)) {
+        fprintf(stderr, "Warning: Failed to store frame in cache %s\n", options->cache_dir);
+    }
     
-    if (mono_size > 0xFFFFFFFF) {
-        fprintf(stderr, "Error: Image data too large for protocol\n");
-        free(mono_buffer);
+    frame->data = send_buffer;
+    frame->size = total_size;
+    frame->width = final_width;
+    frame->height = final_height;
+    return true;
+}
+
+// 1-bit PBM/raw input that already has the target size only needs its rows
+// repacked into the send buffer; threshold and dithering are no-ops
+static bool packed_matches_target(const epaper_packed_image_t *packed,
+                                  const epaper_convert_options_t *options) {
+    int target_w = options ? options->target_width : 0;
+    int target_h = options ? options->target_height : 0;
+    return target_w <= 0 || target_h <= 0 ||
+           (target_w == packed->width && target_h == packed->height);
+}
+
+// A hit is copied out of the mapping so the frame has the same lifetime as
+// a freshly converted one
+static bool load_cached_frame(epaper_ctx_t *ctx, const char *cache_dir, uint64_t cache_key,
+                              epaper_frame_t *frame) {
+    epaper_cached_frame_t cached;
+    image_header_t header;
+    uint64_t start_ns = epaper_now_ns();
+    
+    if (!epaper_cache_lookup(cache_dir, cache_key, &cached)) {
         return false;
     }
     
-    image_header_t header;
-    header.width = (uint16_t)final_width;
-    header.height = (uint16_t)final_height;
-    header.data_length = (uint32_t)mono_size;
-    header.header_checksum = 0;
+    unsigned char *data = epaper_arena_alloc(&ctx->arena, cached.size);
+    if (!data) {
+        epaper_cache_release(&cached);
+        return false;
+    }
+    memcpy(data, cached.data, cached.size);
+    memcpy(&header, data, sizeof(header));
+    epaper_cache_release(&cached);
     
-    size_t total_size = sizeof(header) + mono_size;
-    unsigned char *send_buffer = malloc(total_size);
-    if (!send_buffer) {
-        fprintf(stderr, "Error: Failed to allocate send buffer\n");
-        free(mono_buffer);
+    epaper_stage_add(&ctx->stats, EPAPER_STAGE_DECODE, start_ns, cached.size);
+    ctx->stats.cache_hit = true;
+    EPAPER_PROBE(cache_hit, cache_key, cached.size);
+    printf("Cache hit: %016llx (%zu bytes)\n", (unsigned long long)cache_key, cached.size);
+    frame->data = data;
+    frame->size = cached.size;
+    frame->width = header.width;
+    frame->height = header.height;
+    return true;
+}
+
+static void print_decoded_info(const epaper_decoded_image_t *decoded) {
+    if (decoded->width != decoded->full_width || decoded->height != decoded->full_height) {
+        printf("Image loaded: %dx%d (decoded at %dx%d by %s)\n",
+               decoded->full_width, decoded->full_height, decoded->width, decoded->height,
+               decoded->backend);
+    } else {
+        printf("Image loaded: %dx%d\n", decoded->width, decoded->height);
+    }
+}
+
+// Crop mode keeps source pixels 1:1, so the decoder must not pre-scale
+static void decode_target(const epaper_convert_options_t *options, int *target_w, int *target_h) {
+    bool decode_scaled = options && options->scale_mode != EPAPER_SCALE_CROP;
+    *target_w = decode_scaled ? options->target_width : 0;
+    *target_h = decode_scaled ? options->target_height : 0;
+}
+
+static bool convert_image(epaper_ctx_t *ctx, const char *image_path,
+                          const epaper_convert_options_t *options, epaper_frame_t *frame) {
+    epaper_decoded_image_t decoded;
+    epaper_packed_image_t packed;
+    uint64_t cache_key = 0;
+    int target_w, target_h;
+    
+    epaper_arena_reset(&ctx->arena);
+    
+    // The file is probed and mapped once; a 1-bit input that needs resizing
+    // is expanded from the same mapping below
+    bool is_packed = epaper_packed_open(image_path, &packed);
+    if (is_packed && packed_matches_target(&packed, options)) {
+        bool success = pack_packed_image(ctx, &packed,
+                                         options ? options->invert_colors : false, frame);
+        epaper_packed_close(&packed);
+        return success;
+    }
+    
+    bool use_cache = options && options->cache_dir &&
+                     epaper_cache_key_file(image_path, options, &cache_key);
+    if (use_cache && load_cached_frame(ctx, options->cache_dir, cache_key, frame)) {
+        if (is_packed) epaper_packed_close(&packed);
+        return true;
+    }
+    
+    // Colour is discarded anyway; decoding straight to one luminance plane keeps
+    // the resize stage from touching 3-4x more bytes than it needs to
+    decode_target(options, &target_w, &target_h);
+    EPAPER_PROBE(decode_start, image_path);
+    uint64_t decode_ns = epaper_now_ns();
+    bool loaded = is_packed ?
+                  epaper_decode_packed_image(&packed, &ctx->arena, &decoded) :
+                  epaper_decode_image_file(image_path, target_w, target_h, 1, &ctx->arena, &decoded);
+    if (is_packed) epaper_packed_close(&packed);
+    if (!loaded) {
+        fprintf(stderr, "Error: Failed to load image %s\n", image_path);
         return false;
     }
+    epaper_stage_add(&ctx->stats, EPAPER_STAGE_DECODE, decode_ns,
+                     (size_t)decoded.width * decoded.height);
+    EPAPER_PROBE(decode_done, decoded.width, decoded.height);
+    print_decoded_info(&decoded);
     
-    memcpy(send_buffer, &header, sizeof(header));
-    memcpy(send_buffer + sizeof(header), mono_buffer, mono_size);
+    bool success = pack_gray_plane(ctx, decoded.pixels, decoded.width, decoded.height,
+                                   decoded.width, options, use_cache ? &cache_key : NULL, frame);
+    epaper_free_decoded_image(&decoded);
+    return success;
+}
+
+static bool convert_encoded_buffer(epaper_ctx_t *ctx, const void *data, size_t size,
+                                   const epaper_convert_options_t *options, epaper_frame_t *frame) {
+    epaper_decoded_image_t decoded;
+    epaper_packed_image_t packed;
+    uint64_t cache_key = 0;
+    int target_w, target_h;
+    
+    if (!data || size == 0) {
+        fprintf(stderr, "Error: Empty image buffer\n");
+        return false;
+    }
+    
+    epaper_arena_reset(&ctx->arena);
+    
+    bool is_packed = epaper_packed_parse(data, size, &packed);
+    if (is_packed && packed_matches_target(&packed, options)) {
+        return pack_packed_image(ctx, &packed, options ? options->invert_colors : false, frame);
+    }
+    
+    bool use_cache = options && options->cache_dir;
+    if (use_cache) {
+        cache_key = epaper_cache_key(data, size, options);
+    }
+    if (use_cache && load_cached_frame(ctx, options->cache_dir, cache_key, frame)) {
+        return true;
+    }
+    
+    decode_target(options, &target_w, &target_h);
+    EPAPER_PROBE(decode_start, (const char *)NULL);
+    uint64_t decode_ns = epaper_now_ns();
+    bool loaded = is_packed ?
+                  epaper_decode_packed_image(&packed, &ctx->arena, &decoded) :
+                  epaper_decode_image_memory(data, size, target_w, target_h, 1, &ctx->arena,
+                                             &decoded);
+    if (!loaded) {
+        fprintf(stderr, "Error: Failed to decode image buffer (%zu bytes)\n", size);
+        return false;
+    }
+    epaper_stage_add(&ctx->stats, EPAPER_STAGE_DECODE, decode_ns,
+                     (size_t)decoded.width * decoded.height);
+    EPAPER_PROBE(decode_done, decoded.width, decoded.height);
+    print_decoded_info(&decoded);
+    
+    bool success = pack_gray_plane(ctx, decoded.pixels, decoded.width, decoded.height,
+                                   decoded.width, options, use_cache ? &cache_key : NULL, frame);
+    epaper_free_decoded_image(&decoded);
+    return success;
+}
+
+static bool convert_pixels(epaper_ctx_t *ctx, const void *pixels, int width, int height,
+                           size_t stride, epaper_pixel_format_t format,
+                           const epaper_convert_options_t *options, epaper_frame_t *frame) {
+    int channels;
+    
+    switch (format) {
+    case EPAPER_PIXEL_GRAY8:
+        channels = 1;
+        break;
+    case EPAPER_PIXEL_RGB24:
+        channels = 3;
+        break;
+    case EPAPER_PIXEL_RGBA32:
+        channels = 4;
+        break;
+    default:
+        fprintf(stderr, "Error: Unsupported pixel format %d\n", (int)format);
+        return false;
+    }
+    
+    if (!pixels || width <= 0 || height <= 0 || stride < (size_t)width * channels) {
+        fprintf(stderr, "Error: Invalid pixel buffer (%dx%d, stride %zu)\n", width, height, stride);
+        return false;
+    }
+    
+    epaper_arena_reset(&ctx->arena);
+    
+    // Gray frames are consumed in place, stride and all
+    if (channels == 1) {
+        return pack_gray_plane(ctx, pixels, width, height, stride, options, NULL, frame);
+    }
+    
+    unsigned char *gray = epaper_arena_alloc(&ctx->arena, (size_t)width * height);
+    if (!gray) {
+        return false;
+    }
+    EPAPER_PROBE(gray_start, width, height, channels);
+    uint64_t gray_ns = epaper_now_ns();
+    for (int y = 0; y < height; y++) {
+        const unsigned char *src = (const unsigned char *)pixels + (size_t)y * stride;
+        unsigned char *dst = gray + (size_t)y * width;
+        for (int x = 0; x < width; x++, src += channels) {
+            dst[x] = (unsigned char)((77 * src[0] + 150 * src[1] + 29 * src[2] + 128) >> 8);
+        }
+    }
+    epaper_stage_add(&ctx->stats, EPAPER_STAGE_GRAY, gray_ns, (size_t)width * height);
+    EPAPER_PROBE(gray_done, width, height);
     
-    printf("Sending image: %dx%d, %zu bytes data\n", final_width, final_height, mono_size);
+    return pack_gray_plane(ctx, gray, width, height, width, options, NULL, frame);
+}
+
+// Every public conversion or send on a context reports once: convert calls
+// without a write stage, send calls with it
+static void report_stats(epaper_ctx_t *ctx, const epaper_convert_options_t *options,
+                         bool success) {
+    ctx->stats.success = success;
+    if (options && options->stats_callback) {
+        options->stats_callback(&ctx->stats, options->stats_user_data);
+    }
+}
+
+bool epaper_ctx_convert_image(epaper_ctx_t *ctx, const char *image_path,
+                              const epaper_convert_options_t *options, epaper_frame_t *frame) {
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    bool success = convert_image(ctx, image_path, options, frame);
+    report_stats(ctx, options, success);
+    return success;
+}
+
+bool epaper_ctx_convert_encoded_buffer(epaper_ctx_t *ctx, const void *data, size_t size,
+                                       const epaper_convert_options_t *options,
+                                       epaper_frame_t *frame) {
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    bool success = convert_encoded_buffer(ctx, data, size, options, frame);
+    report_stats(ctx, options, success);
+    return success;
+}
+
+bool epaper_ctx_convert_pixels(epaper_ctx_t *ctx, const void *pixels, int width, int height,
+                               size_t stride, epaper_pixel_format_t format,
+                               const epaper_convert_options_t *options, epaper_frame_t *frame) {
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    bool success = convert_pixels(ctx, pixels, width, height, stride, format, options, frame);
+    report_stats(ctx, options, success);
+    return success;
+}
+
+bool epaper_send_frame(int fd, const epaper_frame_t *frame) {
+    printf("Sending image: %dx%d, %zu bytes data\n", frame->width, frame->height,
+           frame->size - sizeof(image_header_t));
     
-    bool success = send_with_progress(fd, send_buffer, total_size);
+    bool success = send_with_progress(fd, frame->data, frame->size);
     
     if (success) {
         printf("Successfully sent image\n");
     }
+    return success;
+}
+
+static bool send_frame_timed(epaper_ctx_t *ctx, int fd, const epaper_frame_t *frame) {
+    uint64_t start_ns = epaper_now_ns();
+    bool success = epaper_send_frame(fd, frame);
+    epaper_stage_add(&ctx->stats, EPAPER_STAGE_WRITE, start_ns, success ? frame->size : 0);
+    return success;
+}
+
+bool epaper_ctx_send_image(epaper_ctx_t *ctx, int fd, const char *image_path,
+                           const epaper_convert_options_t *options) {
+    epaper_frame_t frame;
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    bool success = convert_image(ctx, image_path, options, &frame) &&
+                   send_frame_timed(ctx, fd, &frame);
+    report_stats(ctx, options, success);
+    return success;
+}
+
+bool epaper_ctx_send_encoded_buffer(epaper_ctx_t *ctx, int fd, const void *data, size_t size,
+                                    const epaper_convert_options_t *options) {
+    epaper_frame_t frame;
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    bool success = convert_encoded_buffer(ctx, data, size, options, &frame) &&
+                   send_frame_timed(ctx, fd, &frame);
+    report_stats(ctx, options, success);
+    return success;
+}
+
+bool epaper_ctx_send_pixels(epaper_ctx_t *ctx, int fd, const void *pixels, int width, int height,
+                            size_t stride, epaper_pixel_format_t format,
+                            const epaper_convert_options_t *options) {
+    epaper_frame_t frame;
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    bool success = convert_pixels(ctx, pixels, width, height, stride, format, options, &frame) &&
+                   send_frame_timed(ctx, fd, &frame);
+    report_stats(ctx, options, success);
+    return success;
+}
+
+// The context-free entry points run on a throwaway context: no pool, resize
+// threads as requested in options, and the arena freed before returning
+static void init_oneshot_ctx(epaper_ctx_t *ctx, const epaper_convert_options_t *options) {
+    epaper_arena_init(&ctx->arena);
+    ctx->pool = NULL;
+    ctx->num_threads = options ? options->num_threads : 0;
+}
+
+bool epaper_send_image_advanced(int fd, const char *image_path, const epaper_convert_options_t *options) {
+    epaper_ctx_t ctx;
+    
+    init_oneshot_ctx(&ctx, options);
+    bool success = epaper_ctx_send_image(&ctx, fd, image_path, options);
+    epaper_arena_release(&ctx.arena);
+    return success;
+}
+
+bool epaper_send_encoded_buffer(int fd, const void *data, size_t size,
+                                const epaper_convert_options_t *options) {
+    epaper_ctx_t ctx;
     
-    free(send_buffer);
-    free(mono_buffer);
+    init_oneshot_ctx(&ctx, options);
+    bool success = epaper_ctx_send_encoded_buffer(&ctx, fd, data, size, options);
+    epaper_arena_release(&ctx.arena);
     return success;
-}
\ No newline at end of file
+}
+
+bool epaper_send_pixels(int fd, const void *pixels, int width, int height, size_t stride,
+                        epaper_pixel_format_t format, const epaper_convert_options_t *options) {
+    epaper_ctx_t ctx;
+    
+    init_oneshot_ctx(&ctx, options);
+    bool success = epaper_ctx_send_pixels(&ctx, fd, pixels, width, height, stride, format, options);
+    epaper_arena_release(&ctx.arena);
+    return success;
+}
@@ -2,7 +2,9 @@
 #define SEND_EPAPER_DATA_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "resize_epaper_image.h"
 
 // Image header structure matching kernel driver
 typedef struct
@@ -13,6 +15,47 @@ typedef struct
     uint16_t header_checksum;
 } __attribute__((packed)) image_header_t;
 
+// TX driver ioctl matching kernel driver: abandon the frame being written
+#define EPAPER_TX_IOC_ABORT 0x2001
+
+typedef enum
+{
+    EPAPER_SCALE_STRETCH = 0,   // scale both axes independently to the target
+    EPAPER_SCALE_FIT,           // keep aspect, letterbox the unused area
+    EPAPER_SCALE_FILL,          // keep aspect, crop the overflow around the centre
+    EPAPER_SCALE_CROP           // no scaling, centre crop and letterbox at 1:1
+} epaper_scale_mode_t;
+
+typedef enum
+{
+    EPAPER_PIXEL_GRAY8 = 0,
+    EPAPER_PIXEL_RGB24,
+    EPAPER_PIXEL_RGBA32
+} epaper_pixel_format_t;
+
+// Per-stage cost of one conversion (and transmission, for the send calls).
+// Stages that did not run stay 0; cache hits are accounted as decode.
+typedef enum
+{
+    EPAPER_STAGE_DECODE = 0,    // file or buffer to a luminance plane
+    EPAPER_STAGE_RESIZE,
+    EPAPER_STAGE_GRAY,          // colour pixels to luminance (decoders emit luminance directly)
+    EPAPER_STAGE_DITHER,
+    EPAPER_STAGE_PACK,          // threshold and 1-bit packing
+    EPAPER_STAGE_WRITE,
+    EPAPER_STAGE_COUNT
+} epaper_stage_t;
+
+typedef struct
+{
+    uint64_t ns[EPAPER_STAGE_COUNT];
+    uint64_t bytes[EPAPER_STAGE_COUNT];     // output of each stage
+    bool cache_hit;
+    bool success;
+} epaper_stage_stats_t;
+
+typedef void (*epaper_stats_callback_t)(const epaper_stage_stats_t *stats, void *user_data);
+
 typedef struct
 {
     int target_width;
@@ -20,12 +63,128 @@ typedef struct
     bool use_dithering;
     bool invert_colors;
     int threshold;
+    epaper_resize_filter_t resize_filter;
+    int num_threads;
+    epaper_scale_mode_t scale_mode;
+    bool letterbox_black;
+    const char *cache_dir;      // NULL disables the converted-frame cache
+    size_t cache_max_bytes;     // 0 selects the default cap
+    epaper_stats_callback_t stats_callback;  // called on the converting thread, NULL for none
+    void *stats_user_data;
 } epaper_convert_options_t;
 
+// Conversion context: scratch memory that is kept and reused from one send to
+// the next, plus an optional pool of conversion threads. Once the buffers have
+// grown to the largest frame seen, sends through a context stop allocating.
+// A context must not be used by more than one thread at a time.
+typedef struct epaper_ctx epaper_ctx_t;
+
+// A converted frame: header followed by the packed 1-bit payload, exactly as
+// written to the TX device. It lives in the context's scratch memory and
+// stays valid until the next call on the same context.
+typedef struct
+{
+    const unsigned char *data;
+    size_t size;
+    int width;
+    int height;
+} epaper_frame_t;
+
 int epaper_open(const char *device_path);
 void epaper_close(int fd);
+// Asks the driver to stop the write() in progress on another thread at the
+// next chunk boundary; that write then fails with ECANCELED. Only the write
+// in flight at the time of the call is affected: with none, nothing happens
+bool epaper_abort(int fd);
 bool epaper_send_image(int fd, const char *image_path);
 bool epaper_send_image_resized(int fd, const char *image_path, int target_width, int target_height);
 bool epaper_send_image_advanced(int fd, const char *image_path, const epaper_convert_options_t *options);
+bool epaper_send_encoded_buffer(int fd, const void *data, size_t size, const epaper_convert_options_t *options);
+bool epaper_send_pixels(int fd, const void *pixels, int width, int height, size_t stride,
+                        epaper_pixel_format_t format, const epaper_convert_options_t *options);
+
+// num_threads <= 1 converts on the calling thread only
+epaper_ctx_t *epaper_ctx_create(int num_threads);
+void epaper_ctx_destroy(epaper_ctx_t *ctx);
+bool epaper_ctx_send_image(epaper_ctx_t *ctx, int fd, const char *image_path,
+                           const epaper_convert_options_t *options);
+bool epaper_ctx_send_encoded_buffer(epaper_ctx_t *ctx, int fd, const void *data, size_t size,
+                                    const epaper_convert_options_t *options);
+bool epaper_ctx_send_pixels(epaper_ctx_t *ctx, int fd, const void *pixels, int width, int height,
+                            size_t stride, epaper_pixel_format_t format,
+                            const epaper_convert_options_t *options);
+
+// Conversion and transmission as separate steps, so that the next frame can
+// be converted on another context while the current one is on the wire
+bool epaper_ctx_convert_image(epaper_ctx_t *ctx, const char *image_path,
+                              const epaper_convert_options_t *options, epaper_frame_t *frame);
+bool epaper_ctx_convert_encoded_buffer(epaper_ctx_t *ctx, const void *data, size_t size,
+                                       const epaper_convert_options_t *options,
+                                       epaper_frame_t *frame);
+bool epaper_ctx_convert_pixels(epaper_ctx_t *ctx, const void *pixels, int width, int height,
+                               size_t stride, epaper_pixel_format_t format,
+                               const epaper_convert_options_t *options, epaper_frame_t *frame);
+bool epaper_send_frame(int fd, const epaper_frame_t *frame);
+
+// One image per TX device, sent to all devices in parallel threads. Each
+// distinct image_path is converted once with ctx, and its links start
+// transmitting while the next image is converted, so the wall time is about
+// that of the slowest link. fds must be distinct devices. Returns the number
+// of failed targets; status holds 0 or a negative errno per target.
+typedef struct
+{
+    int fd;
+    const char *image_path;
+    int status;
+} epaper_multi_target_t;
+
+int epaper_ctx_send_multi(epaper_ctx_t *ctx, epaper_multi_target_t *targets, int count,
+                          const epaper_convert_options_t *options);
+
+// Asynchronous sending for event-loop applications. An executor owns a pool
+// of workers, each with its own conversion context; jobs for the same device
+// fd run one at a time in submission order, jobs for different devices run
+// in parallel. Completions are queued and an eventfd becomes readable;
+// epaper_async_dispatch() then runs the callbacks on the calling thread with
+// status 0 or a negative errno (-ECANCELED for cancelled jobs). A job handle
+// is valid until its callback has returned. Buffers passed to
+// epaper_send_encoded_buffer_async() must stay valid until then as well.
+typedef struct epaper_async epaper_async_t;
+typedef struct epaper_async_job epaper_async_job_t;
+typedef void (*epaper_async_callback_t)(epaper_async_job_t *job, int status, void *user_data);
+
+epaper_async_t *epaper_async_create(int num_workers, int convert_threads);
+void epaper_async_destroy(epaper_async_t *async);  // waits for running jobs, cancels queued ones
+int epaper_async_fd(const epaper_async_t *async);  // poll for POLLIN, then dispatch
+int epaper_async_dispatch(epaper_async_t *async);  // returns the number of callbacks run
+epaper_async_job_t *epaper_send_async(epaper_async_t *async, int fd, const char *image_path,
+                                      const epaper_convert_options_t *options,
+                                      epaper_async_callback_t callback, void *user_data);
+epaper_async_job_t *epaper_send_encoded_buffer_async(epaper_async_t *async, int fd,
+                                                     const void *data, size_t size,
+                                                     const epaper_convert_options_t *options,
+                                                     epaper_async_callback_t callback,
+                                                     void *user_data);
+// Removes a queued job, or aborts a running one at the next chunk boundary.
+// A job cancelled just before its write reaches the driver is still sent.
+bool epaper_async_cancel(epaper_async_t *async, epaper_async_job_t *job);
+
+// Sealed memfd buffers for handing an encoded image or a converted frame to
+// another process without copying it through a socket. The producer fills
+// data after epaper_shm_create(), seals it and passes fd (e.g. SCM_RIGHTS);
+// the receiver maps it read-only with epaper_shm_open_sealed(), which fails
+// unless the size and contents are sealed against further change.
+typedef struct
+{
+    int fd;
+    unsigned char *data;
+    size_t size;
+    bool writable;
+} epaper_shm_t;
+
+bool epaper_shm_create(epaper_shm_t *shm, const char *name, size_t size);
+bool epaper_shm_seal(epaper_shm_t *shm);
+bool epaper_shm_open_sealed(epaper_shm_t *shm, int fd, size_t size);  // takes ownership of fd
+void epaper_shm_close(epaper_shm_t *shm);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,114 @@
+#define _GNU_SOURCE
+#include "send_epaper_data.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define REQUIRED_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+static void reset_shm(epaper_shm_t *shm) {
+    shm->fd = -1;
+    shm->data = NULL;
+    shm->size = 0;
+    shm->writable = false;
+}
+
+bool epaper_shm_create(epaper_shm_t *shm, const char *name, size_t size) {
+    reset_shm(shm);
+    if (size == 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    int fd = memfd_create(name ? name : "epaper-frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    shm->fd = fd;
+    shm->data = data;
+    shm->size = size;
+    shm->writable = true;
+    return true;
+}
+
+bool epaper_shm_seal(epaper_shm_t *shm) {
+    if (!shm->writable) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // F_SEAL_WRITE is refused while a writable shared mapping exists
+    munmap(shm->data, shm->size);
+    shm->data = NULL;
+    shm->writable = false;
+
+    if (fcntl(shm->fd, F_ADD_SEALS, REQUIRED_SEALS | F_SEAL_SEAL) < 0) {
+        return false;
+    }
+
+    void *data = mmap(NULL, shm->size, PROT_READ, MAP_PRIVATE, shm->fd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    shm->data = data;
+    return true;
+}
+
+bool epaper_shm_open_sealed(epaper_shm_t *shm, int fd, size_t size) {
+    struct stat st;
+
+    reset_shm(shm);
+
+    // Without these seals the sender could change or truncate the pages
+    // while they are being converted or transmitted
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & REQUIRED_SEALS) != REQUIRED_SEALS) {
+        close(fd);
+        errno = EPERM;
+        return false;
+    }
+    if (fstat(fd, &st) < 0 || size == 0 || (size_t)st.st_size < size) {
+        close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    shm->fd = fd;
+    shm->data = data;
+    shm->size = size;
+    return true;
+}
+
+void epaper_shm_close(epaper_shm_t *shm) {
+    if (!shm) {
+        return;
+    }
+    if (shm->data) {
+        munmap(shm->data, shm->size);
+    }
+    if (shm->fd >= 0) {
+        close(shm->fd);
+    }
+    reset_shm(shm);
+}
@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include "transport_epaper_link.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// Unix and TCP stream sockets carrying frames exactly as written to a TX
+// device, back to back. The RX side listens and serves one sender at a
+// time; the TX side connects. A write returns once the frame is queued in
+// the socket, there is no per-frame acknowledgement.
+
+#define LISTEN_BACKLOG 4
+
+typedef struct
+{
+    int conn_fd;                // accepted sender, -1 until one connects
+    char *unix_path;            // RX Unix socket, unlinked on close
+} socket_end_t;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int remaining_ms(int timeout_ms, uint64_t deadline_ms) {
+    if (timeout_ms < 0) return -1;
+    uint64_t now = now_ms();
+    return now >= deadline_ms ? 0 : (int)(deadline_ms - now);
+}
+
+// Returns 1 when readable, 0 on timeout, -1 on error
+static int wait_readable(int fd, int timeout_ms) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int ret;
+
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+static bool unix_address(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) == 0 || strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+static bool socket_end_create(epaper_transport_t *t) {
+    socket_end_t *end = calloc(1, sizeof(*end));
+
+    if (!end) return false;
+    end->conn_fd = -1;
+    t->priv = end;
+    return true;
+}
+
+static bool unix_open(epaper_transport_t *t, const char *address, bool receive) {
+    struct sockaddr_un addr;
+    struct stat st;
+    bool ok;
+
+    if (!unix_address(address, &addr) || !socket_end_create(t)) return false;
+    socket_end_t *end = t->priv;
+
+    t->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (t->fd < 0) {
+        ok = false;
+    } else if (!receive) {
+        ok = connect(t->fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    } else {
+        // A socket file left by a receiver that died would make bind() fail
+        if (stat(address, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(address);
+        }
+        ok = bind(t->fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+             (end->unix_path = strdup(address)) != NULL &&
+             listen(t->fd, LISTEN_BACKLOG) == 0;
+    }
+
+    if (!ok) {
+        int err = errno;
+        if (end->unix_path) {
+            unlink(end->unix_path);
+            free(end->unix_path);
+        }
+        if (t->fd >= 0) close(t->fd);
+        free(end);
+        t->fd = -1;
+        t->priv = NULL;
+        errno = err;
+    }
+    return ok;
+}
+
+// "host:port" or "[v6-host]:port"; an empty host listens on all
+// addresses and connects to localhost
+static bool tcp_open(epaper_transport_t *t, const char *address, bool receive) {
+    char host[256];
+    const char *colon = strrchr(address, ':');
+    struct addrinfo hints = { 0 }, *list, *ai;
+    size_t host_len;
+    int ret;
+
+    if (!colon || colon[1] == '\0') {
+        errno = EINVAL;
+        return false;
+    }
+    host_len = colon - address;
+    if (host_len >= 2 && address[0] == '[' && address[host_len - 1] == ']') {
+        address++;
+        host_len -= 2;
+    }
+    if (host_len >= sizeof(host)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    memcpy(host, address, host_len);
+    host[host_len] = '\0';
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = receive ? AI_PASSIVE : 0;
+    ret = getaddrinfo(host_len ? host : NULL, colon + 1, &hints, &list);
+    if (ret != 0) {
+        fprintf(stderr, "Failed to resolve %s: %s\n", host_len ? host : "localhost", gai_strerror(ret));
+        errno = EHOSTUNREACH;
+        return false;
+    }
+    if (!socket_end_create(t)) {
+        freeaddrinfo(list);
+        return false;
+    }
+
+    for (ai = list; ai; ai = ai->ai_next) {
+        int one = 1;
+
+        t->fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (t->fd < 0) continue;
+        if (receive) {
+            setsockopt(t->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(t->fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(t->fd, LISTEN_BACKLOG) == 0) break;
+        } else if (connect(t->fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            // Frames go out in one send, waiting for more data only adds latency
+            setsockopt(t->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            break;
+        }
+        int err = errno;
+        close(t->fd);
+        t->fd = -1;
+        errno = err;
+    }
+    freeaddrinfo(list);
+
+    if (t->fd < 0) {
+        free(t->priv);
+        t->priv = NULL;
+        return false;
+    }
+    return true;
+}
+
+static ssize_t socket_write(epaper_transport_t *t, const void *frame, size_t size) {
+    const unsigned char *p = frame;
+    size_t total = 0;
+
+    while (total < size) {
+        ssize_t n = send(t->fd, p + total, size - total, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        total += n;
+    }
+    return (ssize_t)size;
+}
+
+// Accepts a sender on demand; when it disconnects the read returns 0 and
+// the next one waits for a new sender
+static ssize_t socket_read(epaper_transport_t *t, void *buffer, size_t size, int timeout_ms) {
+    socket_end_t *end = t->priv;
+    uint64_t deadline = now_ms() + (timeout_ms > 0 ? timeout_ms : 0);
+    int ret;
+
+    while (end->conn_fd < 0) {
+        ret = wait_readable(t->fd, remaining_ms(timeout_ms, deadline));
+        if (ret < 0) return -1;
+        if (ret == 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        end->conn_fd = accept4(t->fd, NULL, NULL, SOCK_CLOEXEC);
+        if (end->conn_fd < 0 && errno != EINTR && errno != ECONNABORTED) return -1;
+    }
+
+    ret = wait_readable(end->conn_fd, remaining_ms(timeout_ms, deadline));
+    if (ret < 0) return -1;
+    if (ret == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    ssize_t n;
+    do {
+        n = recv(end->conn_fd, buffer, size, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        int err = errno;
+        close(end->conn_fd);
+        end->conn_fd = -1;
+        errno = err;
+    }
+    return n;
+}
+
+static void socket_close(epaper_transport_t *t) {
+    socket_end_t *end = t->priv;
+
+    if (end->conn_fd >= 0) close(end->conn_fd);
+    close(t->fd);
+    if (end->unix_path) {
+        unlink(end->unix_path);
+        free(end->unix_path);
+    }
+    free(end);
+}
+
+const epaper_transport_ops_t epaper_transport_unix = {
+    .scheme = "unix",
+    .open = unix_open,
+    .write = socket_write,
+    .read = socket_read,
+    .abort = NULL,
+    .close = socket_close,
+};
+
+const epaper_transport_ops_t epaper_transport_tcp = {
+    .scheme = "tcp",
+    .open = tcp_open,
+    .write = socket_write,
+    .read = socket_read,
+    .abort = NULL,
+    .close = socket_close,
+};
@@ -0,0 +1,30 @@
+#ifndef TRACE_EPAPER_STAGE_H
+#define TRACE_EPAPER_STAGE_H
+
+#include <stdint.h>
+#include <time.h>
+#include "send_epaper_data.h"
+
+// Static USDT probes at the conversion stage boundaries, provider
+// "libepaper". Built with USE_SDT=1 (needs <sys/sdt.h> from systemtap-sdt);
+// otherwise they compile to nothing. Each is a single nop when not traced.
+#ifdef EPAPER_USE_SDT
+#include <sys/sdt.h>
+#define EPAPER_PROBE(name, ...) STAP_PROBEV(libepaper, name, ##__VA_ARGS__)
+#else
+#define EPAPER_PROBE(name, ...) do { } while (0)
+#endif
+
+static inline uint64_t epaper_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void epaper_stage_add(epaper_stage_stats_t *stats, epaper_stage_t stage,
+                                    uint64_t start_ns, size_t bytes) {
+    stats->ns[stage] += epaper_now_ns() - start_ns;
+    stats->bytes[stage] += bytes;
+}
+
+#endif
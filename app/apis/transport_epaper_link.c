@@ -0,0 +1,533 @@
+#define _GNU_SOURCE
+#include "transport_epaper_link.h"
+#include "send_epaper_data.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+#define MAX_BACKENDS 16
+#define MAX_SCHEME 16
+#define MAX_FRAME_DATA (1920 * 1080)    // MAX_IMAGE_SIZE in the drivers
+#define LOOPBACK_DEPTH 4                // frames queued before TX blocks
+#define LOOPBACK_TIMEOUT_MS 2000        // the TX driver's ACK timeout
+#define LOOPBACK_NAME_SIZE 64
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t registry_idle = PTHREAD_COND_INITIALIZER;    // some refs dropped to 0
+static const epaper_transport_ops_t *backends[MAX_BACKENDS] = {
+    &epaper_transport_unix,
+    &epaper_transport_tcp,
+    &epaper_transport_file,
+    &epaper_transport_loopback,
+    &epaper_transport_gpiod,
+};
+static int num_backends = 5;
+
+// Open transports by handle; plain device fds are never listed here, so
+// the driver path costs one short scan per frame
+static epaper_transport_t **open_transports;
+static int num_open;
+static int open_capacity;
+
+// Splits "scheme:address"; a '/' before the colon means a plain path
+static const epaper_transport_ops_t *find_backend(const char *path, const char **address) {
+    const char *colon = strchr(path, ':');
+    size_t length = colon ? (size_t)(colon - path) : 0;
+
+    *address = path;
+    if (length == 0 || length >= MAX_SCHEME || memchr(path, '/', length)) {
+        return &epaper_transport_chardev;
+    }
+
+    const epaper_transport_ops_t *ops = &epaper_transport_chardev;
+    pthread_mutex_lock(&registry_lock);
+    for (int i = 0; i < num_backends; i++) {
+        if (strlen(backends[i]->scheme) == length && strncmp(backends[i]->scheme, path, length) == 0) {
+            ops = backends[i];
+            *address = colon + 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return ops;
+}
+
+// Takes a reference that keeps the transport from being freed by a close
+// on another thread; drop it with put_open()
+static epaper_transport_t *find_open(int fd) {
+    epaper_transport_t *t = NULL;
+
+    pthread_mutex_lock(&registry_lock);
+    for (int i = 0; i < num_open; i++) {
+        if (open_transports[i]->fd == fd) {
+            t = open_transports[i];
+            t->refs++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return t;
+}
+
+static void put_open(epaper_transport_t *t) {
+    pthread_mutex_lock(&registry_lock);
+    if (--t->refs == 0) {
+        pthread_cond_broadcast(&registry_idle);
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
+
+bool epaper_transport_register(const epaper_transport_ops_t *ops) {
+    bool ok = false;
+
+    if (!ops || !ops->scheme || !ops->open || !ops->write || !ops->read || !ops->close ||
+        strlen(ops->scheme) == 0 || strlen(ops->scheme) >= MAX_SCHEME) {
+        errno = EINVAL;
+        return false;
+    }
+    pthread_mutex_lock(&registry_lock);
+    if (num_backends < MAX_BACKENDS) {
+        backends[num_backends++] = ops;
+        ok = true;
+    } else {
+        errno = ENOSPC;
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return ok;
+}
+
+const epaper_transport_ops_t *epaper_transport_lookup(const char *path) {
+    const char *address;
+    return find_backend(path, &address);
+}
+
+int epaper_transport_open(const char *path, bool receive) {
+    const char *address;
+    const epaper_transport_ops_t *ops = find_backend(path, &address);
+
+    if (ops == &epaper_transport_chardev) {
+        epaper_transport_t device = { .ops = ops, .fd = -1 };
+        return ops->open(&device, address, receive) ? device.fd : -1;
+    }
+
+    epaper_transport_t *t = calloc(1, sizeof(*t));
+    if (!t) return -1;
+    t->ops = ops;
+    t->fd = -1;
+    if (!ops->open(t, address, receive)) {
+        free(t);
+        return -1;
+    }
+    if (t->fd < 0) {
+        t->fd = eventfd(0, EFD_CLOEXEC);
+        t->owns_fd = true;
+        if (t->fd < 0) {
+            int err = errno;
+            ops->close(t);
+            free(t);
+            errno = err;
+            return -1;
+        }
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    if (num_open == open_capacity) {
+        int capacity = open_capacity ? open_capacity * 2 : 8;
+        epaper_transport_t **grown = realloc(open_transports, capacity * sizeof(*grown));
+        if (!grown) {
+            pthread_mutex_unlock(&registry_lock);
+            ops->close(t);
+            if (t->owns_fd) close(t->fd);
+            free(t);
+            errno = ENOMEM;
+            return -1;
+        }
+        open_transports = grown;
+        open_capacity = capacity;
+    }
+    open_transports[num_open++] = t;
+    pthread_mutex_unlock(&registry_lock);
+    return t->fd;
+}
+
+// Backends other than the driver get the header checked here, since a
+// frame whose length disagrees with its header would desynchronise every
+// frame after it on a byte stream
+ssize_t epaper_transport_write(int fd, const void *frame, size_t size) {
+    epaper_transport_t *t = find_open(fd);
+
+    if (!t) return write(fd, frame, size);
+
+    image_header_t header;
+    ssize_t ret = -1;
+    if (size >= sizeof(header)) {
+        memcpy(&header, frame, sizeof(header));
+    }
+    if (size < sizeof(header) || header.data_length != size - sizeof(header) ||
+        header.data_length > MAX_FRAME_DATA) {
+        errno = EINVAL;
+    } else {
+        ret = t->ops->write(t, frame, size);
+    }
+    int err = errno;
+    put_open(t);
+    errno = err;
+    return ret;
+}
+
+ssize_t epaper_transport_read(int fd, void *buffer, size_t size, int timeout_ms) {
+    epaper_transport_t *t = find_open(fd);
+
+    if (!t) {
+        epaper_transport_t device = { .ops = &epaper_transport_chardev, .fd = fd };
+        return epaper_transport_chardev.read(&device, buffer, size, timeout_ms);
+    }
+    ssize_t ret = t->ops->read(t, buffer, size, timeout_ms);
+    int err = errno;
+    put_open(t);
+    errno = err;
+    return ret;
+}
+
+bool epaper_transport_abort(int fd) {
+    epaper_transport_t *t = find_open(fd);
+    bool ok = false;
+
+    if (!t) return ioctl(fd, EPAPER_TX_IOC_ABORT) == 0;
+    if (!t->ops->abort) {
+        errno = ENOTSUP;
+    } else {
+        ok = t->ops->abort(t);
+    }
+    int err = errno;
+    put_open(t);
+    errno = err;
+    return ok;
+}
+
+void epaper_transport_close(int fd) {
+    epaper_transport_t *t = NULL;
+
+    if (fd < 0) return;
+    pthread_mutex_lock(&registry_lock);
+    for (int i = 0; i < num_open; i++) {
+        if (open_transports[i]->fd == fd) {
+            t = open_transports[i];
+            open_transports[i] = open_transports[--num_open];
+            break;
+        }
+    }
+    // No new call can find it now; let the ones in flight finish
+    while (t && t->refs > 0) {
+        pthread_cond_wait(&registry_idle, &registry_lock);
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (!t) {
+        close(fd);
+        return;
+    }
+    t->ops->close(t);
+    if (t->owns_fd) close(t->fd);
+    free(t);
+}
+
+// ---- Kernel char device ----
+
+static bool chardev_open(epaper_transport_t *t, const char *address, bool receive) {
+    t->fd = open(address, receive ? O_RDONLY : O_WRONLY);
+    return t->fd >= 0;
+}
+
+static ssize_t chardev_write(epaper_transport_t *t, const void *frame, size_t size) {
+    return write(t->fd, frame, size);
+}
+
+static ssize_t chardev_read(epaper_transport_t *t, void *buffer, size_t size, int timeout_ms) {
+    struct pollfd pfd = { .fd = t->fd, .events = POLLIN };
+
+    for (;;) {
+        int ret = poll(&pfd, 1, timeout_ms);
+        if (ret < 0) return -1;
+        if (ret == 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+
+        ssize_t n = read(t->fd, buffer, size);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+        return n;
+    }
+}
+
+static bool chardev_abort(epaper_transport_t *t) {
+    return ioctl(t->fd, EPAPER_TX_IOC_ABORT) == 0;
+}
+
+static void fd_close(epaper_transport_t *t) {
+    close(t->fd);
+}
+
+const epaper_transport_ops_t epaper_transport_chardev = {
+    .scheme = "chardev",
+    .open = chardev_open,
+    .write = chardev_write,
+    .read = chardev_read,
+    .abort = chardev_abort,
+    .close = fd_close,
+};
+
+// ---- File sink and source ----
+
+static bool file_open(epaper_transport_t *t, const char *address, bool receive) {
+    t->fd = receive ? open(address, O_RDONLY | O_CLOEXEC) :
+                      open(address, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    return t->fd >= 0;
+}
+
+// Unlike the driver a file takes partial writes, so finish the frame here
+static ssize_t file_write(epaper_transport_t *t, const void *frame, size_t size) {
+    const unsigned char *p = frame;
+    size_t total = 0;
+
+    while (total < size) {
+        ssize_t n = write(t->fd, p + total, size - total);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        total += n;
+    }
+    return (ssize_t)size;
+}
+
+// poll() reports regular files as always readable and waits on FIFOs
+const epaper_transport_ops_t epaper_transport_file = {
+    .scheme = "file",
+    .open = file_open,
+    .write = file_write,
+    .read = chardev_read,
+    .abort = NULL,
+    .close = fd_close,
+};
+
+// ---- In-process loopback ----
+
+typedef struct loopback_frame
+{
+    struct loopback_frame *next;
+    size_t size;
+    size_t offset;              // bytes already read
+    unsigned char data[];
+} loopback_frame_t;
+
+typedef struct loopback_channel
+{
+    struct loopback_channel *next;
+    char name[LOOPBACK_NAME_SIZE];
+    int refs;
+    pthread_cond_t cond;        // CLOCK_MONOTONIC; frames queued or space freed
+    loopback_frame_t *head;
+    loopback_frame_t *tail;
+    int depth;
+} loopback_channel_t;
+
+typedef struct
+{
+    loopback_channel_t *channel;
+    bool writing;               // under loopback_lock, like the flag below
+    bool abort_requested;       // only ever set while writing
+} loopback_end_t;
+
+// One lock for all channels: each frame takes it twice, far below the
+// cost of producing the frame
+static pthread_mutex_t loopback_lock = PTHREAD_MUTEX_INITIALIZER;
+static loopback_channel_t *loopback_channels;
+
+static struct timespec deadline_after(int timeout_ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static bool loopback_open(epaper_transport_t *t, const char *address, bool receive) {
+    loopback_end_t *end = calloc(1, sizeof(*end));
+    loopback_channel_t *channel;
+
+    (void)receive;
+    if (!end) return false;
+    if (strlen(address) == 0 || strlen(address) >= LOOPBACK_NAME_SIZE) {
+        free(end);
+        errno = EINVAL;
+        return false;
+    }
+
+    pthread_mutex_lock(&loopback_lock);
+    for (channel = loopback_channels; channel; channel = channel->next) {
+        if (strcmp(channel->name, address) == 0) break;
+    }
+    if (!channel) {
+        channel = calloc(1, sizeof(*channel));
+        if (!channel) {
+            pthread_mutex_unlock(&loopback_lock);
+            free(end);
+            return false;
+        }
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&channel->cond, &attr);
+        pthread_condattr_destroy(&attr);
+        strcpy(channel->name, address);
+        channel->next = loopback_channels;
+        loopback_channels = channel;
+    }
+    channel->refs++;
+    pthread_mutex_unlock(&loopback_lock);
+
+    end->channel = channel;
+    t->priv = end;
+    return true;
+}
+
+// Blocks while LOOPBACK_DEPTH frames wait for a reader, and times out like
+// a TX device with nothing answering on the other end
+static ssize_t loopback_write(epaper_transport_t *t, const void *frame, size_t size) {
+    loopback_end_t *end = t->priv;
+    loopback_channel_t *channel = end->channel;
+    loopback_frame_t *copy = malloc(sizeof(*copy) + size);
+    struct timespec deadline = deadline_after(LOOPBACK_TIMEOUT_MS);
+    int err = 0;
+
+    if (!copy) return -1;
+    memcpy(copy->data, frame, size);
+    copy->size = size;
+    copy->offset = 0;
+    copy->next = NULL;
+
+    pthread_mutex_lock(&loopback_lock);
+    end->writing = true;
+    while (channel->depth >= LOOPBACK_DEPTH && !err) {
+        if (end->abort_requested) {
+            err = ECANCELED;
+        } else if (pthread_cond_timedwait(&channel->cond, &loopback_lock, &deadline) == ETIMEDOUT) {
+            err = ETIMEDOUT;
+        }
+    }
+    if (!err) {
+        if (channel->tail) {
+            channel->tail->next = copy;
+        } else {
+            channel->head = copy;
+        }
+        channel->tail = copy;
+        channel->depth++;
+        pthread_cond_broadcast(&channel->cond);
+    }
+    end->writing = false;
+    end->abort_requested = false;
+    pthread_mutex_unlock(&loopback_lock);
+
+    if (err) {
+        free(copy);
+        errno = err;
+        return -1;
+    }
+    return (ssize_t)size;
+}
+
+static ssize_t loopback_read(epaper_transport_t *t, void *buffer, size_t size, int timeout_ms) {
+    loopback_channel_t *channel = ((loopback_end_t *)t->priv)->channel;
+    struct timespec deadline = deadline_after(timeout_ms > 0 ? timeout_ms : 0);
+    loopback_frame_t *done = NULL;
+    size_t n;
+
+    pthread_mutex_lock(&loopback_lock);
+    while (!channel->head) {
+        int ret = timeout_ms < 0 ? pthread_cond_wait(&channel->cond, &loopback_lock) :
+                  pthread_cond_timedwait(&channel->cond, &loopback_lock, &deadline);
+        if (ret == ETIMEDOUT) {
+            pthread_mutex_unlock(&loopback_lock);
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+
+    loopback_frame_t *frame = channel->head;
+    n = frame->size - frame->offset < size ? frame->size - frame->offset : size;
+    memcpy(buffer, frame->data + frame->offset, n);
+    frame->offset += n;
+    if (frame->offset == frame->size) {
+        channel->head = frame->next;
+        if (!channel->head) channel->tail = NULL;
+        channel->depth--;
+        pthread_cond_broadcast(&channel->cond);
+        done = frame;
+    }
+    pthread_mutex_unlock(&loopback_lock);
+
+    free(done);
+    return (ssize_t)n;
+}
+
+// As with the driver, only a write in progress is stopped; on an idle end
+// the request is dropped
+static bool loopback_abort(epaper_transport_t *t) {
+    loopback_end_t *end = t->priv;
+
+    pthread_mutex_lock(&loopback_lock);
+    if (end->writing) {
+        end->abort_requested = true;
+        pthread_cond_broadcast(&end->channel->cond);
+    }
+    pthread_mutex_unlock(&loopback_lock);
+    return true;
+}
+
+// The channel, and any frames still queued on it, go with its last end
+static void loopback_close(epaper_transport_t *t) {
+    loopback_end_t *end = t->priv;
+    loopback_channel_t *channel = end->channel;
+    bool last;
+
+    pthread_mutex_lock(&loopback_lock);
+    last = --channel->refs == 0;
+    if (last) {
+        loopback_channel_t **link = &loopback_channels;
+        while (*link != channel) link = &(*link)->next;
+        *link = channel->next;
+    }
+    pthread_mutex_unlock(&loopback_lock);
+
+    if (last) {
+        while (channel->head) {
+            loopback_frame_t *next = channel->head->next;
+            free(channel->head);
+            channel->head = next;
+        }
+        pthread_cond_destroy(&channel->cond);
+        free(channel);
+    }
+    free(end);
+}
+
+const epaper_transport_ops_t epaper_transport_loopback = {
+    .scheme = "loopback",
+    .open = loopback_open,
+    .write = loopback_write,
+    .read = loopback_read,
+    .abort = loopback_abort,
+    .close = loopback_close,
+};
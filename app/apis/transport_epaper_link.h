@@ -0,0 +1,72 @@
+#ifndef TRANSPORT_EPAPER_LINK_H
+#define TRANSPORT_EPAPER_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// What sits behind the int handles of epaper_open() and epaper_rx_open().
+// A path with a "scheme:" prefix selects a backend; any other path is a
+// device node and goes to the kernel driver exactly as before:
+//
+//   /dev/epaper_tx0               kernel char device
+//   unix:/run/epaper.sock         Unix stream socket carrying the device framing
+//   tcp:host:port                 the same over TCP; RX listens, TX connects
+//   file:/path                    TX appends frames, RX reads them back in order
+//   loopback:name                 in-process queue from TX to the RX of that name
+//   gpiod:chip,clk,data,ss,ack,nack   userspace GPIO link (USE_GPIOD=1)
+//
+// Every backend carries the same bytes: a frame is an image_header_t
+// followed by data_length bytes, and RX reads yield the frames back to back.
+
+typedef struct epaper_transport epaper_transport_t;
+
+typedef struct
+{
+    const char *scheme;
+    // address is the path after "scheme:". May set t->fd to a descriptor of
+    // its own; otherwise an eventfd is allocated to serve as the handle.
+    // Returns false with errno set.
+    bool (*open)(epaper_transport_t *t, const char *address, bool receive);
+    // One whole frame, with the contract of write() on a TX device
+    ssize_t (*write)(epaper_transport_t *t, const void *frame, size_t size);
+    // Next bytes of the incoming stream; 0 at end of stream, -1 with
+    // ETIMEDOUT once timeout_ms (< 0 waits forever) passes without data
+    ssize_t (*read)(epaper_transport_t *t, void *buffer, size_t size, int timeout_ms);
+    // Stop the write() running on another thread; with none running the
+    // request is dropped. NULL when unsupported
+    bool (*abort)(epaper_transport_t *t);
+    void (*close)(epaper_transport_t *t);
+} epaper_transport_ops_t;
+
+struct epaper_transport
+{
+    const epaper_transport_ops_t *ops;
+    int fd;
+    bool owns_fd;               // fd was allocated by the registry, not the backend
+    int refs;                   // calls in progress, under the registry lock
+    void *priv;
+};
+
+extern const epaper_transport_ops_t epaper_transport_chardev;
+extern const epaper_transport_ops_t epaper_transport_unix;
+extern const epaper_transport_ops_t epaper_transport_tcp;
+extern const epaper_transport_ops_t epaper_transport_file;
+extern const epaper_transport_ops_t epaper_transport_loopback;
+extern const epaper_transport_ops_t epaper_transport_gpiod;
+
+// Adds a backend for "<ops->scheme>:" paths; ops must outlive the process
+bool epaper_transport_register(const epaper_transport_ops_t *ops);
+// The backend a path would open with; chardev for plain paths
+const epaper_transport_ops_t *epaper_transport_lookup(const char *path);
+
+// Handle-level calls behind the send/receive API. Handles that were not
+// opened here (a plain open() of the device) are treated as char devices.
+// Close waits for calls still running on the handle in other threads.
+int epaper_transport_open(const char *path, bool receive);
+ssize_t epaper_transport_write(int fd, const void *frame, size_t size);
+ssize_t epaper_transport_read(int fd, void *buffer, size_t size, int timeout_ms);
+bool epaper_transport_abort(int fd);
+void epaper_transport_close(int fd);
+
+#endif
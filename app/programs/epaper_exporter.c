@@ -0,0 +1,585 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <getopt.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+// Serves the TX/RX driver counters from sysfs and the epaperd queue and
+// conversion counters (epaperd --metrics) as OpenMetrics, over HTTP or as a
+// textfile for node_exporter's textfile collector.
+
+#define DEFAULT_PORT 9641
+#define DEFAULT_INTERVAL 15
+#define DEFAULT_SYSFS "/sys/class"
+#define MAX_DAEMONS 16
+#define MAX_SAMPLES 1024
+
+typedef enum
+{
+    TX_FRAMES, TX_FRAMES_FAILED, TX_BYTES, TX_CHUNKS, TX_RETRIES, TX_NACKS, TX_TIMEOUTS,
+    TX_CRC_FAILURES, TX_ABORTS, TX_LAST_FRAME, TX_LAST_BITRATE,
+    RX_FRAMES, RX_BYTES, RX_CHUNKS, RX_NACKS, RX_TIMEOUTS, RX_CRC_FAILURES, RX_HEADER_ERRORS,
+    RX_ABORTS, RX_LAST_FRAME, RX_LAST_BITRATE,
+    D_UP, D_CLIENTS, D_QUEUE_DEPTH, D_IN_FLIGHT, D_JOBS, D_QUEUE_SECONDS, D_CONVERT_SECONDS,
+    D_SEND_SECONDS, D_SENT_BYTES, D_CACHE_HITS, D_STAGE_SECONDS, D_STAGE_BYTES,
+    NUM_FAMILIES
+} family_id_t;
+
+typedef struct
+{
+    const char *name;
+    bool counter;
+    const char *help;
+} family_t;
+
+static const family_t families[NUM_FAMILIES] = {
+    [TX_FRAMES]         = { "epaper_tx_frames", true, "Frames transmitted successfully" },
+    [TX_FRAMES_FAILED]  = { "epaper_tx_frames_failed", true, "Frames that failed after all retries" },
+    [TX_BYTES]          = { "epaper_tx_bytes", true, "Bytes of successfully transmitted frames" },
+    [TX_CHUNKS]         = { "epaper_tx_chunks", true, "Chunks acknowledged by the receiver" },
+    [TX_RETRIES]        = { "epaper_tx_retries", true, "Frame retries by the cause of the failed attempt" },
+    [TX_NACKS]          = { "epaper_tx_nacks", true, "NACKs received" },
+    [TX_TIMEOUTS]       = { "epaper_tx_timeouts", true, "ACK waits that timed out" },
+    [TX_CRC_FAILURES]   = { "epaper_tx_crc_failures", true, "CRC blocks rejected by the receiver" },
+    [TX_ABORTS]         = { "epaper_tx_aborts", true, "Frames aborted through the ioctl" },
+    [TX_LAST_FRAME]     = { "epaper_tx_last_frame_seconds", false, "Duration of the last frame" },
+    [TX_LAST_BITRATE]   = { "epaper_tx_last_bits_per_second", false, "Throughput of the last frame" },
+    [RX_FRAMES]         = { "epaper_rx_frames", true, "Frames received with a valid CRC" },
+    [RX_BYTES]          = { "epaper_rx_bytes", true, "Bytes of successfully received frames" },
+    [RX_CHUNKS]         = { "epaper_rx_chunks", true, "Data chunks received" },
+    [RX_NACKS]          = { "epaper_rx_nacks", true, "NACKs sent" },
+    [RX_TIMEOUTS]       = { "epaper_rx_timeouts", true, "Blocks abandoned by the inactivity timer" },
+    [RX_CRC_FAILURES]   = { "epaper_rx_crc_failures", true, "Frames rejected for a CRC mismatch" },
+    [RX_HEADER_ERRORS]  = { "epaper_rx_header_errors", true, "Headers rejected" },
+    [RX_ABORTS]         = { "epaper_rx_aborts", true, "Frames abandoned by the transmitter" },
+    [RX_LAST_FRAME]     = { "epaper_rx_last_frame_seconds", false, "Duration of the last frame" },
+    [RX_LAST_BITRATE]   = { "epaper_rx_last_bits_per_second", false, "Throughput of the last frame" },
+    [D_UP]              = { "epaperd_up", false, "Whether the epaperd metrics file could be read" },
+    [D_CLIENTS]         = { "epaperd_clients", false, "Connected clients" },
+    [D_QUEUE_DEPTH]     = { "epaperd_queue_depth", false, "Jobs waiting for conversion" },
+    [D_IN_FLIGHT]       = { "epaperd_jobs_in_flight", false, "Jobs converting, converted or on the wire" },
+    [D_JOBS]            = { "epaperd_jobs", true, "Finished jobs by result" },
+    [D_QUEUE_SECONDS]   = { "epaperd_queue_seconds", true, "Time jobs spent queued" },
+    [D_CONVERT_SECONDS] = { "epaperd_convert_seconds", true, "Time spent converting" },
+    [D_SEND_SECONDS]    = { "epaperd_send_seconds", true, "Time spent writing to the device" },
+    [D_SENT_BYTES]      = { "epaperd_sent_bytes", true, "Bytes of frames sent successfully" },
+    [D_CACHE_HITS]      = { "epaperd_cache_hits", true, "Conversions served from the frame cache" },
+    [D_STAGE_SECONDS]   = { "epaperd_stage_seconds", true, "Time spent per conversion stage" },
+    [D_STAGE_BYTES]     = { "epaperd_stage_bytes", true, "Output bytes per conversion stage" },
+};
+
+// A sysfs stats attribute and the family it feeds
+typedef struct
+{
+    const char *attr;
+    family_id_t family;
+    const char *label;          // extra label, or NULL
+    double scale;
+} sysfs_metric_t;
+
+static const sysfs_metric_t tx_metrics[] = {
+    { "frames", TX_FRAMES, NULL, 1 },
+    { "frames_failed", TX_FRAMES_FAILED, NULL, 1 },
+    { "bytes", TX_BYTES, NULL, 1 },
+    { "chunks", TX_CHUNKS, NULL, 1 },
+    { "retries_timeout", TX_RETRIES, "cause=\"timeout\"", 1 },
+    { "retries_nack", TX_RETRIES, "cause=\"nack\"", 1 },
+    { "nacks", TX_NACKS, NULL, 1 },
+    { "timeouts", TX_TIMEOUTS, NULL, 1 },
+    { "crc_failures", TX_CRC_FAILURES, NULL, 1 },
+    { "aborts", TX_ABORTS, NULL, 1 },
+    { "last_frame_us", TX_LAST_FRAME, NULL, 1e-6 },
+    { "last_bits_per_sec", TX_LAST_BITRATE, NULL, 1 },
+};
+
+static const sysfs_metric_t rx_metrics[] = {
+    { "frames", RX_FRAMES, NULL, 1 },
+    { "bytes", RX_BYTES, NULL, 1 },
+    { "chunks", RX_CHUNKS, NULL, 1 },
+    { "nacks", RX_NACKS, NULL, 1 },
+    { "timeouts", RX_TIMEOUTS, NULL, 1 },
+    { "crc_failures", RX_CRC_FAILURES, NULL, 1 },
+    { "header_errors", RX_HEADER_ERRORS, NULL, 1 },
+    { "aborts", RX_ABORTS, NULL, 1 },
+    { "last_frame_us", RX_LAST_FRAME, NULL, 1e-6 },
+    { "last_bits_per_sec", RX_LAST_BITRATE, NULL, 1 },
+};
+
+// Keys of the epaperd --metrics file; "stage_*" keys carry the stage name
+// after a dot and become a stage label
+typedef struct
+{
+    const char *key;
+    family_id_t family;
+    const char *label;
+} daemon_metric_t;
+
+static const daemon_metric_t daemon_metrics[] = {
+    { "clients", D_CLIENTS, NULL },
+    { "queue_depth", D_QUEUE_DEPTH, NULL },
+    { "in_flight", D_IN_FLIGHT, NULL },
+    { "jobs_ok", D_JOBS, "result=\"ok\"" },
+    { "jobs_failed", D_JOBS, "result=\"failed\"" },
+    { "jobs_cancelled", D_JOBS, "result=\"cancelled\"" },
+    { "queue_seconds", D_QUEUE_SECONDS, NULL },
+    { "convert_seconds", D_CONVERT_SECONDS, NULL },
+    { "send_seconds", D_SEND_SECONDS, NULL },
+    { "send_bytes", D_SENT_BYTES, NULL },
+    { "cache_hits", D_CACHE_HITS, NULL },
+    { "stage_seconds", D_STAGE_SECONDS, NULL },
+    { "stage_bytes", D_STAGE_BYTES, NULL },
+};
+
+typedef struct
+{
+    family_id_t family;
+    char labels[256];
+    double value;
+} sample_t;
+
+typedef struct
+{
+    sample_t samples[MAX_SAMPLES];
+    int count;
+} scrape_t;
+
+typedef struct
+{
+    const char *sysfs_root;
+    const char *daemon_files[MAX_DAEMONS];
+    int num_daemons;
+} exporter_t;
+
+static volatile sig_atomic_t terminate;
+
+static void handle_terminate(int sig) {
+    (void)sig;
+    terminate = 1;
+}
+
+static void add_sample(scrape_t *scrape, family_id_t family, double value, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void add_sample(scrape_t *scrape, family_id_t family, double value, const char *fmt, ...) {
+    if (scrape->count == MAX_SAMPLES) {
+        return;
+    }
+    sample_t *sample = &scrape->samples[scrape->count++];
+    va_list ap;
+
+    sample->family = family;
+    sample->value = value;
+    va_start(ap, fmt);
+    vsnprintf(sample->labels, sizeof(sample->labels), fmt, ap);
+    va_end(ap);
+}
+
+// Label values are paths and link names, but are escaped all the same
+static void escape_label(char *dst, size_t size, const char *src) {
+    size_t n = 0;
+    for (; *src && n + 2 < size; src++) {
+        if (*src == '"' || *src == '\\') {
+            dst[n++] = '\\';
+            dst[n++] = *src;
+        } else if (*src == '\n') {
+            dst[n++] = '\\';
+            dst[n++] = 'n';
+        } else {
+            dst[n++] = *src;
+        }
+    }
+    dst[n] = '\0';
+}
+
+static bool read_sysfs_value(const char *path, double *value) {
+    FILE *f = fopen(path, "r");
+    long long v;
+
+    if (!f) {
+        return false;
+    }
+    bool ok = fscanf(f, "%lld", &v) == 1;
+    fclose(f);
+    *value = (double)v;
+    return ok;
+}
+
+// Every /sys/class/<class>/<link>/stats directory; the bond device has none
+static void collect_class(scrape_t *scrape, const char *root, const char *class_name,
+                          const sysfs_metric_t *metrics, size_t num_metrics) {
+    char dir_path[512];
+    char path[1024];
+    struct dirent *entry;
+
+    snprintf(dir_path, sizeof(dir_path), "%s/%s", root, class_name);
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        char link[128];
+
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        escape_label(link, sizeof(link), entry->d_name);
+        for (size_t i = 0; i < num_metrics; i++) {
+            double value;
+            snprintf(path, sizeof(path), "%s/%s/stats/%s", dir_path, entry->d_name,
+                     metrics[i].attr);
+            if (!read_sysfs_value(path, &value)) {
+                continue;
+            }
+            if (metrics[i].label) {
+                add_sample(scrape, metrics[i].family, value * metrics[i].scale,
+                           "link=\"%s\",%s", link, metrics[i].label);
+            } else {
+                add_sample(scrape, metrics[i].family, value * metrics[i].scale,
+                           "link=\"%s\"", link);
+            }
+        }
+    }
+    closedir(dir);
+}
+
+static void collect_daemon(scrape_t *scrape, const char *path) {
+    char line[512];
+    char device[256];
+    FILE *f = fopen(path, "r");
+
+    // Until the device line is read, the file name identifies the daemon
+    escape_label(device, sizeof(device), path);
+    if (!f) {
+        add_sample(scrape, D_UP, 0, "device=\"%s\"", device);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        char key[64], text[256];
+        if (sscanf(line, "%63s %255[^\n]", key, text) != 2) {
+            continue;
+        }
+        if (strcmp(key, "device") == 0) {
+            escape_label(device, sizeof(device), text);
+            continue;
+        }
+
+        char *stage = strchr(key, '.');
+        if (stage) {
+            *stage++ = '\0';
+        }
+        double value = strtod(text, NULL);
+        for (size_t i = 0; i < sizeof(daemon_metrics) / sizeof(daemon_metrics[0]); i++) {
+            const daemon_metric_t *m = &daemon_metrics[i];
+            if (strcmp(key, m->key) != 0) {
+                continue;
+            }
+            if (stage) {
+                char stage_label[64];
+                escape_label(stage_label, sizeof(stage_label), stage);
+                add_sample(scrape, m->family, value, "device=\"%s\",stage=\"%s\"", device,
+                           stage_label);
+            } else if (m->label) {
+                add_sample(scrape, m->family, value, "device=\"%s\",%s", device, m->label);
+            } else {
+                add_sample(scrape, m->family, value, "device=\"%s\"", device);
+            }
+            break;
+        }
+    }
+    fclose(f);
+    add_sample(scrape, D_UP, 1, "device=\"%s\"", device);
+}
+
+static void collect(const exporter_t *exporter, scrape_t *scrape) {
+    scrape->count = 0;
+    collect_class(scrape, exporter->sysfs_root, "epaper_tx", tx_metrics,
+                  sizeof(tx_metrics) / sizeof(tx_metrics[0]));
+    collect_class(scrape, exporter->sysfs_root, "epaper_rx", rx_metrics,
+                  sizeof(rx_metrics) / sizeof(rx_metrics[0]));
+    for (int i = 0; i < exporter->num_daemons; i++) {
+        collect_daemon(scrape, exporter->daemon_files[i]);
+    }
+}
+
+// Samples are grouped under their family's metadata as OpenMetrics requires
+static void format_metrics(const scrape_t *scrape, FILE *out) {
+    for (int f = 0; f < NUM_FAMILIES; f++) {
+        bool header = false;
+        for (int i = 0; i < scrape->count; i++) {
+            const sample_t *s = &scrape->samples[i];
+            if (s->family != (family_id_t)f) {
+                continue;
+            }
+            if (!header) {
+                fprintf(out, "# TYPE %s %s\n", families[f].name,
+                        families[f].counter ? "counter" : "gauge");
+                fprintf(out, "# HELP %s %s\n", families[f].name, families[f].help);
+                header = true;
+            }
+            fprintf(out, "%s%s{%s} %.17g\n", families[f].name,
+                    families[f].counter ? "_total" : "", s->labels, s->value);
+        }
+    }
+    fprintf(out, "# EOF\n");
+}
+
+static char *render(const exporter_t *exporter, size_t *length) {
+    static scrape_t scrape;     // too large for the stack of a small helper
+    char *text = NULL;
+
+    collect(exporter, &scrape);
+    FILE *out = open_memstream(&text, length);
+    if (!out) {
+        return NULL;
+    }
+    format_metrics(&scrape, out);
+    if (fclose(out) != 0) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+static bool write_textfile(const exporter_t *exporter, const char *path) {
+    char tmp_path[4096];
+    size_t length;
+    char *text = render(exporter, &length);
+
+    if (!text) {
+        return false;
+    }
+    // Renamed into place so the collector never reads a partial file
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *f = fopen(tmp_path, "w");
+    bool ok = f && fwrite(text, 1, length, f) == length;
+    if (f && fclose(f) != 0) {
+        ok = false;
+    }
+    if (ok && rename(tmp_path, path) < 0) {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s: %s\n", path, strerror(errno));
+        unlink(tmp_path);
+    }
+    free(text);
+    return ok;
+}
+
+static bool send_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t ret = send(fd, data, size, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+// One request per connection; anything but GET /metrics (or /) is a 404
+static void serve_client(const exporter_t *exporter, int fd) {
+    char request[2048];
+    char header[256];
+    size_t got = 0;
+
+    struct timeval timeout = { .tv_sec = 2 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    while (got < sizeof(request) - 1) {
+        ssize_t ret = recv(fd, request + got, sizeof(request) - 1 - got, 0);
+        if (ret <= 0) {
+            break;
+        }
+        got += ret;
+        request[got] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) {
+            break;
+        }
+    }
+    request[got] = '\0';
+
+    if (strncmp(request, "GET /metrics ", 13) != 0 && strncmp(request, "GET / ", 6) != 0) {
+        static const char not_found[] =
+            "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 10\r\n"
+            "Connection: close\r\n\r\nnot found\n";
+        send_all(fd, not_found, sizeof(not_found) - 1);
+        return;
+    }
+
+    size_t length;
+    char *text = render(exporter, &length);
+    if (!text) {
+        static const char error[] =
+            "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\n"
+            "Connection: close\r\n\r\n";
+        send_all(fd, error, sizeof(error) - 1);
+        return;
+    }
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.0 200 OK\r\n"
+                     "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", length);
+    if (send_all(fd, header, n)) {
+        send_all(fd, text, length);
+    }
+    free(text);
+}
+
+static int open_http_socket(const char *address, int port) {
+    struct sockaddr_in addr;
+    int one = 1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+        fprintf(stderr, "Error: Invalid listen address '%s'\n", address);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        fprintf(stderr, "Cannot listen on %s:%d: %s\n", address, port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s [options]\n", prog_name);
+    printf("Options:\n");
+    printf("  -p, --port <n>          Serve /metrics over HTTP on port <n> (default: %d)\n",
+           DEFAULT_PORT);
+    printf("  -a, --address <ip>      Listen address (default: 127.0.0.1)\n");
+    printf("  -o, --textfile <path>   Write the metrics to <path> instead of serving HTTP\n");
+    printf("  -i, --interval <sec>    Textfile rewrite interval (default: %d)\n",
+           DEFAULT_INTERVAL);
+    printf("  -1, --once              Write the textfile once and exit\n");
+    printf("  -D, --daemon <file>     epaperd --metrics file to include (repeatable)\n");
+    printf("  -s, --sysfs <dir>       sysfs class directory (default: %s)\n", DEFAULT_SYSFS);
+    printf("  --help                  Show this help\n");
+}
+
+int main(int argc, char *argv[]) {
+    exporter_t exporter = { .sysfs_root = DEFAULT_SYSFS };
+    const char *address = "127.0.0.1";
+    const char *textfile = NULL;
+    int port = DEFAULT_PORT;
+    int interval = DEFAULT_INTERVAL;
+    bool once = false;
+
+    static struct option long_options[] = {
+        {"port",     required_argument, 0, 'p'},
+        {"address",  required_argument, 0, 'a'},
+        {"textfile", required_argument, 0, 'o'},
+        {"interval", required_argument, 0, 'i'},
+        {"once",     no_argument,       0, '1'},
+        {"daemon",   required_argument, 0, 'D'},
+        {"sysfs",    required_argument, 0, 's'},
+        {"help",     no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:a:o:i:1D:s:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'p':
+            port = atoi(optarg);
+            if (port <= 0 || port > 65535) {
+                fprintf(stderr, "Error: Invalid port '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'a':
+            address = optarg;
+            break;
+        case 'o':
+            textfile = optarg;
+            break;
+        case 'i':
+            interval = atoi(optarg);
+            if (interval < 1) {
+                fprintf(stderr, "Error: Invalid interval '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case '1':
+            once = true;
+            break;
+        case 'D':
+            if (exporter.num_daemons == MAX_DAEMONS) {
+                fprintf(stderr, "Error: At most %d daemon files\n", MAX_DAEMONS);
+                return 1;
+            }
+            exporter.daemon_files[exporter.num_daemons++] = optarg;
+            break;
+        case 's':
+            exporter.sysfs_root = optarg;
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_terminate;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (textfile) {
+        if (once) {
+            return write_textfile(&exporter, textfile) ? 0 : 1;
+        }
+        while (!terminate) {
+            write_textfile(&exporter, textfile);
+            sleep(interval);
+        }
+        return 0;
+    }
+
+    int listen_fd = open_http_socket(address, port);
+    if (listen_fd < 0) {
+        return 1;
+    }
+    printf("Serving metrics on http://%s:%d/metrics\n", address, port);
+
+    while (!terminate) {
+        struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        serve_client(&exporter, fd);
+        close(fd);
+    }
+
+    close(listen_fd);
+    return 0;
+}
@@ -0,0 +1,545 @@
+#define _GNU_SOURCE
+#include "send_epaper_data.h"
+#include "gpiod_epaper_link.h"
+#include "transport_epaper_link.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// Link benchmark: pushes frames of several sizes through a TX device and
+// reads each one back from the RX device it is wired to, either a second
+// link on the same host or the loopback_driver in one kernel. Either side
+// can be the userspace GPIO link instead of a driver, to compare the two,
+// or any libepaper transport (loopback:, unix:, ...) to measure the
+// framing path without hardware.
+// Reports goodput, mean block time, per-block ACK latency (TX driver only),
+// retries and CPU use for every size.
+
+#define DEFAULT_TX "/dev/epaper_tx0"
+#define DEFAULT_RX "/dev/epaper_rx0"
+#define DEFAULT_FRAMES 3
+#define MAX_FRAMES 1000
+#define MAX_SIZES 16
+#define MAX_PAYLOAD (1920 * 1080)   // MAX_IMAGE_SIZE in the drivers
+#define CHUNK_SIZE 1024             // MAX_CHUNK_SIZE in tx_driver.c
+#define HIST_BUCKETS 32             // HIST_BUCKETS in tx_driver.c, bucket i holds [2^i, 2^(i+1)) ns
+#define ROW_BYTES 128
+#define READ_TIMEOUT_MS 2000        // the frame is complete by the time write() returns
+
+// One end of the link: a transport path or a userspace GPIO link
+typedef struct
+{
+    const char *path;
+    int fd;                         // transport handle; -1 for a GPIO link or an RX device
+    epaper_gpiod_link_t *gpiod;
+} link_end_t;
+
+typedef struct
+{
+    uint64_t retries;
+    uint64_t nacks;
+    uint64_t timeouts;
+} link_counters_t;
+
+typedef struct
+{
+    uint64_t busy;
+    uint64_t total;
+} cpu_sample_t;
+
+typedef struct
+{
+    size_t size;
+    int frames;
+    int ok;
+    int corrupt;
+    double goodput_bps;         // median over the successful frames
+    double block_mean_ms_median;    // frame time divided by its blocks
+    double block_mean_ms_max;
+    double ack_ms_median;       // ACK latency of single blocks from the TX driver's
+    double ack_ms_max;          // histogram, bucket upper bounds; -1 when unavailable
+    link_counters_t counters;
+    double process_cpu;         // percent of one CPU
+    double system_cpu;          // percent of all CPUs, includes the IRQ side
+} linkbench_result_t;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double process_cpu_ns(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e9 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e3;
+}
+
+static cpu_sample_t system_cpu(void) {
+    cpu_sample_t sample = { 0, 0 };
+    unsigned long long v[8] = { 0 };
+    FILE *f = fopen("/proc/stat", "r");
+
+    if (!f) return sample;
+    if (fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &v[0], &v[1], &v[2], &v[3],
+               &v[4], &v[5], &v[6], &v[7]) == 8) {
+        for (int i = 0; i < 8; i++) {
+            sample.total += v[i];
+        }
+        sample.busy = sample.total - v[3] - v[4];   // minus idle and iowait
+    }
+    fclose(f);
+    return sample;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// Missing attributes (a device that is not an epaper_tx link) read as 0
+static uint64_t read_stat(const char *tx_path, const char *name) {
+    char path[256];
+    unsigned long long value = 0;
+
+    snprintf(path, sizeof(path), "/sys/class/epaper_tx/%s/stats/%s", base_name(tx_path), name);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    if (fscanf(f, "%llu", &value) != 1) value = 0;
+    fclose(f);
+    return value;
+}
+
+// Bucket counts of the TX driver's ack_latency histogram in debugfs;
+// false when it cannot be read (not a driver link, or debugfs not mounted)
+static bool read_ack_hist(const link_end_t *tx, uint64_t *buckets) {
+    char path[256], line[128];
+
+    memset(buckets, 0, HIST_BUCKETS * sizeof(*buckets));
+    if (tx->gpiod || epaper_transport_lookup(tx->path) != &epaper_transport_chardev) return false;
+    snprintf(path, sizeof(path), "/sys/kernel/debug/epaper_tx/%s/ack_latency", base_name(tx->path));
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long low, count;
+        char *counts = strstr(line, "ns:");
+        int bucket = 0;
+
+        if (sscanf(line, "%llu", &low) != 1 || !counts || sscanf(counts + 3, "%llu", &count) != 1) {
+            continue;
+        }
+        while (bucket < HIST_BUCKETS - 1 && (1ULL << (bucket + 1)) <= low) bucket++;
+        buckets[bucket] = count;
+    }
+    fclose(f);
+    return true;
+}
+
+// Median and maximum of the blocks added between two histogram reads
+static void ack_latency_delta(const uint64_t *before, const uint64_t *after,
+                              linkbench_result_t *result) {
+    uint64_t delta[HIST_BUCKETS], total = 0, seen = 0;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        delta[i] = after[i] - before[i];
+        total += delta[i];
+    }
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        if (!delta[i]) continue;
+        double upper_ms = (double)(1ULL << (i + 1)) / 1e6;
+        seen += delta[i];
+        if (result->ack_ms_median < 0 && seen * 2 >= total) result->ack_ms_median = upper_ms;
+        result->ack_ms_max = upper_ms;
+    }
+}
+
+static link_counters_t read_counters(const link_end_t *tx) {
+    link_counters_t c;
+    if (tx->gpiod) {
+        epaper_gpiod_stats_t stats;
+        epaper_gpiod_get_stats(tx->gpiod, &stats);
+        c.retries = stats.retries;
+        c.nacks = stats.nacks;
+        c.timeouts = stats.timeouts;
+        return c;
+    }
+    c.retries = read_stat(tx->path, "retries_timeout") + read_stat(tx->path, "retries_nack");
+    c.nacks = read_stat(tx->path, "nacks");
+    c.timeouts = read_stat(tx->path, "timeouts");
+    return c;
+}
+
+// xorshift keeps both bit values on the wire in every byte position
+static void fill_payload(unsigned char *data, size_t size, uint32_t seed) {
+    uint32_t x = seed ? seed : 1;
+    for (size_t i = 0; i < size; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        data[i] = (unsigned char)x;
+    }
+}
+
+// The RX device hands out one frame per open, from offset 0; the other
+// transports stay open and yield the frames back to back
+static bool receive_frame(const link_end_t *rx, unsigned char *buffer, size_t size) {
+    if (rx->gpiod) {
+        return epaper_gpiod_read(rx->gpiod, buffer, size, READ_TIMEOUT_MS) == (ssize_t)size;
+    }
+
+    int fd = rx->fd >= 0 ? rx->fd : open(rx->path, O_RDONLY);
+    size_t total = 0;
+
+    if (fd < 0) {
+        perror(rx->path);
+        return false;
+    }
+    while (total < size) {
+        ssize_t n = epaper_transport_read(fd, buffer + total, size - total, READ_TIMEOUT_MS);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        total += n;
+    }
+    if (fd != rx->fd) close(fd);
+    return total == size;
+}
+
+typedef struct
+{
+    const link_end_t *rx;
+    unsigned char *buffer;
+    size_t size;
+    bool ok;
+} receive_job_t;
+
+static void *receive_thread(void *arg) {
+    receive_job_t *job = arg;
+    job->ok = receive_frame(job->rx, job->buffer, job->size);
+    return NULL;
+}
+
+static bool run_size(const link_end_t *tx, const link_end_t *rx, size_t size, int frames,
+                     linkbench_result_t *result) {
+    size_t frame_size = sizeof(image_header_t) + size;
+    unsigned char *frame = malloc(frame_size);
+    unsigned char *received = malloc(frame_size);
+    double *goodput = calloc(frames, sizeof(double));
+    double *block_ms = calloc(frames, sizeof(double));
+    int blocks = 2 + (int)((size + CHUNK_SIZE - 1) / CHUNK_SIZE);   // header, chunks, CRC
+
+    if (!frame || !received || !goodput || !block_ms) {
+        free(frame);
+        free(received);
+        free(goodput);
+        free(block_ms);
+        return false;
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->size = size;
+    result->frames = frames;
+
+    image_header_t *header = (image_header_t *)frame;
+    header->width = ROW_BYTES * 8;
+    header->height = (uint16_t)((size + ROW_BYTES - 1) / ROW_BYTES);
+    header->data_length = (uint32_t)size;
+    header->header_checksum = 0;    // filled in by the driver or GPIO link
+
+    uint64_t hist_before[HIST_BUCKETS], hist_after[HIST_BUCKETS];
+    bool have_hist = read_ack_hist(tx, hist_before);
+    link_counters_t before = read_counters(tx);
+    cpu_sample_t sys_before = system_cpu();
+    double cpu_before = process_cpu_ns();
+    double wall_before = now_ns();
+
+    for (int i = 0; i < frames; i++) {
+        fill_payload(frame + sizeof(image_header_t), size, (uint32_t)(size * 31 + i));
+
+        // A socket only buffers so much, so stream transports are drained
+        // while the frame is written rather than after
+        receive_job_t job = { rx, received, frame_size, false };
+        pthread_t reader;
+        bool threaded = rx->fd >= 0 && pthread_create(&reader, NULL, receive_thread, &job) == 0;
+
+        double start = now_ns();
+        ssize_t written = tx->gpiod ? epaper_gpiod_write(tx->gpiod, frame, frame_size) :
+                          epaper_transport_write(tx->fd, frame, frame_size);
+        double elapsed = now_ns() - start;
+
+        if (written != (ssize_t)frame_size) {
+            fprintf(stderr, "  %zu bytes, frame %d: %s\n", size, i,
+                    written < 0 ? strerror(errno) : "short write");
+            if (threaded) pthread_join(reader, NULL);
+            continue;
+        }
+        if (threaded) {
+            pthread_join(reader, NULL);
+        } else {
+            job.ok = receive_frame(rx, received, frame_size);
+        }
+        if (!job.ok ||
+            memcmp(received + sizeof(image_header_t), frame + sizeof(image_header_t), size) != 0) {
+            result->corrupt++;
+            continue;
+        }
+        goodput[result->ok] = size * 8 / (elapsed / 1e9);
+        block_ms[result->ok] = elapsed / blocks / 1e6;
+        result->ok++;
+    }
+
+    double wall = now_ns() - wall_before;
+    double cpu = process_cpu_ns() - cpu_before;
+    cpu_sample_t sys_after = system_cpu();
+    link_counters_t after = read_counters(tx);
+
+    result->ack_ms_median = result->ack_ms_max = -1;
+    if (have_hist && read_ack_hist(tx, hist_after)) {
+        ack_latency_delta(hist_before, hist_after, result);
+    }
+
+    result->counters.retries = after.retries - before.retries;
+    result->counters.nacks = after.nacks - before.nacks;
+    result->counters.timeouts = after.timeouts - before.timeouts;
+    result->process_cpu = wall > 0 ? cpu / wall * 100.0 : 0;
+    if (sys_after.total > sys_before.total) {
+        result->system_cpu = (double)(sys_after.busy - sys_before.busy) /
+                             (sys_after.total - sys_before.total) * 100.0;
+    }
+    if (result->ok) {
+        qsort(goodput, result->ok, sizeof(double), compare_double);
+        qsort(block_ms, result->ok, sizeof(double), compare_double);
+        result->goodput_bps = goodput[result->ok / 2];
+        result->block_mean_ms_median = block_ms[result->ok / 2];
+        result->block_mean_ms_max = block_ms[result->ok - 1];
+    }
+
+    free(frame);
+    free(received);
+    free(goodput);
+    free(block_ms);
+    return true;
+}
+
+// "-" where the driver histogram was not available
+static void print_ms(double ms) {
+    if (ms < 0) {
+        printf(" %9s", "-");
+    } else {
+        printf(" %9.2f", ms);
+    }
+}
+
+static void print_result(const linkbench_result_t *r) {
+    printf("%8zu %4d/%-4d %7d %12.0f %9.2f %9.2f", r->size, r->ok, r->frames, r->corrupt,
+           r->goodput_bps, r->block_mean_ms_median, r->block_mean_ms_max);
+    print_ms(r->ack_ms_median);
+    print_ms(r->ack_ms_max);
+    printf(" %7llu %6llu %8llu %7.1f%% %6.1f%%\n", (unsigned long long)r->counters.retries,
+           (unsigned long long)r->counters.nacks, (unsigned long long)r->counters.timeouts,
+           r->process_cpu, r->system_cpu);
+}
+
+static bool write_json(const linkbench_result_t *results, int count, const char *tx_path,
+                       const char *rx_path, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "{\n  \"tx\": \"%s\",\n  \"rx\": \"%s\",\n  \"results\": [\n", tx_path, rx_path);
+    for (int i = 0; i < count; i++) {
+        const linkbench_result_t *r = &results[i];
+        fprintf(f, "    {\"size\": %zu, \"frames\": %d, \"ok\": %d, \"corrupt\": %d, "
+                "\"goodput_bps\": %.0f, \"block_mean_ms_median\": %.3f, "
+                "\"block_mean_ms_max\": %.3f, \"ack_ms_median\": %.3f, \"ack_ms_max\": %.3f, "
+                "\"retries\": %llu, \"nacks\": %llu, \"timeouts\": %llu, "
+                "\"process_cpu\": %.1f, \"system_cpu\": %.1f}%s\n",
+                r->size, r->frames, r->ok, r->corrupt, r->goodput_bps, r->block_mean_ms_median,
+                r->block_mean_ms_max, r->ack_ms_median, r->ack_ms_max, (unsigned long long)r->counters.retries,
+                (unsigned long long)r->counters.nacks, (unsigned long long)r->counters.timeouts,
+                r->process_cpu, r->system_cpu, i + 1 < count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+static int parse_sizes(const char *list, size_t *sizes) {
+    char *copy = strdup(list);
+    char *save = NULL;
+    int count = 0;
+
+    for (char *tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char *end;
+        unsigned long value = strtoul(tok, &end, 10);
+        if (*end == 'k' || *end == 'K') {
+            value *= 1024;
+            end++;
+        }
+        if (*end || value == 0 || value > MAX_PAYLOAD || count == MAX_SIZES) {
+            free(copy);
+            return -1;
+        }
+        sizes[count++] = value;
+    }
+    free(copy);
+    return count;
+}
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s [options]\n", prog_name);
+    printf("Options:\n");
+    printf("  -t, --tx <path>         TX device or transport (default: %s)\n", DEFAULT_TX);
+    printf("  -r, --rx <path>         RX device or transport wired to it (default: %s)\n",
+           DEFAULT_RX);
+    printf("  -s, --sizes <list>      Payload sizes in bytes, k suffix allowed\n");
+    printf("                          (default: 256,1k,4k,16k)\n");
+    printf("  -n, --frames <n>        Frames per size (default: %d)\n", DEFAULT_FRAMES);
+    printf("  --gpiod-tx <lines>      Send with the userspace GPIO link instead of -t\n");
+    printf("  --gpiod-rx <lines>      Receive with the userspace GPIO link instead of -r\n");
+    printf("                          lines: chip,clock,data,start-stop,ack,nack\n");
+    printf("  -o, --output <file>     Also write the results as JSON\n");
+    printf("  --help                  Show this help\n");
+}
+
+int main(int argc, char *argv[]) {
+    link_end_t tx = { DEFAULT_TX, -1, NULL };
+    link_end_t rx = { DEFAULT_RX, -1, NULL };
+    const char *gpiod_tx = NULL;
+    const char *gpiod_rx = NULL;
+    const char *output = NULL;
+    size_t sizes[MAX_SIZES] = { 256, 1024, 4096, 16384 };
+    int num_sizes = 4;
+    int frames = DEFAULT_FRAMES;
+
+    static struct option long_options[] = {
+        {"tx",     required_argument, 0, 't'},
+        {"rx",     required_argument, 0, 'r'},
+        {"sizes",  required_argument, 0, 's'},
+        {"frames", required_argument, 0, 'n'},
+        {"output", required_argument, 0, 'o'},
+        {"gpiod-tx", required_argument, 0, 'T'},
+        {"gpiod-rx", required_argument, 0, 'R'},
+        {"help",   no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "t:r:s:n:o:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 't':
+            tx.path = optarg;
+            break;
+        case 'r':
+            rx.path = optarg;
+            break;
+        case 's':
+            num_sizes = parse_sizes(optarg, sizes);
+            if (num_sizes <= 0) {
+                fprintf(stderr, "Error: Invalid size list '%s' (at most %d sizes of 1-%d bytes)\n",
+                        optarg, MAX_SIZES, MAX_PAYLOAD);
+                return 1;
+            }
+            break;
+        case 'n':
+            frames = atoi(optarg);
+            if (frames < 1 || frames > MAX_FRAMES) {
+                fprintf(stderr, "Error: Frames must be 1-%d\n", MAX_FRAMES);
+                return 1;
+            }
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'T':
+            gpiod_tx = optarg;
+            break;
+        case 'R':
+            gpiod_rx = optarg;
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // RX first, so a userspace receiver is already listening for the first frame
+    if (gpiod_rx) {
+        epaper_gpiod_config_t config;
+        epaper_gpiod_config_init(&config);
+        if (!epaper_gpiod_parse_lines(gpiod_rx, &config)) {
+            fprintf(stderr, "Error: Invalid line list '%s'\n", gpiod_rx);
+            return 1;
+        }
+        rx.path = gpiod_rx;
+        rx.gpiod = epaper_gpiod_rx_open(&config);
+        if (!rx.gpiod) return 1;
+    } else if (epaper_transport_lookup(rx.path) != &epaper_transport_chardev) {
+        rx.fd = epaper_transport_open(rx.path, true);
+        if (rx.fd < 0) {
+            perror(rx.path);
+            return 1;
+        }
+    }
+    if (gpiod_tx) {
+        epaper_gpiod_config_t config;
+        epaper_gpiod_config_init(&config);
+        if (!epaper_gpiod_parse_lines(gpiod_tx, &config)) {
+            fprintf(stderr, "Error: Invalid line list '%s'\n", gpiod_tx);
+            epaper_gpiod_close(rx.gpiod);
+            epaper_transport_close(rx.fd);
+            return 1;
+        }
+        tx.path = gpiod_tx;
+        tx.gpiod = epaper_gpiod_tx_open(&config);
+    } else {
+        tx.fd = epaper_transport_open(tx.path, false);
+        if (tx.fd < 0) perror(tx.path);
+    }
+    if (!tx.gpiod && tx.fd < 0) {
+        epaper_gpiod_close(rx.gpiod);
+        epaper_transport_close(rx.fd);
+        return 1;
+    }
+
+    linkbench_result_t results[MAX_SIZES];
+    int failed = 0;
+
+    printf("%s%s -> %s%s, %d frame(s) per size\n", tx.gpiod ? "gpiod:" : "", tx.path,
+           rx.gpiod ? "gpiod:" : "", rx.path, frames);
+    printf("%8s %9s %7s %12s %9s %9s %9s %9s %7s %6s %8s %8s %7s\n", "bytes", "ok", "corrupt",
+           "goodput b/s", "mean blk", "max", "ack ms", "ack max", "retries", "nacks", "timeouts",
+           "cpu", "system");
+    for (int i = 0; i < num_sizes; i++) {
+        if (!run_size(&tx, &rx, sizes[i], frames, &results[i])) {
+            fprintf(stderr, "Error: Out of memory\n");
+            failed = -1;
+            break;
+        }
+        print_result(&results[i]);
+        failed += results[i].ok < results[i].frames;
+    }
+    epaper_transport_close(tx.fd);
+    epaper_transport_close(rx.fd);
+    epaper_gpiod_close(tx.gpiod);
+    epaper_gpiod_close(rx.gpiod);
+    if (failed < 0) return 1;
+
+    if (output && !write_json(results, num_sizes, tx.path, rx.path, output)) {
+        return 1;
+    }
+    return failed ? 2 : 0;
+}
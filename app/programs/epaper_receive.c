@@ -7,7 +7,7 @@
 static void print_usage(const char *prog_name) {
     printf("Usage: %s [options]\n", prog_name);
     printf("Options:\n");
-    printf("  -d, --device <path>     RX device path (default: /dev/epaper_rx)\n");
+    printf("  -d, --device <path>     RX device path (default: /dev/epaper_rx0)\n");
     printf("  -o, --output <file>     Output file path\n");
     printf("  -f, --format <format>   Output format: raw, pbm (default: pbm)\n");
     printf("  -t, --timeout <ms>      Receive timeout in milliseconds (default: 30000)\n");
@@ -15,11 +15,11 @@ static void print_usage(const char *prog_name) {
     printf("  -h, --help             Show this help\n");
     printf("\nExamples:\n");
     printf("  %s -o received.pbm\n", prog_name);
-    printf("  %s -d /dev/epaper_rx -o image.raw -f raw -v\n", prog_name);
+    printf("  %s -d /dev/epaper_rx0 -o image.raw -f raw -v\n", prog_name);
 }
 
 int main(int argc, char *argv[]) {
-    const char *device_path = "/dev/epaper_rx";
+    const char *device_path = "/dev/epaper_rx0";
     const char *output_path = "received_image.pbm";
     const char *format = "pbm";
     int timeout_ms = 30000;
@@ -2,23 +2,632 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <getopt.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "epaperd_protocol.h"
+
+#define DEFAULT_BATCH_JOBS 2
+#define MAX_BATCH_JOBS 16
+#define MAX_DEVICES 16
+
+// One pipeline slot per conversion worker. A worker converts into its own
+// context and then waits until the sender has consumed the frame, because
+// the frame lives in that context's scratch memory.
+typedef struct
+{
+    epaper_ctx_t *ctx;
+    epaper_frame_t frame;
+    bool ready;
+    bool ok;
+    double convert_ms;
+} batch_slot_t;
+
+typedef struct
+{
+    char **paths;
+    int num_paths;
+    long total_frames;          // -1 repeats until interrupted
+    const epaper_convert_options_t *options;
+    batch_slot_t slots[MAX_BATCH_JOBS];
+    int num_slots;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool stop;
+} batch_t;
+
+typedef struct
+{
+    batch_t *batch;
+    int index;
+} batch_worker_t;
+
+static volatile sig_atomic_t interrupted;
+
+static void handle_interrupt(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static bool parse_filter(const char *name, epaper_resize_filter_t *filter) {
+    if (strcmp(name, "auto") == 0) {
+        *filter = EPAPER_FILTER_AUTO;
+    } else if (strcmp(name, "nearest") == 0) {
+        *filter = EPAPER_FILTER_NEAREST;
+    } else if (strcmp(name, "box") == 0) {
+        *filter = EPAPER_FILTER_BOX;
+    } else if (strcmp(name, "bilinear") == 0) {
+        *filter = EPAPER_FILTER_BILINEAR;
+    } else if (strcmp(name, "lanczos3") == 0) {
+        *filter = EPAPER_FILTER_LANCZOS3;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parse_scale_mode(const char *name, epaper_scale_mode_t *mode) {
+    if (strcmp(name, "stretch") == 0) {
+        *mode = EPAPER_SCALE_STRETCH;
+    } else if (strcmp(name, "fit") == 0) {
+        *mode = EPAPER_SCALE_FIT;
+    } else if (strcmp(name, "fill") == 0) {
+        *mode = EPAPER_SCALE_FILL;
+    } else if (strcmp(name, "crop") == 0) {
+        *mode = EPAPER_SCALE_CROP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool add_path(char ***paths, int *count, int *capacity, const char *path) {
+    if (*count == *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 16;
+        char **grown = realloc(*paths, new_capacity * sizeof(char *));
+        if (!grown) {
+            return false;
+        }
+        *paths = grown;
+        *capacity = new_capacity;
+    }
+    (*paths)[*count] = strdup(path);
+    if (!(*paths)[*count]) {
+        return false;
+    }
+    (*count)++;
+    return true;
+}
+
+// One image path per line; blank lines and lines starting with '#' are skipped
+static bool read_playlist(const char *playlist, char ***paths, int *count, int *capacity) {
+    char line[4096];
+    
+    FILE *fp = fopen(playlist, "r");
+    if (!fp) {
+        perror("Failed to open playlist");
+        return false;
+    }
+    
+    while (fgets(line, sizeof(line), fp)) {
+        size_t len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        if (len == 0 || line[0] == '#') {
+            continue;
+        }
+        if (!add_path(paths, count, capacity, line)) {
+            fclose(fp);
+            return false;
+        }
+    }
+    
+    fclose(fp);
+    return true;
+}
+
+static void *batch_worker(void *arg) {
+    batch_worker_t *worker = arg;
+    batch_t *batch = worker->batch;
+    batch_slot_t *slot = &batch->slots[worker->index];
+    
+    for (long k = worker->index; batch->total_frames < 0 || k < batch->total_frames;
+         k += batch->num_slots) {
+        pthread_mutex_lock(&batch->lock);
+        while (slot->ready && !batch->stop) {
+            pthread_cond_wait(&batch->cond, &batch->lock);
+        }
+        bool stop = batch->stop;
+        pthread_mutex_unlock(&batch->lock);
+        if (stop) {
+            break;
+        }
+        
+        double start = now_ms();
+        bool ok = epaper_ctx_convert_image(slot->ctx, batch->paths[k % batch->num_paths],
+                                           batch->options, &slot->frame);
+        
+        pthread_mutex_lock(&batch->lock);
+        slot->ok = ok;
+        slot->convert_ms = now_ms() - start;
+        slot->ready = true;
+        pthread_cond_broadcast(&batch->cond);
+        pthread_mutex_unlock(&batch->lock);
+    }
+    return NULL;
+}
+
+// Frame k is converted by worker k % jobs while earlier frames are still on
+// the wire; the main thread only ever writes ready frames, in order.
+static int run_batch(int fd, char **paths, int num_paths, long repeat, double interval_s,
+                     int jobs, const epaper_convert_options_t *options) {
+    batch_t batch = {
+        .paths = paths,
+        .num_paths = num_paths,
+        .total_frames = repeat > 0 ? repeat * num_paths : -1,
+        .options = options,
+        .num_slots = jobs,
+        .stop = false
+    };
+    batch_worker_t workers[MAX_BATCH_JOBS];
+    pthread_t threads[MAX_BATCH_JOBS];
+    int num_threads = 0;
+    
+    if (batch.total_frames > 0 && batch.num_slots > batch.total_frames) {
+        batch.num_slots = (int)batch.total_frames;
+    }
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.cond, NULL);
+    
+    for (int i = 0; i < batch.num_slots; i++) {
+        batch.slots[i].ctx = epaper_ctx_create(1);
+        if (!batch.slots[i].ctx) {
+            fprintf(stderr, "Error: Failed to create conversion context\n");
+            batch.num_slots = i;
+            break;
+        }
+    }
+    for (int i = 0; i < batch.num_slots; i++) {
+        workers[i].batch = &batch;
+        workers[i].index = i;
+        if (pthread_create(&threads[i], NULL, batch_worker, &workers[i]) != 0) {
+            fprintf(stderr, "Error: Failed to start conversion thread\n");
+            break;
+        }
+        num_threads++;
+    }
+    // Frame k needs worker k % num_slots, so the pipeline cannot run short-handed
+    if (num_threads == 0 || num_threads < batch.num_slots) {
+        batch.total_frames = 0;
+    }
+    
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_interrupt;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    
+    long sent = 0, failed = 0;
+    double convert_total = 0, send_total = 0, stall_total = 0;
+    double start = now_ms();
+    
+    for (long k = 0; (batch.total_frames < 0 || k < batch.total_frames) && !interrupted; k++) {
+        batch_slot_t *slot = &batch.slots[k % batch.num_slots];
+        const char *path = paths[k % num_paths];
+        
+        double wait_start = now_ms();
+        pthread_mutex_lock(&batch.lock);
+        while (!slot->ready) {
+            pthread_cond_wait(&batch.cond, &batch.lock);
+        }
+        pthread_mutex_unlock(&batch.lock);
+        // Waiting for the very first frame is start-up latency, not a stall
+        if (k > 0) {
+            stall_total += now_ms() - wait_start;
+        }
+        convert_total += slot->convert_ms;
+        
+        if (interval_s > 0 && k > 0) {
+            double due = start + k * interval_s * 1000.0;
+            double remaining = due - now_ms();
+            if (remaining > 0) {
+                struct timespec ts = {
+                    .tv_sec = (time_t)(remaining / 1000.0),
+                    .tv_nsec = (long)(((long long)(remaining * 1e6)) % 1000000000LL)
+                };
+                nanosleep(&ts, NULL);
+            }
+        }
+        
+        if (slot->ok) {
+            printf("[%ld] Sending %s\n", k + 1, path);
+            double send_start = now_ms();
+            if (epaper_send_frame(fd, &slot->frame)) {
+                sent++;
+            } else {
+                failed++;
+            }
+            send_total += now_ms() - send_start;
+        } else {
+            fprintf(stderr, "[%ld] Failed to convert %s\n", k + 1, path);
+            failed++;
+        }
+        
+        pthread_mutex_lock(&batch.lock);
+        slot->ready = false;
+        pthread_cond_broadcast(&batch.cond);
+        pthread_mutex_unlock(&batch.lock);
+    }
+    
+    double elapsed = now_ms() - start;
+    
+    pthread_mutex_lock(&batch.lock);
+    batch.stop = true;
+    pthread_cond_broadcast(&batch.cond);
+    pthread_mutex_unlock(&batch.lock);
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < batch.num_slots; i++) {
+        epaper_ctx_destroy(batch.slots[i].ctx);
+    }
+    pthread_cond_destroy(&batch.cond);
+    pthread_mutex_destroy(&batch.lock);
+    
+    long frames = sent + failed;
+    printf("\nBatch: %ld frames sent, %ld failed in %.1f s\n", sent, failed, elapsed / 1000.0);
+    if (frames > 0 && elapsed > 0) {
+        printf("  Throughput: %.1f frames/min\n", sent * 60000.0 / elapsed);
+        printf("  Convert: %.1f ms/frame avg (%d worker%s), send: %.1f ms/frame avg\n",
+               convert_total / frames, batch.num_slots, batch.num_slots == 1 ? "" : "s",
+               sent ? send_total / sent : 0.0);
+        printf("  Pipeline stalls: %.1f ms total\n", stall_total);
+    }
+    
+    return failed == 0 && frames > 0 ? 0 : 1;
+}
+
+// Opens a file to be read whole, with a size that fits one epaperd request
+static FILE *open_payload(const char *path, size_t *size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    
+    long len = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        len = ftell(fp);
+        rewind(fp);
+    }
+    if (len <= 0 || (unsigned long)len > EPAPERD_MAX_PAYLOAD) {
+        fclose(fp);
+        return NULL;
+    }
+    *size = len;
+    return fp;
+}
+
+static bool read_file(const char *path, unsigned char **data, size_t *size) {
+    FILE *fp = open_payload(path, size);
+    if (!fp) {
+        return false;
+    }
+    
+    *data = malloc(*size);
+    if (!*data || fread(*data, 1, *size, fp) != *size) {
+        free(*data);
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+    return true;
+}
+
+static bool write_all(int fd, const void *data, size_t size) {
+    const unsigned char *p = data;
+    while (size > 0) {
+        ssize_t ret = send(fd, p, size, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *data, size_t size) {
+    unsigned char *p = data;
+    while (size > 0) {
+        ssize_t ret = recv(fd, p, size, 0);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) return false;
+        p += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+// Reads the file into a sealed memfd so epaperd can map it instead of
+// receiving a copy over the socket
+static bool read_file_shm(const char *path, epaper_shm_t *shm) {
+    size_t size;
+    FILE *fp = open_payload(path, &size);
+    if (!fp) {
+        return false;
+    }
+    if (!epaper_shm_create(shm, "epaper_send", size)) {
+        fclose(fp);
+        return false;
+    }
+    
+    bool ok = fread(shm->data, 1, size, fp) == size && epaper_shm_seal(shm);
+    fclose(fp);
+    if (!ok) {
+        epaper_shm_close(shm);
+    }
+    return ok;
+}
+
+static bool send_request_fds(int fd, const epaperd_request_t *req, const int *fds, int num_fds) {
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * 2)];
+    } control;
+    struct iovec iov = { .iov_base = (void *)req, .iov_len = sizeof(*req) };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = CMSG_SPACE(sizeof(int) * num_fds)
+    };
+    
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+    
+    ssize_t ret;
+    do {
+        ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        return false;
+    }
+    // The descriptors went with the first byte; finish the header plainly
+    return write_all(fd, (const unsigned char *)req + ret, sizeof(*req) - ret);
+}
+
+// Waits for epaperd to release the memfd, or for the connection to drop
+static void wait_released(int sock, int event_fd) {
+    struct pollfd pfd[2] = {
+        { .fd = event_fd, .events = POLLIN },
+        { .fd = sock, .events = POLLIN }
+    };
+    uint64_t count;
+    
+    while (poll(pfd, 2, -1) < 0 && errno == EINTR) {
+    }
+    if (pfd[0].revents & POLLIN) {
+        if (read(event_fd, &count, sizeof(count)) < 0) {
+            // Only a wakeup is lost
+        }
+    }
+}
+
+// Hands each file to epaperd, which owns the device, and waits for its reply
+static int send_via_daemon(const char *socket_path, char **paths, int num_paths,
+                           const epaper_convert_options_t *options, int priority,
+                           unsigned int deadline_ms, int target, bool preempt) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int failed = 0;
+    
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Error: Cannot connect to epaperd at %s: %s\n", socket_path,
+                strerror(errno));
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    
+    for (int i = 0; i < num_paths; i++) {
+        unsigned char *data = NULL;
+        size_t size;
+        epaper_shm_t shm;
+        int event_fd = -1;
+        epaperd_reply_t reply;
+        
+        // Prefer handing over a sealed memfd; fall back to an inline copy
+        // where memfd sealing is unavailable
+        bool use_shm = read_file_shm(paths[i], &shm);
+        if (use_shm) {
+            size = shm.size;
+            event_fd = eventfd(0, EFD_CLOEXEC);
+        } else if (!read_file(paths[i], &data, &size)) {
+            fprintf(stderr, "Error: Failed to read %s\n", paths[i]);
+            failed++;
+            continue;
+        }
+        
+        epaperd_request_t req = {
+            .magic = EPAPERD_MAGIC,
+            .job_id = (uint32_t)i,
+            .type = EPAPERD_JOB_ENCODED,
+            .flags = (options->use_dithering ? EPAPERD_FLAG_DITHER : 0) |
+                     (options->invert_colors ? EPAPERD_FLAG_INVERT : 0) |
+                     (options->letterbox_black ? EPAPERD_FLAG_BLACK_BARS : 0) |
+                     (preempt ? EPAPERD_FLAG_PREEMPT : 0) |
+                     (use_shm ? EPAPERD_FLAG_MEMFD : 0) |
+                     (event_fd >= 0 ? EPAPERD_FLAG_EVENTFD : 0),
+            .priority = (int16_t)priority,
+            .target = (uint16_t)target,
+            .deadline_ms = deadline_ms,
+            .target_width = (uint16_t)options->target_width,
+            .target_height = (uint16_t)options->target_height,
+            .threshold = (uint8_t)options->threshold,
+            .resize_filter = (uint8_t)options->resize_filter,
+            .scale_mode = (uint8_t)options->scale_mode,
+            .payload_size = (uint32_t)size
+        };
+        
+        bool ok;
+        if (use_shm) {
+            int fds[2] = { shm.fd, event_fd };
+            ok = send_request_fds(fd, &req, fds, event_fd >= 0 ? 2 : 1);
+        } else {
+            ok = write_all(fd, &req, sizeof(req)) && write_all(fd, data, size);
+        }
+        ok = ok && read_all(fd, &reply, sizeof(reply)) && reply.magic == EPAPERD_MAGIC;
+        
+        if (ok && event_fd >= 0) {
+            wait_released(fd, event_fd);
+        }
+        if (event_fd >= 0) {
+            close(event_fd);
+        }
+        if (use_shm) {
+            epaper_shm_close(&shm);
+        }
+        free(data);
+        if (!ok) {
+            fprintf(stderr, "Error: Lost connection to epaperd\n");
+            close(fd);
+            return 1;
+        }
+        
+        if (reply.status == 0) {
+            printf("%s: sent (queued %u ms, convert %u ms, send %u ms)\n", paths[i],
+                   reply.queue_ms, reply.convert_ms, reply.send_ms);
+        } else {
+            fprintf(stderr, "%s: failed: %s\n", paths[i], strerror(-reply.status));
+            failed++;
+        }
+    }
+    
+    close(fd);
+    return failed ? 1 : 0;
+}
+
+// One image for every device, or one image per device in the same order
+static int run_multi(const char **devices, int num_devices, char **images, int num_images,
+                     const epaper_convert_options_t *options) {
+    epaper_multi_target_t targets[MAX_DEVICES];
+    int opened = 0, failed = 0;
+    
+    if (num_images != 1 && num_images != num_devices) {
+        fprintf(stderr, "Error: Give one image for all devices or one per device\n");
+        return 1;
+    }
+    
+    for (; opened < num_devices; opened++) {
+        targets[opened].fd = epaper_open(devices[opened]);
+        targets[opened].image_path = images[num_images == 1 ? 0 : opened];
+        if (targets[opened].fd < 0) {
+            break;
+        }
+    }
+    
+    if (opened == num_devices) {
+        epaper_ctx_t *ctx = epaper_ctx_create(options->num_threads);
+        if (!ctx) {
+            fprintf(stderr, "Error: Failed to create conversion context\n");
+            failed = num_devices;
+        } else {
+            double start = now_ms();
+            failed = epaper_ctx_send_multi(ctx, targets, num_devices, options);
+            double elapsed = (now_ms() - start) / 1000.0;
+            epaper_ctx_destroy(ctx);
+            
+            for (int i = 0; i < num_devices; i++) {
+                if (targets[i].status == 0) {
+                    printf("%s: sent %s\n", devices[i], targets[i].image_path);
+                } else {
+                    fprintf(stderr, "%s: failed: %s\n", devices[i], strerror(-targets[i].status));
+                }
+            }
+            printf("%d/%d devices updated in %.2f s\n", num_devices - failed, num_devices, elapsed);
+        }
+    } else {
+        failed = 1;
+    }
+    
+    for (int i = 0; i < opened; i++) {
+        epaper_close(targets[i].fd);
+    }
+    return failed ? 1 : 0;
+}
 
 static void print_usage(const char *prog_name) {
-    printf("Usage: %s [options] <image_file>\n", prog_name);
+    printf("Usage: %s [options] <image_file>...\n", prog_name);
     printf("Options:\n");
-    printf("  -d, --device <path>     Device path (default: /dev/epaper_tx)\n");
+    printf("  -d, --device <path>     Device path (default: /dev/epaper_tx0); repeat to send\n");
+    printf("                          to several devices in parallel, with one image for\n");
+    printf("                          all of them or one image per device\n");
     printf("  -w, --width <pixels>    Target width\n");
     printf("  -h, --height <pixels>   Target height\n");
     printf("  -t, --threshold <0-255> Threshold value (default: 128)\n");
     printf("  -D, --dither            Use Floyd-Steinberg dithering\n");
     printf("  -i, --invert            Invert colors\n");
+    printf("  -F, --filter <name>     Resize filter: nearest, box, bilinear, lanczos3 (default: auto)\n");
+    printf("  -m, --mode <mode>       Scale mode: stretch, fit, fill, crop (default: stretch)\n");
+    printf("  -B, --black-bars        Letterbox with black instead of white\n");
+    printf("  -c, --cache <dir>       Cache converted frames in <dir>\n");
+    printf("  -C, --cache-size <MB>   Cache size limit in megabytes (default: 64)\n");
+    printf("Batch mode (several files, a playlist or a repeat count):\n");
+    printf("  -l, --playlist <file>   Read image paths from <file>, one per line\n");
+    printf("  -r, --repeat <count>    Play the list <count> times, 0 = until interrupted (default: 1)\n");
+    printf("  -s, --interval <sec>    Minimum time between frames (default: 0)\n");
+    printf("  -j, --jobs <n>          Conversion threads (default: %d)\n", DEFAULT_BATCH_JOBS);
+    printf("Daemon mode:\n");
+    printf("  -S, --server [socket]   Submit to epaperd instead of opening the device\n");
+    printf("                          (default socket: %s)\n", EPAPERD_DEFAULT_SOCKET);
+    printf("  -p, --priority <n>      Job priority, higher runs first (default: 0)\n");
+    printf("  -T, --deadline <ms>     Drop the job if it has not started within <ms>\n");
+    printf("  -k, --target <n>        Coalescing target: a newer frame for <n> replaces\n");
+    printf("                          older ones that have not been sent yet\n");
+    printf("  -A, --preempt           Also abort a lower-priority frame for the target\n");
+    printf("                          that is being sent\n");
     printf("  --help                  Show this help\n");
 }
 
 int main(int argc, char *argv[]) {
-    const char *device_path = "/dev/epaper_tx";
+    const char *device_path = "/dev/epaper_tx0";
+    const char *devices[MAX_DEVICES];
+    int num_devices = 0;
     const char *image_path = NULL;
-    epaper_convert_options_t options = {0, 0, false, false, 128};
+    const char *playlist = NULL;
+    epaper_convert_options_t options = { .threshold = 128 };
+    char **paths = NULL;
+    int num_paths = 0, paths_capacity = 0;
+    long repeat = 1;
+    double interval_s = 0;
+    int jobs = DEFAULT_BATCH_JOBS;
+    const char *server = NULL;
+    int priority = 0;
+    unsigned int deadline_ms = 0;
+    int target = 0;
+    bool preempt = false;
     
     static struct option long_options[] = {
         {"device",    required_argument, 0, 'd'},
@@ -27,15 +636,34 @@ int main(int argc, char *argv[]) {
         {"threshold", required_argument, 0, 't'},
         {"dither",    no_argument,       0, 'D'},
         {"invert",    no_argument,       0, 'i'},
+        {"filter",    required_argument, 0, 'F'},
+        {"mode",      required_argument, 0, 'm'},
+        {"black-bars", no_argument,      0, 'B'},
+        {"cache",     required_argument, 0, 'c'},
+        {"cache-size", required_argument, 0, 'C'},
+        {"playlist",  required_argument, 0, 'l'},
+        {"repeat",    required_argument, 0, 'r'},
+        {"interval",  required_argument, 0, 's'},
+        {"jobs",      required_argument, 0, 'j'},
+        {"server",    optional_argument, 0, 'S'},
+        {"priority",  required_argument, 0, 'p'},
+        {"deadline",  required_argument, 0, 'T'},
+        {"target",    required_argument, 0, 'k'},
+        {"preempt",   no_argument,       0, 'A'},
         {"help",      no_argument,       0, '?'},
         {0, 0, 0, 0}
     };
     
     int opt;
-    while ((opt = getopt_long(argc, argv, "d:w:h:t:Di", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "d:w:h:t:DiF:m:Bc:C:l:r:s:j:S::p:T:k:A", long_options, NULL)) != -1) {
         switch (opt) {
         case 'd':
+            if (num_devices == MAX_DEVICES) {
+                fprintf(stderr, "Error: At most %d devices\n", MAX_DEVICES);
+                return 1;
+            }
             device_path = optarg;
+            devices[num_devices++] = optarg;
             break;
         case 'w':
             options.target_width = atoi(optarg);
@@ -52,18 +680,117 @@ int main(int argc, char *argv[]) {
         case 'i':
             options.invert_colors = true;
             break;
+        case 'F':
+            if (!parse_filter(optarg, &options.resize_filter)) {
+                fprintf(stderr, "Error: Invalid filter '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'm':
+            if (!parse_scale_mode(optarg, &options.scale_mode)) {
+                fprintf(stderr, "Error: Invalid scale mode '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'B':
+            options.letterbox_black = true;
+            break;
+        case 'c':
+            options.cache_dir = optarg;
+            break;
+        case 'C':
+            options.cache_max_bytes = (size_t)atol(optarg) * 1024 * 1024;
+            break;
+        case 'l':
+            playlist = optarg;
+            break;
+        case 'r':
+            repeat = atol(optarg);
+            break;
+        case 's':
+            interval_s = atof(optarg);
+            break;
+        case 'S':
+            server = optarg ? optarg : EPAPERD_DEFAULT_SOCKET;
+            break;
+        case 'p':
+            priority = atoi(optarg);
+            break;
+        case 'T':
+            deadline_ms = (unsigned int)atol(optarg);
+            break;
+        case 'k':
+            target = atoi(optarg);
+            break;
+        case 'A':
+            preempt = true;
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            if (jobs < 1 || jobs > MAX_BATCH_JOBS) {
+                fprintf(stderr, "Error: Jobs must be between 1 and %d\n", MAX_BATCH_JOBS);
+                return 1;
+            }
+            break;
         default:
             print_usage(argv[0]);
             return 1;
         }
     }
     
-    if (optind >= argc) {
+    if (optind >= argc && !playlist) {
         fprintf(stderr, "Error: No input file specified\n");
         print_usage(argv[0]);
         return 1;
     }
     
+    if (num_devices > 1) {
+        if (server || playlist || repeat != 1 || interval_s > 0) {
+            fprintf(stderr, "Error: Several devices cannot be combined with batch or server mode\n");
+            return 1;
+        }
+        return run_multi(devices, num_devices, argv + optind, argc - optind, &options);
+    }
+    
+    bool batch = playlist || argc - optind > 1 || repeat != 1 || interval_s > 0;
+    if (server && (repeat != 1 || interval_s > 0)) {
+        fprintf(stderr, "Error: --repeat and --interval cannot be used with --server\n");
+        return 1;
+    }
+    if (batch || server) {
+        if (playlist && !read_playlist(playlist, &paths, &num_paths, &paths_capacity)) {
+            return 1;
+        }
+        for (int i = optind; i < argc; i++) {
+            if (!add_path(&paths, &num_paths, &paths_capacity, argv[i])) {
+                fprintf(stderr, "Error: Out of memory\n");
+                return 1;
+            }
+        }
+        if (num_paths == 0) {
+            fprintf(stderr, "Error: Playlist %s is empty\n", playlist);
+            return 1;
+        }
+        
+        int ret;
+        if (server) {
+            ret = send_via_daemon(server, paths, num_paths, &options, priority, deadline_ms,
+                                  target, preempt);
+        } else {
+            int fd = epaper_open(device_path);
+            if (fd < 0) {
+                return 1;
+            }
+            ret = run_batch(fd, paths, num_paths, repeat, interval_s, jobs, &options);
+            epaper_close(fd);
+        }
+        for (int i = 0; i < num_paths; i++) {
+            free(paths[i]);
+        }
+        free(paths);
+        return ret;
+    }
+    
     image_path = argv[optind];
     
     int fd = epaper_open(device_path);
@@ -73,7 +800,8 @@ int main(int argc, char *argv[]) {
     
     bool success;
     if (options.target_width > 0 || options.target_height > 0 || 
-        options.use_dithering || options.invert_colors || options.threshold != 128) {
+        options.use_dithering || options.invert_colors || options.threshold != 128 ||
+        options.resize_filter != EPAPER_FILTER_AUTO || options.cache_dir) {
         success = epaper_send_image_advanced(fd, image_path, &options);
     } else {
         success = epaper_send_image(fd, image_path);
@@ -0,0 +1,1033 @@
+#define _GNU_SOURCE
+#include <send_epaper_data.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <getopt.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "epaperd_protocol.h"
+
+#define MAX_CLIENTS 64
+#define DEFAULT_MAX_QUEUED 16
+#define NUM_CONVERT_SLOTS 2
+
+struct client;
+
+typedef struct job
+{
+    struct job *next;
+    struct client *client;      // NULL once the submitter has disconnected
+    epaperd_request_t req;
+    const unsigned char *data;  // payload or shm.data
+    unsigned char *payload;     // inline copy received over the socket
+    epaper_shm_t shm;           // sealed memfd mapping, fd < 0 when unused
+    int done_fd;                // eventfd to signal when released, or -1
+    uint64_t seq;
+    double submit_ms;
+    double deadline_at;         // 0 = none
+    double start_ms;
+    bool superseded;            // a newer frame for the same target arrived
+    bool abort_requested;
+    int slot;                   // conversion context holding the frame
+    epaper_frame_t frame;
+    int status;
+    double convert_ms;
+    double send_ms;
+    epaper_stage_stats_t stages;    // filled by the library during conversion
+} job_t;
+
+typedef struct client
+{
+    struct client *next;
+    int fd;
+    epaperd_request_t req;      // request being read
+    size_t req_got;
+    unsigned char *payload;
+    size_t payload_got;
+    int fds[2];                 // SCM_RIGHTS descriptors not yet claimed by a request
+    int num_fds;
+    job_t *pending;             // job whose inline payload is being read
+    epaperd_reply_t *replies;   // replies not yet written
+    size_t num_replies;
+    size_t replies_capacity;
+    size_t reply_offset;        // bytes of replies[0] already written
+    int queued;                 // guarded by daemon lock
+    uint64_t last_served;       // guarded by daemon lock
+} client_t;
+
+// A frame lives in its context's scratch memory until it has been sent, so
+// the converter may only reuse a context the sender has finished with
+typedef struct
+{
+    epaper_ctx_t *ctx;
+    bool busy;
+} convert_slot_t;
+
+// Cumulative counters behind --metrics, only touched by the main thread
+typedef struct
+{
+    uint64_t jobs_ok;
+    uint64_t jobs_failed;
+    uint64_t jobs_cancelled;    // superseded or past their deadline
+    double queue_ms;
+    double convert_ms;
+    double send_ms;
+    uint64_t send_bytes;
+    uint64_t cache_hits;
+    uint64_t stage_ns[EPAPER_STAGE_COUNT];
+    uint64_t stage_bytes[EPAPER_STAGE_COUNT];
+} daemon_metrics_t;
+
+typedef struct
+{
+    const char *device_path;
+    int device_fd;
+    int listen_fd;
+    int event_fd;
+    epaper_convert_options_t options;
+    int max_queued;
+    client_t *clients;
+    int num_clients;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    job_t *queue;               // pending jobs, in arrival order
+    job_t *ready;               // converted, waiting for the sender
+    job_t *converting;
+    job_t *sending;
+    job_t *done;                // finished, waiting for the reply to go out
+    job_t **done_tail;
+    uint64_t next_seq;
+    uint64_t serve_counter;
+    convert_slot_t slots[NUM_CONVERT_SLOTS];
+    bool stop;
+
+    const char *metrics_path;   // NULL unless --metrics
+    daemon_metrics_t metrics;
+    bool metrics_dirty;
+} daemon_t;
+
+static volatile sig_atomic_t terminate;
+static bool use_syslog;
+
+static void handle_terminate(int sig) {
+    (void)sig;
+    terminate = 1;
+}
+
+static void log_msg(int level, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    if (use_syslog) {
+        vsyslog(level, fmt, ap);
+    } else {
+        vfprintf(stderr, fmt, ap);
+        fputc('\n', stderr);
+    }
+    va_end(ap);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static job_t *new_job(void) {
+    job_t *job = calloc(1, sizeof(*job));
+    if (job) {
+        job->shm.fd = -1;
+        job->done_fd = -1;
+    }
+    return job;
+}
+
+// Unmapping the memfd before signalling lets the client reuse or free the
+// buffer as soon as its eventfd fires
+static void free_job(job_t *job) {
+    if (job) {
+        free(job->payload);
+        if (job->shm.fd >= 0) {
+            epaper_shm_close(&job->shm);
+        }
+        if (job->done_fd >= 0) {
+            uint64_t one = 1;
+            if (write(job->done_fd, &one, sizeof(one)) < 0) {
+                // A client that stopped reading its eventfd only loses the wakeup
+            }
+            close(job->done_fd);
+        }
+        free(job);
+    }
+}
+
+// Caller holds the lock
+static void finish_job_locked(daemon_t *d, job_t *job, int status) {
+    uint64_t one = 1;
+
+    job->status = status;
+    job->next = NULL;
+    *d->done_tail = job;
+    d->done_tail = &job->next;
+    if (write(d->event_fd, &one, sizeof(one)) < 0) {
+        // The counter only saturates if the main loop has stopped reading
+    }
+}
+
+// Caller holds the lock. Jobs that have not started by their deadline are
+// dropped here instead of being sent late.
+static void expire_jobs_locked(daemon_t *d, double now) {
+    job_t **link = &d->queue;
+    while (*link) {
+        job_t *job = *link;
+        if (job->deadline_at > 0 && now >= job->deadline_at) {
+            *link = job->next;
+            job->client->queued--;
+            finish_job_locked(d, job, -ETIMEDOUT);
+        } else {
+            link = &job->next;
+        }
+    }
+}
+
+// Latest wins: a new frame for a target replaces every frame for that target
+// that has not reached the wire yet. A frame still being converted is dropped
+// once its conversion finishes. The frame on the wire is only aborted when
+// the new one asks for it and outranks it, so equal-priority producers that
+// outpace the link cannot starve each other of completed frames.
+static void supersede_locked(daemon_t *d, const job_t *newer) {
+    uint16_t target = newer->req.target;
+
+    job_t **link = &d->queue;
+    while (*link) {
+        job_t *job = *link;
+        if (job->req.target == target) {
+            *link = job->next;
+            job->client->queued--;
+            finish_job_locked(d, job, -ECANCELED);
+        } else {
+            link = &job->next;
+        }
+    }
+
+    if (d->ready && d->ready->req.target == target) {
+        d->slots[d->ready->slot].busy = false;
+        finish_job_locked(d, d->ready, -ECANCELED);
+        d->ready = NULL;
+    }
+    if (d->converting && d->converting->req.target == target) {
+        d->converting->superseded = true;
+    }
+
+    job_t *sending = d->sending;
+    if (sending && sending->req.target == target && (newer->req.flags & EPAPERD_FLAG_PREEMPT) &&
+        sending->req.priority < newer->req.priority && !sending->abort_requested) {
+        sending->abort_requested = true;
+        if (!epaper_abort(d->device_fd)) {
+            log_msg(LOG_WARNING, "Abort of job %u failed: %s", sending->req.job_id,
+                    strerror(errno));
+        }
+    }
+}
+
+// Highest priority first; between equal priorities the client that was
+// served longest ago goes first, and each client's own jobs run in order
+static job_t *take_next_job_locked(daemon_t *d) {
+    job_t **best = NULL;
+
+    for (job_t **link = &d->queue; *link; link = &(*link)->next) {
+        job_t *job = *link;
+        if (!best) {
+            best = link;
+            continue;
+        }
+        job_t *cur = *best;
+        if (job->req.priority != cur->req.priority) {
+            if (job->req.priority > cur->req.priority) best = link;
+        } else if (job->client->last_served != cur->client->last_served) {
+            if (job->client->last_served < cur->client->last_served) best = link;
+        } else if (job->seq < cur->seq) {
+            best = link;
+        }
+    }
+    if (!best) {
+        return NULL;
+    }
+
+    job_t *job = *best;
+    *best = job->next;
+    job->next = NULL;
+    job->client->queued--;
+    job->client->last_served = ++d->serve_counter;
+    return job;
+}
+
+static int free_slot_locked(daemon_t *d) {
+    for (int i = 0; i < NUM_CONVERT_SLOTS; i++) {
+        if (!d->slots[i].busy) return i;
+    }
+    return -1;
+}
+
+static void record_stages(const epaper_stage_stats_t *stats, void *user_data) {
+    job_t *job = user_data;
+    job->stages = *stats;
+}
+
+static bool convert_job(daemon_t *d, job_t *job) {
+    epaper_ctx_t *ctx = d->slots[job->slot].ctx;
+
+    if (job->req.type == EPAPERD_JOB_FRAME) {
+        image_header_t header;
+        if (job->req.payload_size < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, job->data, sizeof(header));
+        if (header.data_length != job->req.payload_size - sizeof(header) ||
+            (size_t)header.width * header.height > (size_t)header.data_length * 8) {
+            return false;
+        }
+        job->frame.data = job->data;
+        job->frame.size = job->req.payload_size;
+        job->frame.width = header.width;
+        job->frame.height = header.height;
+        return true;
+    }
+
+    epaper_convert_options_t options = d->options;
+    options.target_width = job->req.target_width;
+    options.target_height = job->req.target_height;
+    options.threshold = job->req.threshold;
+    options.use_dithering = job->req.flags & EPAPERD_FLAG_DITHER;
+    options.invert_colors = job->req.flags & EPAPERD_FLAG_INVERT;
+    options.letterbox_black = job->req.flags & EPAPERD_FLAG_BLACK_BARS;
+    options.resize_filter = job->req.resize_filter;
+    options.scale_mode = job->req.scale_mode;
+    options.stats_callback = record_stages;
+    options.stats_user_data = job;
+    return epaper_ctx_convert_encoded_buffer(ctx, job->data, job->req.payload_size,
+                                             &options, &job->frame);
+}
+
+// Converts the next job while the previous one is on the wire, so a warm
+// context and the sender are both kept busy
+static void *convert_thread(void *arg) {
+    daemon_t *d = arg;
+
+    pthread_mutex_lock(&d->lock);
+    for (;;) {
+        int slot = -1;
+        while (!d->stop && (d->ready || (slot = free_slot_locked(d)) < 0 || !d->queue)) {
+            pthread_cond_wait(&d->cond, &d->lock);
+            if (!d->stop) expire_jobs_locked(d, now_ms());
+        }
+        if (d->stop) {
+            break;
+        }
+
+        job_t *job = take_next_job_locked(d);
+        job->slot = slot;
+        d->slots[slot].busy = true;
+        d->converting = job;
+        pthread_mutex_unlock(&d->lock);
+
+        job->start_ms = now_ms();
+        bool ok = convert_job(d, job);
+        job->convert_ms = now_ms() - job->start_ms;
+
+        pthread_mutex_lock(&d->lock);
+        d->converting = NULL;
+        if (ok && !job->superseded) {
+            d->ready = job;
+        } else {
+            d->slots[slot].busy = false;
+            finish_job_locked(d, job, job->superseded ? -ECANCELED : -EINVAL);
+        }
+        pthread_cond_broadcast(&d->cond);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return NULL;
+}
+
+static void *send_thread(void *arg) {
+    daemon_t *d = arg;
+
+    pthread_mutex_lock(&d->lock);
+    for (;;) {
+        while (!d->stop && !d->ready) {
+            pthread_cond_wait(&d->cond, &d->lock);
+        }
+        if (d->stop) {
+            break;
+        }
+
+        job_t *job = d->ready;
+        d->ready = NULL;
+        d->sending = job;
+        pthread_cond_broadcast(&d->cond);
+        pthread_mutex_unlock(&d->lock);
+
+        double start = now_ms();
+        errno = 0;
+        bool ok = epaper_send_frame(d->device_fd, &job->frame);
+        int err = errno;
+        job->send_ms = now_ms() - start;
+        // The frame goes out with epaper_send_frame(), outside the library's
+        // per-call accounting, so the write stage is filled in here
+        job->stages.ns[EPAPER_STAGE_WRITE] = (uint64_t)(job->send_ms * 1e6);
+        job->stages.bytes[EPAPER_STAGE_WRITE] = ok ? job->frame.size : 0;
+
+        pthread_mutex_lock(&d->lock);
+        d->sending = NULL;
+        d->slots[job->slot].busy = false;
+        finish_job_locked(d, job, ok ? 0 : -(err ? err : EIO));
+        pthread_cond_broadcast(&d->cond);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return NULL;
+}
+
+static void queue_reply(client_t *c, const job_t *job) {
+    if (c->num_replies == c->replies_capacity) {
+        size_t capacity = c->replies_capacity ? c->replies_capacity * 2 : 8;
+        epaperd_reply_t *grown = realloc(c->replies, capacity * sizeof(*grown));
+        if (!grown) {
+            log_msg(LOG_ERR, "Out of memory queueing reply for job %u", job->req.job_id);
+            return;
+        }
+        c->replies = grown;
+        c->replies_capacity = capacity;
+    }
+
+    double queue_ms = job->start_ms > 0 ? job->start_ms - job->submit_ms : now_ms() - job->submit_ms;
+    c->replies[c->num_replies++] = (epaperd_reply_t){
+        .magic = EPAPERD_MAGIC,
+        .job_id = job->req.job_id,
+        .status = job->status,
+        .queue_ms = (uint32_t)queue_ms,
+        .convert_ms = (uint32_t)job->convert_ms,
+        .send_ms = (uint32_t)job->send_ms
+    };
+}
+
+static bool flush_replies(client_t *c) {
+    while (c->num_replies > 0) {
+        const unsigned char *p = (const unsigned char *)c->replies + c->reply_offset;
+        size_t len = c->num_replies * sizeof(*c->replies) - c->reply_offset;
+        ssize_t ret = send(c->fd, p, len, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c->reply_offset += ret;
+        size_t whole = c->reply_offset / sizeof(*c->replies);
+        memmove(c->replies, c->replies + whole, (c->num_replies - whole) * sizeof(*c->replies));
+        c->num_replies -= whole;
+        c->reply_offset -= whole * sizeof(*c->replies);
+    }
+    return true;
+}
+
+static void reply_now(client_t *c, const epaperd_request_t *req, int status) {
+    job_t job = { .req = *req, .status = status, .submit_ms = now_ms() };
+    queue_reply(c, &job);
+}
+
+static void submit_job(daemon_t *d, client_t *c, job_t *job) {
+    job->client = c;
+    job->req = c->req;
+    job->submit_ms = now_ms();
+    job->deadline_at = c->req.deadline_ms ? job->submit_ms + c->req.deadline_ms : 0;
+
+    pthread_mutex_lock(&d->lock);
+    if (c->queued >= d->max_queued) {
+        pthread_mutex_unlock(&d->lock);
+        reply_now(c, &job->req, -EAGAIN);
+        free_job(job);
+        return;
+    }
+    if (job->req.target) {
+        supersede_locked(d, job);
+    }
+    job->seq = d->next_seq++;
+    job_t **link = &d->queue;
+    while (*link) link = &(*link)->next;
+    *link = job;
+    c->queued++;
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->lock);
+    d->metrics_dirty = true;
+}
+
+static void close_client_fds(client_t *c) {
+    for (int i = 0; i < c->num_fds; i++) {
+        close(c->fds[i]);
+    }
+    c->num_fds = 0;
+}
+
+// Descriptors ride on whichever read covers the first byte of the sendmsg()
+// that carried them, so they are collected on every read
+static ssize_t recv_with_fds(client_t *c, void *dst, size_t want) {
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * 4)];
+    } control;
+    struct iovec iov = { .iov_base = dst, .iov_len = want };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf)
+    };
+
+    ssize_t ret = recvmsg(c->fd, &msg, MSG_CMSG_CLOEXEC);
+    if (ret < 0) {
+        return ret;
+    }
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        int n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int *fds = (int *)CMSG_DATA(cmsg);
+        for (int i = 0; i < n; i++) {
+            if (c->num_fds < (int)(sizeof(c->fds) / sizeof(c->fds[0]))) {
+                c->fds[c->num_fds++] = fds[i];
+            } else {
+                close(fds[i]);
+            }
+        }
+    }
+    return ret;
+}
+
+// Returns false when the request is malformed and the client must go
+static bool start_request(daemon_t *d, client_t *c) {
+    bool memfd = c->req.flags & EPAPERD_FLAG_MEMFD;
+    bool eventfd = c->req.flags & EPAPERD_FLAG_EVENTFD;
+    int needed_fds = memfd + eventfd;
+
+    if (c->req.magic != EPAPERD_MAGIC || c->req.payload_size == 0 ||
+        c->req.payload_size > EPAPERD_MAX_PAYLOAD ||
+        (c->req.type != EPAPERD_JOB_ENCODED && c->req.type != EPAPERD_JOB_FRAME) ||
+        c->num_fds < needed_fds) {
+        log_msg(LOG_WARNING, "Dropping client %d: malformed request", c->fd);
+        return false;
+    }
+
+    job_t *job = new_job();
+    if (!job) {
+        log_msg(LOG_ERR, "Out of memory for job %u", c->req.job_id);
+        return false;
+    }
+    if (eventfd) {
+        job->done_fd = c->fds[memfd ? 1 : 0];
+    }
+    int shm_fd = memfd ? c->fds[0] : -1;
+    for (int i = needed_fds; i < c->num_fds; i++) {
+        close(c->fds[i]);
+    }
+    c->num_fds = 0;
+
+    if (!memfd) {
+        c->payload = malloc(c->req.payload_size);
+        c->payload_got = 0;
+        if (!c->payload) {
+            log_msg(LOG_ERR, "Out of memory for %u byte job", c->req.payload_size);
+            free_job(job);
+            return false;
+        }
+        c->pending = job;
+        return true;
+    }
+
+    // Sealed memfd: converted or transmitted straight out of the mapping
+    c->req_got = 0;
+    if (!epaper_shm_open_sealed(&job->shm, shm_fd, c->req.payload_size)) {
+        int err = errno ? errno : EINVAL;
+        log_msg(LOG_WARNING, "Job %u: unusable memfd: %s", c->req.job_id, strerror(err));
+        reply_now(c, &c->req, -err);
+        free_job(job);
+        return true;
+    }
+    job->data = job->shm.data;
+    submit_job(d, c, job);
+    return true;
+}
+
+// Returns false when the connection should be closed
+static bool read_client(daemon_t *d, client_t *c) {
+    for (;;) {
+        unsigned char *dst;
+        size_t want;
+
+        if (c->req_got < sizeof(c->req)) {
+            dst = (unsigned char *)&c->req + c->req_got;
+            want = sizeof(c->req) - c->req_got;
+        } else {
+            dst = c->payload + c->payload_got;
+            want = c->req.payload_size - c->payload_got;
+        }
+
+        ssize_t ret = recv_with_fds(c, dst, want);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (ret == 0) {
+            return false;
+        }
+
+        if (c->req_got < sizeof(c->req)) {
+            c->req_got += ret;
+            if (c->req_got < sizeof(c->req)) {
+                continue;
+            }
+            if (!start_request(d, c)) {
+                return false;
+            }
+            continue;
+        }
+
+        c->payload_got += ret;
+        if (c->payload_got == c->req.payload_size) {
+            job_t *job = c->pending;
+            job->payload = c->payload;
+            job->data = c->payload;
+            c->payload = NULL;
+            c->pending = NULL;
+            c->req_got = 0;
+            c->payload_got = 0;
+            submit_job(d, c, job);
+        }
+    }
+}
+
+static void close_client(daemon_t *d, client_t *c) {
+    pthread_mutex_lock(&d->lock);
+    job_t **link = &d->queue;
+    while (*link) {
+        job_t *job = *link;
+        if (job->client == c) {
+            *link = job->next;
+            free_job(job);
+        } else {
+            link = &job->next;
+        }
+    }
+    job_t *active[] = { d->converting, d->ready, d->sending };
+    for (size_t i = 0; i < sizeof(active) / sizeof(active[0]); i++) {
+        if (active[i] && active[i]->client == c) active[i]->client = NULL;
+    }
+    for (job_t *job = d->done; job; job = job->next) {
+        if (job->client == c) job->client = NULL;
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    for (client_t **link = &d->clients; *link; link = &(*link)->next) {
+        if (*link == c) {
+            *link = c->next;
+            break;
+        }
+    }
+    d->num_clients--;
+    d->metrics_dirty = true;
+    close(c->fd);
+    close_client_fds(c);
+    free_job(c->pending);
+    free(c->payload);
+    free(c->replies);
+    free(c);
+}
+
+static void accept_clients(daemon_t *d) {
+    for (;;) {
+        int fd = accept4(d->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                log_msg(LOG_WARNING, "accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+        if (d->num_clients >= MAX_CLIENTS) {
+            log_msg(LOG_WARNING, "Too many clients, refusing connection");
+            close(fd);
+            continue;
+        }
+        client_t *c = calloc(1, sizeof(*c));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->next = d->clients;
+        d->clients = c;
+        d->num_clients++;
+        d->metrics_dirty = true;
+    }
+}
+
+static void account_job(daemon_metrics_t *m, const job_t *job) {
+    if (job->status == 0) {
+        m->jobs_ok++;
+        m->send_bytes += job->frame.size;
+    } else if (job->status == -ECANCELED || job->status == -ETIMEDOUT) {
+        m->jobs_cancelled++;
+    } else {
+        m->jobs_failed++;
+    }
+    if (job->start_ms > 0) {
+        m->queue_ms += job->start_ms - job->submit_ms;
+    }
+    m->convert_ms += job->convert_ms;
+    m->send_ms += job->send_ms;
+    m->cache_hits += job->stages.cache_hit;
+    for (int i = 0; i < EPAPER_STAGE_COUNT; i++) {
+        m->stage_ns[i] += job->stages.ns[i];
+        m->stage_bytes[i] += job->stages.bytes[i];
+    }
+}
+
+// Plain "key value" lines for epaper_exporter, replaced atomically so a
+// scrape never sees a half-written file
+static void write_metrics(daemon_t *d) {
+    static const char *const stage_names[EPAPER_STAGE_COUNT] = {
+        "decode", "resize", "gray", "dither", "pack", "write"
+    };
+    const daemon_metrics_t *m = &d->metrics;
+    char tmp_path[4096];
+    int queued = 0;
+
+    pthread_mutex_lock(&d->lock);
+    for (job_t *job = d->queue; job; job = job->next) {
+        queued++;
+    }
+    int in_flight = (d->ready != NULL) + (d->converting != NULL) + (d->sending != NULL);
+    pthread_mutex_unlock(&d->lock);
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", d->metrics_path);
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) {
+        log_msg(LOG_WARNING, "Cannot write metrics %s: %s", tmp_path, strerror(errno));
+        return;
+    }
+    fprintf(f, "device %s\n", d->device_path);
+    fprintf(f, "clients %d\n", d->num_clients);
+    fprintf(f, "queue_depth %d\n", queued);
+    fprintf(f, "in_flight %d\n", in_flight);
+    fprintf(f, "jobs_ok %llu\n", (unsigned long long)m->jobs_ok);
+    fprintf(f, "jobs_failed %llu\n", (unsigned long long)m->jobs_failed);
+    fprintf(f, "jobs_cancelled %llu\n", (unsigned long long)m->jobs_cancelled);
+    fprintf(f, "queue_seconds %.6f\n", m->queue_ms / 1000.0);
+    fprintf(f, "convert_seconds %.6f\n", m->convert_ms / 1000.0);
+    fprintf(f, "send_seconds %.6f\n", m->send_ms / 1000.0);
+    fprintf(f, "send_bytes %llu\n", (unsigned long long)m->send_bytes);
+    fprintf(f, "cache_hits %llu\n", (unsigned long long)m->cache_hits);
+    for (int i = 0; i < EPAPER_STAGE_COUNT; i++) {
+        fprintf(f, "stage_seconds.%s %.9f\n", stage_names[i], m->stage_ns[i] / 1e9);
+        fprintf(f, "stage_bytes.%s %llu\n", stage_names[i], (unsigned long long)m->stage_bytes[i]);
+    }
+    if (fclose(f) != 0 || rename(tmp_path, d->metrics_path) < 0) {
+        log_msg(LOG_WARNING, "Cannot write metrics %s: %s", d->metrics_path, strerror(errno));
+        unlink(tmp_path);
+    }
+}
+
+static void deliver_replies(daemon_t *d) {
+    uint64_t count;
+    if (read(d->event_fd, &count, sizeof(count)) < 0) {
+        // Nothing pending; the eventfd is non-blocking
+    }
+
+    pthread_mutex_lock(&d->lock);
+    job_t *done = d->done;
+    d->done = NULL;
+    d->done_tail = &d->done;
+    pthread_mutex_unlock(&d->lock);
+
+    while (done) {
+        job_t *job = done;
+        done = job->next;
+        if (job->client) {
+            queue_reply(job->client, job);
+        }
+        if (job->status && job->status != -ETIMEDOUT && job->status != -ECANCELED) {
+            log_msg(LOG_WARNING, "Job %u failed: %s", job->req.job_id, strerror(-job->status));
+        }
+        account_job(&d->metrics, job);
+        d->metrics_dirty = true;
+        free_job(job);
+    }
+}
+
+// Poll timeout that wakes the loop when the nearest queued deadline passes
+static int next_deadline_timeout(daemon_t *d) {
+    double nearest = 0;
+
+    pthread_mutex_lock(&d->lock);
+    expire_jobs_locked(d, now_ms());
+    for (job_t *job = d->queue; job; job = job->next) {
+        if (job->deadline_at > 0 && (nearest == 0 || job->deadline_at < nearest)) {
+            nearest = job->deadline_at;
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    if (nearest == 0) {
+        return -1;
+    }
+    double remaining = nearest - now_ms();
+    return remaining > 0 ? (int)remaining + 1 : 0;
+}
+
+static void run_event_loop(daemon_t *d) {
+    struct pollfd fds[MAX_CLIENTS + 2];
+    client_t *polled[MAX_CLIENTS];
+
+    while (!terminate) {
+        if (d->metrics_path && d->metrics_dirty) {
+            d->metrics_dirty = false;
+            write_metrics(d);
+        }
+
+        int n = 0;
+        fds[n++] = (struct pollfd){ .fd = d->listen_fd, .events = POLLIN };
+        fds[n++] = (struct pollfd){ .fd = d->event_fd, .events = POLLIN };
+        for (client_t *c = d->clients; c; c = c->next) {
+            polled[n - 2] = c;
+            fds[n++] = (struct pollfd){
+                .fd = c->fd,
+                .events = POLLIN | (c->num_replies ? POLLOUT : 0)
+            };
+        }
+
+        int ret = poll(fds, n, next_deadline_timeout(d));
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            log_msg(LOG_ERR, "poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            deliver_replies(d);
+        }
+        for (int i = 2; i < n; i++) {
+            client_t *c = polled[i - 2];
+            bool keep = true;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                keep = read_client(d, c);
+            }
+            if (keep && c->num_replies) {
+                keep = flush_replies(c);
+            }
+            if (!keep) {
+                close_client(d, c);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_clients(d);
+        }
+    }
+}
+
+static int open_listen_socket(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_msg(LOG_ERR, "Socket path too long: %s", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        log_msg(LOG_ERR, "socket failed: %s", strerror(errno));
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        log_msg(LOG_ERR, "Failed to listen on %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    chmod(path, 0660);
+    return fd;
+}
+
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s [options]\n", prog_name);
+    printf("Options:\n");
+    printf("  -d, --device <path>     Device path (default: /dev/epaper_tx0)\n");
+    printf("  -S, --socket <path>     Listening socket (default: %s)\n", EPAPERD_DEFAULT_SOCKET);
+    printf("  -j, --threads <n>       Conversion threads (default: 1)\n");
+    printf("  -c, --cache <dir>       Cache converted frames in <dir>\n");
+    printf("  -C, --cache-size <MB>   Cache size limit in megabytes (default: 64)\n");
+    printf("  -q, --max-queued <n>    Pending jobs allowed per client (default: %d)\n",
+           DEFAULT_MAX_QUEUED);
+    printf("  -m, --metrics <file>    Keep queue and conversion counters in <file>\n");
+    printf("                          for epaper_exporter\n");
+    printf("  -f, --foreground        Do not detach; log to stderr\n");
+    printf("  --help                  Show this help\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *device_path = "/dev/epaper_tx0";
+    const char *socket_path = EPAPERD_DEFAULT_SOCKET;
+    int threads = 1;
+    bool foreground = false;
+    daemon_t d;
+
+    memset(&d, 0, sizeof(d));
+    d.options.threshold = 128;
+    d.max_queued = DEFAULT_MAX_QUEUED;
+
+    static struct option long_options[] = {
+        {"device",     required_argument, 0, 'd'},
+        {"socket",     required_argument, 0, 'S'},
+        {"threads",    required_argument, 0, 'j'},
+        {"cache",      required_argument, 0, 'c'},
+        {"cache-size", required_argument, 0, 'C'},
+        {"max-queued", required_argument, 0, 'q'},
+        {"metrics",    required_argument, 0, 'm'},
+        {"foreground", no_argument,       0, 'f'},
+        {"help",       no_argument,       0, '?'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:S:j:c:C:q:m:f", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'd':
+            device_path = optarg;
+            break;
+        case 'S':
+            socket_path = optarg;
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'c':
+            d.options.cache_dir = optarg;
+            break;
+        case 'C':
+            d.options.cache_max_bytes = (size_t)atol(optarg) * 1024 * 1024;
+            break;
+        case 'q':
+            d.max_queued = atoi(optarg);
+            if (d.max_queued < 1) {
+                fprintf(stderr, "Error: Invalid queue limit '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'm':
+            d.metrics_path = optarg;
+            d.metrics_dirty = true;
+            break;
+        case 'f':
+            foreground = true;
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // The daemon is the device's only writer, so nobody else hits -EBUSY
+    d.device_path = device_path;
+    d.device_fd = epaper_open(device_path);
+    if (d.device_fd < 0) {
+        return 1;
+    }
+    d.listen_fd = open_listen_socket(socket_path);
+    if (d.listen_fd < 0) {
+        epaper_close(d.device_fd);
+        return 1;
+    }
+    d.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (d.event_fd < 0) {
+        perror("eventfd");
+        return 1;
+    }
+
+    for (int i = 0; i < NUM_CONVERT_SLOTS; i++) {
+        d.slots[i].ctx = epaper_ctx_create(threads);
+        if (!d.slots[i].ctx) {
+            fprintf(stderr, "Error: Failed to create conversion context\n");
+            return 1;
+        }
+    }
+
+    if (!foreground) {
+        if (daemon(1, 0) < 0) {
+            perror("daemon");
+            return 1;
+        }
+        openlog("epaperd", LOG_PID, LOG_DAEMON);
+        use_syslog = true;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_terminate;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_mutex_init(&d.lock, NULL);
+    pthread_cond_init(&d.cond, NULL);
+    d.done_tail = &d.done;
+
+    pthread_t converter, sender;
+    if (pthread_create(&converter, NULL, convert_thread, &d) != 0 ||
+        pthread_create(&sender, NULL, send_thread, &d) != 0) {
+        log_msg(LOG_ERR, "Failed to start worker threads");
+        return 1;
+    }
+
+    log_msg(LOG_INFO, "epaperd serving %s on %s", device_path, socket_path);
+    run_event_loop(&d);
+    log_msg(LOG_INFO, "epaperd shutting down");
+
+    // The frame currently on the wire is allowed to finish
+    pthread_mutex_lock(&d.lock);
+    d.stop = true;
+    pthread_cond_broadcast(&d.cond);
+    pthread_mutex_unlock(&d.lock);
+    pthread_join(converter, NULL);
+    pthread_join(sender, NULL);
+
+    while (d.clients) {
+        close_client(&d, d.clients);
+    }
+    deliver_replies(&d);
+    if (d.ready) {
+        free_job(d.ready);
+    }
+    for (int i = 0; i < NUM_CONVERT_SLOTS; i++) {
+        epaper_ctx_destroy(d.slots[i].ctx);
+    }
+
+    pthread_cond_destroy(&d.cond);
+    pthread_mutex_destroy(&d.lock);
+    close(d.event_fd);
+    close(d.listen_fd);
+    unlink(socket_path);
+    epaper_close(d.device_fd);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef EPAPERD_PROTOCOL_H
+#define EPAPERD_PROTOCOL_H
+
+#include <stdint.h>
+
+// Wire format between epaperd and its clients over a SOCK_STREAM Unix
+// socket. A client may have several jobs outstanding on one connection;
+// every request gets exactly one reply carrying the same job_id.
+//
+// File descriptors travel as SCM_RIGHTS on the sendmsg() carrying the
+// request header: first the memfd for EPAPERD_FLAG_MEMFD, then the eventfd
+// for EPAPERD_FLAG_EVENTFD.
+
+#define EPAPERD_DEFAULT_SOCKET "/run/epaperd.sock"
+#define EPAPERD_MAGIC 0x31445045u           // "EPD1"
+#define EPAPERD_MAX_PAYLOAD (64u * 1024 * 1024)
+
+typedef enum
+{
+    EPAPERD_JOB_ENCODED = 1,    // encoded image (JPEG/PNG/PBM/...), converted by the daemon
+    EPAPERD_JOB_FRAME = 2       // image_header_t + packed 1-bit payload, sent as is
+} epaperd_job_type_t;
+
+#define EPAPERD_FLAG_DITHER     0x01
+#define EPAPERD_FLAG_INVERT     0x02
+#define EPAPERD_FLAG_BLACK_BARS 0x04
+#define EPAPERD_FLAG_PREEMPT    0x08    // abort a lower-priority transfer for the same target
+#define EPAPERD_FLAG_MEMFD      0x10    // payload is a sealed memfd, not inline bytes
+#define EPAPERD_FLAG_EVENTFD    0x20    // signal this eventfd once the job's memory is released
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t job_id;            // chosen by the client, echoed in the reply
+    uint16_t type;              // epaperd_job_type_t
+    uint16_t flags;             // EPAPERD_FLAG_*
+    int16_t priority;           // higher runs first
+    uint16_t target;            // latest wins per target; 0 = never superseded
+    uint32_t deadline_ms;       // 0 = none; jobs not started in time fail with ETIMEDOUT
+    uint16_t target_width;
+    uint16_t target_height;
+    uint8_t threshold;
+    uint8_t resize_filter;      // epaper_resize_filter_t
+    uint8_t scale_mode;         // epaper_scale_mode_t
+    uint8_t reserved;
+    uint32_t payload_size;      // bytes following this header, or used from the memfd
+} __attribute__((packed)) epaperd_request_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t job_id;
+    int32_t status;             // 0 or a negative errno, ECANCELED when superseded
+    uint32_t queue_ms;          // submission to start of conversion
+    uint32_t convert_ms;
+    uint32_t send_ms;
+} __attribute__((packed)) epaperd_reply_t;
+
+#endif
@@ -0,0 +1,290 @@
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/gpio/driver.h>
+#include <linux/gpio/machine.h>
+#include <linux/platform_device.h>
+#include <linux/irq.h>
+#include <linux/irqdomain.h>
+#include <linux/irq_sim.h>
+#include <linux/interrupt.h>
+#include <linux/spinlock.h>
+#include <linux/bitmap.h>
+#include <linux/slab.h>
+
+// Software loopback for the 5-pin protocol: a GPIO chip whose lines come in
+// TX/RX pairs joined by a wire, plus one epaper-gpio-tx and one
+// epaper-gpio-rx platform device per link bound to those lines. Writing a
+// TX output drives the paired RX input and raises its edge interrupt, and
+// the other way round for ACK/NACK, so both drivers run unmodified against
+// each other in one kernel.
+//
+// Interrupts go through the same irq_sim domain gpio-sim uses, so delivery
+// is asynchronous (irq_work) like a real edge rather than a nested call
+// from inside gpiod_set_value().
+
+#if !IS_ENABLED(CONFIG_IRQ_SIM)
+#error "loopback_driver needs CONFIG_IRQ_SIM (selected by CONFIG_GPIO_SIM)"
+#endif
+
+#define LOOPBACK_NAME "epaper-loopback"
+#define MAX_LINKS 8
+#define PINS_PER_SIDE 5
+
+// Line layout: link l has its TX pins at (2l) * 5 + pin and its RX pins at
+// (2l + 1) * 5 + pin, and wire l * 5 + pin joins the two
+enum loopback_pin { PIN_CLOCK, PIN_DATA, PIN_START_STOP, PIN_ACK, PIN_NACK };
+
+static const char *const pin_con_ids[PINS_PER_SIDE] = {
+    [PIN_CLOCK] = "clock",
+    [PIN_DATA] = "data",
+    [PIN_START_STOP] = "start-stop",
+    [PIN_ACK] = "ack",
+    [PIN_NACK] = "nack",
+};
+
+static const char *const side_names[2] = { "epaper-gpio-tx", "epaper-gpio-rx" };
+
+static unsigned int links = 1;
+module_param(links, uint, 0444);
+MODULE_PARM_DESC(links, "Number of TX/RX link pairs to create (1-8)");
+
+struct epaper_loopback {
+    struct platform_device *parent;
+    struct gpio_chip chip;
+    struct fwnode_handle *fwnode;
+    struct irq_domain *irq_sim;
+    spinlock_t lock;
+    DECLARE_BITMAP(wires, MAX_LINKS * PINS_PER_SIDE);
+    DECLARE_BITMAP(outputs, MAX_LINKS * PINS_PER_SIDE * 2);
+    struct gpiod_lookup_table *lookups[MAX_LINKS * 2];
+    struct platform_device *devices[MAX_LINKS * 2];
+};
+
+static struct epaper_loopback loopback;
+
+static unsigned int wire_of(unsigned int offset) {
+    return (offset / (PINS_PER_SIDE * 2)) * PINS_PER_SIDE + offset % PINS_PER_SIDE;
+}
+
+static unsigned int peer_of(unsigned int offset) {
+    unsigned int side = (offset / PINS_PER_SIDE) & 1;
+
+    return side ? offset - PINS_PER_SIDE : offset + PINS_PER_SIDE;
+}
+
+static int loopback_get(struct gpio_chip *gc, unsigned int offset) {
+    struct epaper_loopback *lb = gpiochip_get_data(gc);
+
+    return test_bit(wire_of(offset), lb->wires);
+}
+
+// Mirrors gpio-sim's pull handling: a line with a matching edge type gets
+// its interrupt raised. irq_sim itself drops PENDING on a disabled line, and
+// it only implements the PENDING state, so there is no mask to check here.
+static void loopback_raise(struct epaper_loopback *lb, unsigned int offset, int value) {
+    unsigned int irq = irq_find_mapping(lb->irq_sim, offset);
+
+    if (!irq) return;
+
+    u32 type = irq_get_trigger_type(irq);
+    if ((value && (type & IRQ_TYPE_EDGE_RISING)) || (!value && (type & IRQ_TYPE_EDGE_FALLING))) {
+        irq_set_irqchip_state(irq, IRQCHIP_STATE_PENDING, true);
+    }
+}
+
+static void loopback_set(struct gpio_chip *gc, unsigned int offset, int value) {
+    struct epaper_loopback *lb = gpiochip_get_data(gc);
+    unsigned int wire = wire_of(offset);
+    unsigned long flags;
+    bool changed;
+
+    spin_lock_irqsave(&lb->lock, flags);
+    if (value) {
+        changed = !__test_and_set_bit(wire, lb->wires);
+    } else {
+        changed = __test_and_clear_bit(wire, lb->wires);
+    }
+    spin_unlock_irqrestore(&lb->lock, flags);
+
+    if (changed) {
+        loopback_raise(lb, peer_of(offset), value);
+    }
+}
+
+static int loopback_direction_input(struct gpio_chip *gc, unsigned int offset) {
+    struct epaper_loopback *lb = gpiochip_get_data(gc);
+
+    clear_bit(offset, lb->outputs);
+    return 0;
+}
+
+static int loopback_direction_output(struct gpio_chip *gc, unsigned int offset, int value) {
+    struct epaper_loopback *lb = gpiochip_get_data(gc);
+
+    set_bit(offset, lb->outputs);
+    loopback_set(gc, offset, value);
+    return 0;
+}
+
+static int loopback_get_direction(struct gpio_chip *gc, unsigned int offset) {
+    struct epaper_loopback *lb = gpiochip_get_data(gc);
+
+    return test_bit(offset, lb->outputs) ? GPIO_LINE_DIRECTION_OUT : GPIO_LINE_DIRECTION_IN;
+}
+
+static int loopback_to_irq(struct gpio_chip *gc, unsigned int offset) {
+    struct epaper_loopback *lb = gpiochip_get_data(gc);
+
+    return irq_create_mapping(lb->irq_sim, offset);
+}
+
+// Lookup entries key on the chip label, so the drivers' devm_gpiod_get()
+// con_ids resolve to this chip without any device tree
+static struct gpiod_lookup_table *create_lookup(unsigned int link, unsigned int side) {
+    struct gpiod_lookup_table *table;
+    unsigned int first = (link * 2 + side) * PINS_PER_SIDE;
+
+    table = kzalloc(struct_size(table, table, PINS_PER_SIDE + 1), GFP_KERNEL);
+    if (!table) return NULL;
+
+    table->dev_id = kasprintf(GFP_KERNEL, "%s.%u", side_names[side], link);
+    if (!table->dev_id) {
+        kfree(table);
+        return NULL;
+    }
+    for (int pin = 0; pin < PINS_PER_SIDE; pin++) {
+        table->table[pin] = (struct gpiod_lookup)GPIO_LOOKUP(LOOPBACK_NAME, first + pin,
+                                                            pin_con_ids[pin], GPIO_ACTIVE_HIGH);
+    }
+    gpiod_add_lookup_table(table);
+    return table;
+}
+
+static void free_lookup(struct gpiod_lookup_table *table) {
+    gpiod_remove_lookup_table(table);
+    kfree(table->dev_id);
+    kfree(table);
+}
+
+static void remove_links(struct epaper_loopback *lb) {
+    for (int i = MAX_LINKS * 2 - 1; i >= 0; i--) {
+        if (lb->devices[i]) {
+            platform_device_unregister(lb->devices[i]);
+            lb->devices[i] = NULL;
+        }
+        if (lb->lookups[i]) {
+            free_lookup(lb->lookups[i]);
+            lb->lookups[i] = NULL;
+        }
+    }
+}
+
+// Each side's lookup table has to exist before its device is registered,
+// since the driver may already be loaded and probe right away
+static int create_links(struct epaper_loopback *lb) {
+    int ret;
+
+    for (unsigned int link = 0; link < links; link++) {
+        for (unsigned int side = 0; side < 2; side++) {
+            unsigned int i = link * 2 + side;
+
+            lb->lookups[i] = create_lookup(link, side);
+            if (!lb->lookups[i]) {
+                ret = -ENOMEM;
+                goto err;
+            }
+
+            lb->devices[i] = platform_device_register_simple(side_names[side], link, NULL, 0);
+            if (IS_ERR(lb->devices[i])) {
+                ret = PTR_ERR(lb->devices[i]);
+                lb->devices[i] = NULL;
+                goto err;
+            }
+        }
+    }
+    return 0;
+
+err:
+    remove_links(lb);
+    return ret;
+}
+
+static int __init epaper_loopback_init(void) {
+    struct epaper_loopback *lb = &loopback;
+    unsigned int ngpio = links * PINS_PER_SIDE * 2;
+    int ret;
+
+    if (links < 1 || links > MAX_LINKS) {
+        pr_err("epaper loopback: links must be 1-%d\n", MAX_LINKS);
+        return -EINVAL;
+    }
+    spin_lock_init(&lb->lock);
+
+    lb->parent = platform_device_register_simple(LOOPBACK_NAME, PLATFORM_DEVID_NONE, NULL, 0);
+    if (IS_ERR(lb->parent)) return PTR_ERR(lb->parent);
+
+    lb->fwnode = irq_domain_alloc_named_fwnode(LOOPBACK_NAME);
+    if (!lb->fwnode) {
+        ret = -ENOMEM;
+        goto err_parent;
+    }
+
+    lb->irq_sim = irq_domain_create_sim(lb->fwnode, ngpio);
+    if (IS_ERR(lb->irq_sim)) {
+        ret = PTR_ERR(lb->irq_sim);
+        goto err_fwnode;
+    }
+
+    lb->chip.label = LOOPBACK_NAME;
+    lb->chip.parent = &lb->parent->dev;
+    lb->chip.owner = THIS_MODULE;
+    lb->chip.base = -1;
+    lb->chip.ngpio = ngpio;
+    lb->chip.can_sleep = false;
+    lb->chip.get = loopback_get;
+    lb->chip.set = loopback_set;
+    lb->chip.direction_input = loopback_direction_input;
+    lb->chip.direction_output = loopback_direction_output;
+    lb->chip.get_direction = loopback_get_direction;
+    lb->chip.to_irq = loopback_to_irq;
+
+    ret = gpiochip_add_data(&lb->chip, lb);
+    if (ret) goto err_sim;
+
+    ret = create_links(lb);
+    if (ret) goto err_chip;
+
+    pr_info("E-paper loopback: %u link(s) on %u lines\n", links, ngpio);
+    return 0;
+
+err_chip:
+    gpiochip_remove(&lb->chip);
+err_sim:
+    irq_domain_remove_sim(lb->irq_sim);
+err_fwnode:
+    irq_domain_free_fwnode(lb->fwnode);
+err_parent:
+    platform_device_unregister(lb->parent);
+    return ret;
+}
+
+// Unregistering the devices unbinds the TX/RX drivers, which frees their
+// IRQs and lines before the chip goes away
+static void __exit epaper_loopback_exit(void) {
+    struct epaper_loopback *lb = &loopback;
+
+    remove_links(lb);
+    gpiochip_remove(&lb->chip);
+    irq_domain_remove_sim(lb->irq_sim);
+    irq_domain_free_fwnode(lb->fwnode);
+    platform_device_unregister(lb->parent);
+    pr_info("E-paper loopback unloaded\n");
+}
+
+module_init(epaper_loopback_init);
+module_exit(epaper_loopback_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Jeon Mingyu");
+MODULE_DESCRIPTION("E-paper GPIO loopback - TX and RX drivers wired in one kernel");
+MODULE_VERSION("2.0");
@@ -14,11 +14,26 @@
 #include <linux/platform_device.h>
 #include <linux/of.h>
 #include <linux/timer.h>
+#include <linux/idr.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sysfs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
+#include <linux/random.h>
+#include <linux/workqueue.h>
+
+#define CREATE_TRACE_POINTS
+#include "rx_trace.h"
 
 #define CLASS_NAME "epaper_rx"
 #define DEVICE_NAME "epaper_rx"
 #define MAX_IMAGE_SIZE (1920 * 1080)
 #define TIMEOUT_MS 5000
+#define MAX_DEVICES 8
+#define HIST_BUCKETS 32
 
 enum rx_state {
     RX_STATE_HEADER = 0,
@@ -27,10 +42,6 @@ enum rx_state {
     RX_STATE_COMPLETE = 3
 };
 
-// Add data tracking variables
-static volatile u32 total_data_received;
-static volatile u32 expected_data_length;
-
 struct image_header {
     u16 width;
     u16 height;
@@ -38,225 +49,668 @@ struct image_header {
     u16 header_checksum;
 } __packed;
 
+// Header of one link's share of a bonded frame, matching the TX driver.
+// Chunk k of the frame travels on link k % link_count.
+struct bond_header {
+    u16 width;
+    u16 height;
+    u32 data_length;            // whole frame
+    u16 chunk_size;
+    u8 link_index;
+    u8 link_count;
+    u16 frame_id;
+    u16 header_checksum;
+} __packed;
+
 static const struct of_device_id epaper_rx_of_match[] = {
     { .compatible = "epaper,gpio-rx" },
     { }
 };
 MODULE_DEVICE_TABLE(of, epaper_rx_of_match);
 
-static struct gpio_desc *clock_gpio;
-static struct gpio_desc *data_gpio;
-static struct gpio_desc *start_stop_gpio;
-static struct gpio_desc *ack_gpio;
-static struct gpio_desc *nack_gpio;
+// Lock-free counters bumped from the IRQ handlers and read by sysfs. For a
+// bonded frame each link accounts for its own stripe.
+struct epaper_rx_stats {
+    atomic64_t frames;
+    atomic64_t bytes;
+    atomic64_t chunks;
+    atomic64_t nacks;
+    atomic64_t timeouts;
+    atomic64_t crc_failures;
+    atomic64_t header_errors;
+    atomic64_t aborts;
+    atomic64_t last_frame_us;
+    atomic64_t last_bits_per_sec;
+};
+
+// log2 histogram of nanosecond intervals: bucket i counts [2^i, 2^(i+1)),
+// the last bucket also takes everything longer
+struct epaper_hist {
+    atomic64_t buckets[HIST_BUCKETS];
+};
+
+// Fault injection under /sys/kernel/debug/epaper_rx/epaper_rxN/inject/, all
+// off by default. Dropped clock edges are per billion edges, ACK faults per
+// million ACKs.
+struct rx_faults {
+    u32 drop_clock_ppb;         // ignore a clock edge, the byte slips a bit
+    u32 lost_ack_ppm;           // never raise ACK, the transmitter times out
+    u32 delay_ack_ppm;          // raise ACK ack_delay_ms late from a work item
+    u32 ack_delay_ms;
+    u64 injected;
+};
+
+// One instance per "epaper,gpio-rx" node with its own receive state machine,
+// frame buffer and lock. The struct and its frame buffer are freed by the
+// release of its char device, which the open file keeps alive through the
+// cdev, so they outlive an unbind until it is closed.
+struct epaper_rx {
+    volatile bool removed;      // unbound, file operations fail with -ENODEV
+    struct device *dev;
+    struct gpio_desc *clock_gpio;
+    struct gpio_desc *data_gpio;
+    struct gpio_desc *start_stop_gpio;
+    struct gpio_desc *ack_gpio;
+    struct gpio_desc *nack_gpio;
+    
+    int id;
+    dev_t devt;
+    struct cdev cdev;
+    struct device char_dev;
+    struct mutex lock;
+    wait_queue_head_t data_waitqueue;
+    
+    struct image_header header;
+    u8 header_buf[sizeof(struct bond_header)];  // either header form lands here
+    u8 *image_buffer;
+    bool image_ready;
+    struct timer_list timeout_timer;
+    
+    int clock_irq, start_stop_irq;
+    volatile int bit_count;
+    volatile u8 current_byte;
+    volatile bool receiving_data;
+    volatile u32 byte_count;
+    volatile u8 *data_ptr;
+    volatile u8 *data_end;      // bytes past this in a block are dropped
+    volatile u32 expected_crc, received_crc;
+    volatile enum rx_state current_rx_state;
+    volatile u32 total_data_received;
+    volatile u32 expected_data_length;
+    
+    // This link's share of a bonded frame
+    bool bonded;
+    u8 link_index;
+    u16 bond_frame_id;
+    u32 stripe_offset;          // frame offset of the next chunk on this link
+    u32 stripe_step;            // chunk_size * link_count
+    u32 stripe_chunk;
+    u32 stripe_crc;
+    u32 crc_buf;
+    u8 *bond_block;             // bond buffer the open block writes into
+    
+    u64 frame_start_ns;
+    u32 frame_bytes;
+    struct epaper_rx_stats stats;
+    
+    // Timing under /sys/kernel/debug/epaper_rx/epaper_rxN/. The GPIO edge
+    // itself carries no timestamp, so IRQ latency shows up as the spread of
+    // the edge-to-edge interval around the transmitter's bit period.
+    u64 last_clock_ns;          // 0 before the first edge of a block
+    u64 late_samples;           // clock already low again when data was read
+    struct epaper_hist clock_interval;
+    struct rx_faults faults;
+    struct delayed_work delayed_ack;
+    struct dentry *debugfs;
+};
+
+// Frame being reassembled from every bonded link. Buffer replacement only
+// happens on a new frame_id. A link that is still clocking a block into the
+// old buffer keeps it alive as retired until that block ends; a second
+// replacement while one is retired is refused.
+struct rx_bond {
+    spinlock_t lock;
+    struct image_header header;
+    u16 frame_id;
+    u16 chunk_size;
+    u8 link_count;
+    u32 done_mask;
+    u8 *buffer;
+    int writers;                // open blocks on buffer
+    u8 *retired;
+    int retired_writers;        // open blocks on retired, freed at zero
+    struct epaper_rx *links[MAX_DEVICES];   // by link_index; links[0] publishes
+};
 
-static dev_t dev_num;
-static struct cdev rx_cdev;
+static dev_t rx_base;
 static struct class *rx_class;
-static struct device *rx_device;
-static DEFINE_MUTEX(rx_mutex);
-static DECLARE_WAIT_QUEUE_HEAD(data_waitqueue);
-
-static struct image_header header;
-static u8 *image_buffer;
-static bool image_ready;
-static struct timer_list timeout_timer;
-
-static int clock_irq, start_stop_irq;
-static volatile int bit_count;
-static volatile u8 current_byte;
-static volatile bool receiving_data;
-static volatile u32 byte_count;
-static volatile u8 *data_ptr;
-static volatile u32 expected_crc, received_crc;
-static volatile enum rx_state current_rx_state;
-
-static void send_ack(void) {
-    gpiod_set_value(ack_gpio, 1);
+static struct dentry *rx_debugfs;
+static DEFINE_IDA(rx_ida);
+static struct rx_bond rx_bond = {
+    .lock = __SPIN_LOCK_UNLOCKED(rx_bond.lock),
+};
+
+static void set_rx_state(struct epaper_rx *rx, enum rx_state state) {
+    trace_epaper_rx_state(rx->id, rx->current_rx_state, state);
+    rx->current_rx_state = state;
+}
+
+static bool inject_fault(u32 rate, u32 scale, u64 *injected) {
+    if (likely(!rate) || get_random_u32_below(scale) >= rate) {
+        return false;
+    }
+    (*injected)++;
+    return true;
+}
+
+static void pulse_ack(struct epaper_rx *rx) {
+    gpiod_set_value(rx->ack_gpio, 1);
     mdelay(10);
-    gpiod_set_value(ack_gpio, 0);
+    gpiod_set_value(rx->ack_gpio, 0);
+}
+
+// The state machine has already moved on, only the edge is late; a delay
+// past the transmitter's timeout makes it retry against a receiver that
+// expects the next block
+static void delayed_ack_work(struct work_struct *work) {
+    struct epaper_rx *rx = container_of(to_delayed_work(work), struct epaper_rx, delayed_ack);
+    
+    pulse_ack(rx);
+}
+
+static void send_ack(struct epaper_rx *rx) {
+    trace_epaper_rx_response(rx->id, false);
+    if (inject_fault(rx->faults.lost_ack_ppm, 1000000, &rx->faults.injected)) {
+        return;
+    }
+    if (inject_fault(rx->faults.delay_ack_ppm, 1000000, &rx->faults.injected)) {
+        schedule_delayed_work(&rx->delayed_ack, msecs_to_jiffies(rx->faults.ack_delay_ms));
+        return;
+    }
+    pulse_ack(rx);
 }
 
-static void send_nack(void) {
-    gpiod_set_value(nack_gpio, 1);
+static void send_nack(struct epaper_rx *rx) {
+    trace_epaper_rx_response(rx->id, true);
+    atomic64_inc(&rx->stats.nacks);
+    gpiod_set_value(rx->nack_gpio, 1);
     mdelay(10);
-    gpiod_set_value(nack_gpio, 0);
+    gpiod_set_value(rx->nack_gpio, 0);
+}
+
+static void set_block_target(struct epaper_rx *rx, u8 *ptr, size_t size) {
+    rx->data_ptr = ptr;
+    rx->data_end = ptr ? ptr + size : NULL;
+}
+
+// Hands the finished frame to links[0] once every share is in and no block
+// is still being clocked into it. Called with rx_bond.lock held.
+static void publish_bond_frame(void) {
+    struct epaper_rx *owner = rx_bond.links[0];
+    
+    if (!rx_bond.buffer || rx_bond.writers || !owner ||
+        rx_bond.done_mask != BIT(rx_bond.link_count) - 1) {
+        return;
+    }
+    kfree(owner->image_buffer);
+    owner->image_buffer = rx_bond.buffer;
+    owner->header = rx_bond.header;
+    owner->image_ready = true;
+    rx_bond.buffer = NULL;
+    wake_up_interruptible(&owner->data_waitqueue);
+}
+
+// Ends this link's claim on the bond buffer its open block targets
+static void release_bond_block(struct epaper_rx *rx) {
+    unsigned long flags;
+    
+    if (!rx->bond_block) return;
+    spin_lock_irqsave(&rx_bond.lock, flags);
+    if (rx->bond_block == rx_bond.buffer) {
+        rx_bond.writers--;
+        publish_bond_frame();
+    } else if (rx->bond_block == rx_bond.retired &&
+               --rx_bond.retired_writers == 0) {
+        kfree(rx_bond.retired);
+        rx_bond.retired = NULL;
+    }
+    rx->bond_block = NULL;
+    set_block_target(rx, NULL, 0);
+    spin_unlock_irqrestore(&rx_bond.lock, flags);
 }
 
 static void timeout_handler(struct timer_list *t) {
-    receiving_data = false;
-    bit_count = 0;
-    byte_count = 0;
-    current_byte = 0;
-    send_nack();
+    struct epaper_rx *rx = from_timer(rx, t, timeout_timer);
+    
+    atomic64_inc(&rx->stats.timeouts);
+    trace_epaper_rx_timeout(rx->id, rx->current_rx_state, rx->byte_count);
+    rx->receiving_data = false;
+    rx->bit_count = 0;
+    rx->byte_count = 0;
+    rx->current_byte = 0;
+    release_bond_block(rx);
+    send_nack(rx);
 }
 
-static void reset_rx_state(void) {
-    del_timer(&timeout_timer);
-    receiving_data = false;
-    bit_count = 0;
-    byte_count = 0;
-    current_byte = 0;
-    data_ptr = NULL;
-    current_rx_state = RX_STATE_HEADER;
-    total_data_received = 0;
-    expected_data_length = 0;
+static void reset_rx_state(struct epaper_rx *rx) {
+    del_timer(&rx->timeout_timer);
+    rx->receiving_data = false;
+    release_bond_block(rx);
+    rx->bit_count = 0;
+    rx->byte_count = 0;
+    rx->current_byte = 0;
+    set_block_target(rx, NULL, 0);
+    rx->bonded = false;
+    set_rx_state(rx, RX_STATE_HEADER);
+    rx->total_data_received = 0;
+    rx->expected_data_length = 0;
 }
 
 static u16 calculate_header_checksum(struct image_header *h) {
     return (u16)(h->width + h->height + (h->data_length & 0xFFFF) + (h->data_length >> 16));
 }
 
+static u16 calculate_bond_checksum(struct bond_header *h) {
+    return (u16)(h->width + h->height + (h->data_length & 0xFFFF) + (h->data_length >> 16) +
+                 h->chunk_size + h->link_index + h->link_count + h->frame_id);
+}
+
+static void hist_add(struct epaper_hist *hist, u64 ns) {
+    int bucket = ns ? ilog2(ns) : 0;
+    
+    atomic64_inc(&hist->buckets[min(bucket, HIST_BUCKETS - 1)]);
+}
+
 static irqreturn_t clock_irq_handler(int irq, void *dev_id) {
-    if (!receiving_data) return IRQ_HANDLED;
+    struct epaper_rx *rx = dev_id;
+    u64 now_ns = ktime_get_ns();
+    
+    if (!rx->receiving_data) return IRQ_HANDLED;
+    if (inject_fault(rx->faults.drop_clock_ppb, 1000000000, &rx->faults.injected)) {
+        return IRQ_HANDLED;
+    }
+    
+    int bit = gpiod_get_value(rx->data_gpio);
+    // The transmitter holds data stable only until clock falls plus its
+    // setup delay; a low clock here means the sample came close to that
+    if (!gpiod_get_value(rx->clock_gpio)) {
+        rx->late_samples++;
+    }
+    if (rx->last_clock_ns) {
+        hist_add(&rx->clock_interval, now_ns - rx->last_clock_ns);
+    }
+    rx->last_clock_ns = now_ns;
     
-    int bit = gpiod_get_value(data_gpio);
-    current_byte |= (bit << bit_count);
-    bit_count++;
+    rx->current_byte |= (bit << rx->bit_count);
+    rx->bit_count++;
     
-    if (bit_count == 8) {
-        if (data_ptr) {
-            *data_ptr = current_byte;
-            data_ptr++;
+    if (rx->bit_count == 8) {
+        if (rx->data_ptr && rx->data_ptr < rx->data_end) {
+            *rx->data_ptr = rx->current_byte;
+            rx->data_ptr++;
         }
-        byte_count++;
-        bit_count = 0;
-        current_byte = 0;
+        rx->byte_count++;
+        rx->bit_count = 0;
+        rx->current_byte = 0;
         
-        mod_timer(&timeout_timer, jiffies + msecs_to_jiffies(TIMEOUT_MS));
+        mod_timer(&rx->timeout_timer, jiffies + msecs_to_jiffies(TIMEOUT_MS));
     }
     
     return IRQ_HANDLED;
 }
 
+// Joins this link to the bonded frame named by its header, starting a new
+// reassembly buffer when the frame_id changes
+static bool start_bonded_stripe(struct epaper_rx *rx, struct bond_header *bh) {
+    unsigned long flags;
+    
+    if (bh->header_checksum != calculate_bond_checksum(bh) ||
+        bh->data_length > MAX_IMAGE_SIZE || bh->chunk_size == 0 ||
+        bh->link_count == 0 || bh->link_count > MAX_DEVICES ||
+        bh->link_index >= bh->link_count) {
+        return false;
+    }
+    
+    spin_lock_irqsave(&rx_bond.lock, flags);
+    if (!rx_bond.buffer || rx_bond.frame_id != bh->frame_id ||
+        rx_bond.link_count != bh->link_count || rx_bond.chunk_size != bh->chunk_size ||
+        rx_bond.header.data_length != bh->data_length) {
+        u8 *buffer;
+        
+        if (rx_bond.buffer && rx_bond.writers && rx_bond.retired) {
+            spin_unlock_irqrestore(&rx_bond.lock, flags);
+            return false;
+        }
+        buffer = kmalloc(max_t(u32, bh->data_length, 1), GFP_ATOMIC);
+        trace_epaper_rx_alloc(rx->id, bh->data_length, buffer != NULL);
+        if (!buffer) {
+            spin_unlock_irqrestore(&rx_bond.lock, flags);
+            return false;
+        }
+        // Links still holding a share of the abandoned frame find out from
+        // frame_id at their next block
+        if (rx_bond.writers) {
+            rx_bond.retired = rx_bond.buffer;
+            rx_bond.retired_writers = rx_bond.writers;
+        } else {
+            kfree(rx_bond.buffer);
+        }
+        memset(rx_bond.links, 0, sizeof(rx_bond.links));
+        rx_bond.buffer = buffer;
+        rx_bond.writers = 0;
+        rx_bond.frame_id = bh->frame_id;
+        rx_bond.link_count = bh->link_count;
+        rx_bond.chunk_size = bh->chunk_size;
+        rx_bond.done_mask = 0;
+        rx_bond.header.width = bh->width;
+        rx_bond.header.height = bh->height;
+        rx_bond.header.data_length = bh->data_length;
+        rx_bond.header.header_checksum = calculate_header_checksum(&rx_bond.header);
+    }
+    rx_bond.links[bh->link_index] = rx;
+    rx_bond.done_mask &= ~BIT(bh->link_index);
+    spin_unlock_irqrestore(&rx_bond.lock, flags);
+    
+    rx->bonded = true;
+    rx->link_index = bh->link_index;
+    rx->bond_frame_id = bh->frame_id;
+    rx->stripe_chunk = bh->chunk_size;
+    rx->stripe_step = (u32)bh->chunk_size * bh->link_count;
+    rx->stripe_offset = (u32)bh->chunk_size * bh->link_index;
+    rx->stripe_crc = 0;
+    rx->expected_data_length = bh->data_length;
+    set_rx_state(rx, rx->stripe_offset < bh->data_length ? RX_STATE_DATA : RX_STATE_CRC32);
+    return true;
+}
+
+// Marks this link's share done; the last one to finish hands the frame on
+static void finish_bonded_stripe(struct epaper_rx *rx) {
+    unsigned long flags;
+    
+    spin_lock_irqsave(&rx_bond.lock, flags);
+    if (rx_bond.buffer && rx_bond.frame_id == rx->bond_frame_id &&
+        rx_bond.links[rx->link_index] == rx) {
+        rx_bond.done_mask |= BIT(rx->link_index);
+        publish_bond_frame();
+    }
+    spin_unlock_irqrestore(&rx_bond.lock, flags);
+    rx->bonded = false;
+}
+
+static void start_frame_stats(struct epaper_rx *rx) {
+    rx->frame_start_ns = ktime_get_ns();
+    rx->frame_bytes = 0;
+}
+
+static void record_frame(struct epaper_rx *rx) {
+    u64 elapsed_ns = ktime_get_ns() - rx->frame_start_ns;
+    
+    atomic64_inc(&rx->stats.frames);
+    atomic64_add(rx->frame_bytes, &rx->stats.bytes);
+    atomic64_set(&rx->stats.last_frame_us, div_u64(elapsed_ns, 1000));
+    if (elapsed_ns) {
+        atomic64_set(&rx->stats.last_bits_per_sec,
+                     div64_u64((u64)rx->frame_bytes * 8 * NSEC_PER_SEC, elapsed_ns));
+    }
+}
+
+static u32 stripe_chunk_length(struct epaper_rx *rx) {
+    return min(rx->expected_data_length - rx->stripe_offset, rx->stripe_chunk);
+}
+
 static irqreturn_t start_stop_irq_handler(int irq, void *dev_id) {
-    if (gpiod_get_value(start_stop_gpio)) {
-        receiving_data = true;
-        byte_count = 0;
-        bit_count = 0;
-        current_byte = 0;
+    struct epaper_rx *rx = dev_id;
+    
+    if (gpiod_get_value(rx->start_stop_gpio)) {
+        // A block whose end was never seen gives up its bond buffer here
+        release_bond_block(rx);
+        rx->receiving_data = true;
+        rx->last_clock_ns = 0;
+        rx->byte_count = 0;
+        rx->bit_count = 0;
+        rx->current_byte = 0;
         
-        if (current_rx_state == RX_STATE_HEADER) {
-            data_ptr = (u8*)&header;
-        } else if (current_rx_state == RX_STATE_DATA) {
-            data_ptr = image_buffer + total_data_received;
-        } else if (current_rx_state == RX_STATE_CRC32) {
-            data_ptr = image_buffer + header.data_length;
+        if (rx->current_rx_state == RX_STATE_HEADER) {
+            set_block_target(rx, rx->header_buf, sizeof(rx->header_buf));
+        } else if (rx->bonded && rx->current_rx_state == RX_STATE_DATA) {
+            unsigned long flags;
+            spin_lock_irqsave(&rx_bond.lock, flags);
+            if (rx_bond.buffer && rx_bond.frame_id == rx->bond_frame_id) {
+                rx->bond_block = rx_bond.buffer;
+                rx_bond.writers++;
+                set_block_target(rx, rx_bond.buffer + rx->stripe_offset, stripe_chunk_length(rx));
+            } else {
+                set_block_target(rx, NULL, 0);
+            }
+            spin_unlock_irqrestore(&rx_bond.lock, flags);
+        } else if (rx->bonded && rx->current_rx_state == RX_STATE_CRC32) {
+            set_block_target(rx, (u8*)&rx->crc_buf, sizeof(rx->crc_buf));
+        } else if (rx->current_rx_state == RX_STATE_DATA) {
+            set_block_target(rx, rx->image_buffer + rx->total_data_received,
+                             rx->expected_data_length - rx->total_data_received);
+        } else if (rx->current_rx_state == RX_STATE_CRC32) {
+            set_block_target(rx, rx->image_buffer + rx->header.data_length, sizeof(u32));
         }
         
-        timer_setup(&timeout_timer, timeout_handler, 0);
-        mod_timer(&timeout_timer, jiffies + msecs_to_jiffies(TIMEOUT_MS));
+        mod_timer(&rx->timeout_timer, jiffies + msecs_to_jiffies(TIMEOUT_MS));
+        trace_epaper_rx_block_start(rx->id, rx->current_rx_state, 0);
     } else {
-        del_timer(&timeout_timer);
-        receiving_data = false;
+        del_timer(&rx->timeout_timer);
+        rx->receiving_data = false;
+        trace_epaper_rx_block_end(rx->id, rx->current_rx_state, rx->byte_count);
+        
+        // An empty block is the transmitter abandoning the current frame
+        if (rx->byte_count == 0 && rx->bit_count == 0) {
+            release_bond_block(rx);
+            set_rx_state(rx, RX_STATE_HEADER);
+            rx->total_data_received = 0;
+            rx->bonded = false;
+            atomic64_inc(&rx->stats.aborts);
+            send_ack(rx);
+            return IRQ_HANDLED;
+        }
         
-        if (current_rx_state == RX_STATE_HEADER) {
-            if (byte_count < sizeof(header)) {
-                send_nack();
+        if (rx->current_rx_state == RX_STATE_HEADER) {
+            if (rx->byte_count == sizeof(struct bond_header)) {
+                struct bond_header bh;
+                
+                memcpy(&bh, rx->header_buf, sizeof(bh));
+                if (start_bonded_stripe(rx, &bh)) {
+                    start_frame_stats(rx);
+                    send_ack(rx);
+                } else {
+                    atomic64_inc(&rx->stats.header_errors);
+                    send_nack(rx);
+                }
                 return IRQ_HANDLED;
             }
             
-            u16 calc_checksum = calculate_header_checksum(&header);
+            if (rx->byte_count != sizeof(rx->header)) {
+                atomic64_inc(&rx->stats.header_errors);
+                send_nack(rx);
+                return IRQ_HANDLED;
+            }
+            memcpy(&rx->header, rx->header_buf, sizeof(rx->header));
+            rx->bonded = false;
             
-            if (header.header_checksum != calc_checksum) {
-                send_nack();
+            u16 calc_checksum = calculate_header_checksum(&rx->header);
+            
+            if (rx->header.header_checksum != calc_checksum) {
+                atomic64_inc(&rx->stats.header_errors);
+                send_nack(rx);
                 return IRQ_HANDLED;
             }
             
-            if (header.data_length > MAX_IMAGE_SIZE) {
-                send_nack();
+            if (rx->header.data_length > MAX_IMAGE_SIZE) {
+                atomic64_inc(&rx->stats.header_errors);
+                send_nack(rx);
                 return IRQ_HANDLED;
             }
             
-            if (image_buffer) {
-                kfree(image_buffer);
+            if (rx->image_buffer) {
+                kfree(rx->image_buffer);
             }
-            image_buffer = kmalloc(header.data_length + sizeof(u32), GFP_ATOMIC);
-            if (!image_buffer) {
-                send_nack();
+            rx->image_buffer = kmalloc(rx->header.data_length + sizeof(u32), GFP_ATOMIC);
+            trace_epaper_rx_alloc(rx->id, rx->header.data_length + sizeof(u32),
+                                  rx->image_buffer != NULL);
+            if (!rx->image_buffer) {
+                send_nack(rx);
                 return IRQ_HANDLED;
             }
             
-            send_ack();
+            start_frame_stats(rx);
+            send_ack(rx);
+            
+            set_rx_state(rx, RX_STATE_DATA);
+            rx->total_data_received = 0;
+            rx->expected_data_length = rx->header.data_length;
             
-            current_rx_state = RX_STATE_DATA;
-            total_data_received = 0;
-            expected_data_length = header.data_length;
+        } else if (rx->bonded && rx->current_rx_state == RX_STATE_DATA) {
+            u32 length = stripe_chunk_length(rx);
+            unsigned long flags;
+            bool ok;
             
-        } else if (current_rx_state == RX_STATE_DATA) {
-            total_data_received += byte_count;
+            spin_lock_irqsave(&rx_bond.lock, flags);
+            ok = rx->bond_block && rx->bond_block == rx_bond.buffer &&
+                 rx_bond.frame_id == rx->bond_frame_id && rx->byte_count == length;
+            if (ok) {
+                rx->stripe_crc = crc32(rx->stripe_crc, rx_bond.buffer + rx->stripe_offset, length);
+            }
+            spin_unlock_irqrestore(&rx_bond.lock, flags);
+            release_bond_block(rx);
             
-            if (total_data_received > expected_data_length) {
-                send_nack();
-                current_rx_state = RX_STATE_HEADER;
+            if (!ok) {
+                send_nack(rx);
+                rx->bonded = false;
+                set_rx_state(rx, RX_STATE_HEADER);
                 return IRQ_HANDLED;
             }
             
-            send_ack();
+            atomic64_inc(&rx->stats.chunks);
+            rx->frame_bytes += length;
+            send_ack(rx);
+            
+            rx->stripe_offset += rx->stripe_step;
+            if (rx->stripe_offset >= rx->expected_data_length) {
+                set_rx_state(rx, RX_STATE_CRC32);
+            }
             
-            if (total_data_received == expected_data_length) {
-                current_rx_state = RX_STATE_CRC32;
+        } else if (rx->bonded && rx->current_rx_state == RX_STATE_CRC32) {
+            if (rx->byte_count != sizeof(u32) || rx->crc_buf != rx->stripe_crc) {
+                if (rx->byte_count == sizeof(u32)) {
+                    atomic64_inc(&rx->stats.crc_failures);
+                }
+                send_nack(rx);
+                rx->bonded = false;
+                set_rx_state(rx, RX_STATE_HEADER);
+                return IRQ_HANDLED;
+            }
+            
+            send_ack(rx);
+            record_frame(rx);
+            finish_bonded_stripe(rx);
+            set_rx_state(rx, RX_STATE_HEADER);
+            
+        } else if (rx->current_rx_state == RX_STATE_DATA) {
+            rx->total_data_received += rx->byte_count;
+            
+            if (rx->total_data_received > rx->expected_data_length) {
+                send_nack(rx);
+                set_rx_state(rx, RX_STATE_HEADER);
+                return IRQ_HANDLED;
+            }
+            
+            atomic64_inc(&rx->stats.chunks);
+            rx->frame_bytes += rx->byte_count;
+            send_ack(rx);
+            
+            if (rx->total_data_received == rx->expected_data_length) {
+                set_rx_state(rx, RX_STATE_CRC32);
             } else {
-                data_ptr = image_buffer + total_data_received;
+                rx->data_ptr = rx->image_buffer + rx->total_data_received;
             }
             
-        } else if (current_rx_state == RX_STATE_CRC32) {
-            if (byte_count != sizeof(u32)) {
-                send_nack();
-                current_rx_state = RX_STATE_HEADER;
+        } else if (rx->current_rx_state == RX_STATE_CRC32) {
+            if (rx->byte_count != sizeof(u32)) {
+                send_nack(rx);
+                set_rx_state(rx, RX_STATE_HEADER);
                 return IRQ_HANDLED;
             }
             
-            received_crc = *(u32*)(image_buffer + header.data_length);
-            expected_crc = crc32(0, image_buffer, header.data_length);
+            rx->received_crc = *(u32*)(rx->image_buffer + rx->header.data_length);
+            rx->expected_crc = crc32(0, rx->image_buffer, rx->header.data_length);
             
-            if (received_crc == expected_crc) {
-                send_ack();
-                image_ready = true;
-                wake_up_interruptible(&data_waitqueue);
+            if (rx->received_crc == rx->expected_crc) {
+                send_ack(rx);
+                record_frame(rx);
+                rx->image_ready = true;
+                wake_up_interruptible(&rx->data_waitqueue);
             } else {
-                send_nack();
+                atomic64_inc(&rx->stats.crc_failures);
+                send_nack(rx);
             }
-            current_rx_state = RX_STATE_HEADER;
+            set_rx_state(rx, RX_STATE_HEADER);
             
         } else {
-            send_nack();
-            current_rx_state = RX_STATE_HEADER;
+            send_nack(rx);
+            set_rx_state(rx, RX_STATE_HEADER);
         }
     }
     
     return IRQ_HANDLED;
 }
 
+static void rx_dev_release(struct device *dev) {
+    struct epaper_rx *rx = container_of(dev, struct epaper_rx, char_dev);
+    
+    kfree(rx->image_buffer);
+    kfree(rx);
+}
+
 static int rx_open(struct inode *inode, struct file *file) {
-    if (!mutex_trylock(&rx_mutex)) {
+    struct epaper_rx *rx = container_of(inode->i_cdev, struct epaper_rx, cdev);
+    
+    if (rx->removed) {
+        return -ENODEV;
+    }
+    if (!mutex_trylock(&rx->lock)) {
         return -EBUSY;
     }
+    file->private_data = rx;
     return 0;
 }
 
 static int rx_release(struct inode *inode, struct file *file) {
-    mutex_unlock(&rx_mutex);
+    struct epaper_rx *rx = file->private_data;
+    
+    mutex_unlock(&rx->lock);
     return 0;
 }
 
 static ssize_t rx_read(struct file *file, char __user *user_buffer, size_t count, loff_t *pos) {
+    struct epaper_rx *rx = file->private_data;
     ssize_t bytes_read = 0;
     
-    if (*pos == 0 && !image_ready) {
+    if (rx->removed) {
+        return -ENODEV;
+    }
+    if (*pos == 0 && !rx->image_ready) {
         if (file->f_flags & O_NONBLOCK) {
             return -EAGAIN;
         }
-        if (wait_event_interruptible(data_waitqueue, image_ready)) {
+        if (wait_event_interruptible(rx->data_waitqueue, rx->image_ready || rx->removed)) {
             return -ERESTARTSYS;
         }
+        if (rx->removed) {
+            return -ENODEV;
+        }
     }
     
-    if (!image_ready || !image_buffer) {
+    if (!rx->image_ready || !rx->image_buffer) {
         return 0;
     }
     
-    size_t total_size = sizeof(header) + header.data_length;
+    size_t total_size = sizeof(rx->header) + rx->header.data_length;
     if (*pos >= total_size) {
         return 0;
     }
@@ -264,9 +718,9 @@ static ssize_t rx_read(struct file *file, char __user *user_buffer, size_t count
     size_t available = total_size - *pos;
     size_t to_copy = min(count, available);
     
-    if (*pos < sizeof(header)) {
-        size_t header_bytes = min(to_copy, sizeof(header) - *pos);
-        if (copy_to_user(user_buffer, ((u8*)&header) + *pos, header_bytes)) {
+    if (*pos < sizeof(rx->header)) {
+        size_t header_bytes = min(to_copy, sizeof(rx->header) - *pos);
+        if (copy_to_user(user_buffer, ((u8*)&rx->header) + *pos, header_bytes)) {
             return -EFAULT;
         }
         bytes_read += header_bytes;
@@ -274,9 +728,9 @@ static ssize_t rx_read(struct file *file, char __user *user_buffer, size_t count
         to_copy -= header_bytes;
     }
     
-    if (to_copy > 0 && *pos >= sizeof(header)) {
-        size_t data_offset = *pos - sizeof(header);
-        if (copy_to_user(user_buffer + bytes_read, image_buffer + data_offset, to_copy)) {
+    if (to_copy > 0 && *pos >= sizeof(rx->header)) {
+        size_t data_offset = *pos - sizeof(rx->header);
+        if (copy_to_user(user_buffer + bytes_read, rx->image_buffer + data_offset, to_copy)) {
             return -EFAULT;
         }
         bytes_read += to_copy;
@@ -287,17 +741,22 @@ static ssize_t rx_read(struct file *file, char __user *user_buffer, size_t count
 }
 
 static long rx_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    struct epaper_rx *rx = file->private_data;
+    
+    if (rx->removed) {
+        return -ENODEV;
+    }
     switch (cmd) {
     case 0x1001:
-        reset_rx_state();
-        if (image_buffer) {
-            kfree(image_buffer);
-            image_buffer = NULL;
+        reset_rx_state(rx);
+        if (rx->image_buffer) {
+            kfree(rx->image_buffer);
+            rx->image_buffer = NULL;
         }
-        image_ready = false;
+        rx->image_ready = false;
         return 0;
     case 0x1002:
-        return image_ready ? 1 : 0;
+        return rx->image_ready ? 1 : 0;
     default:
         return -ENOTTY;
     }
@@ -311,105 +770,241 @@ static const struct file_operations rx_fops = {
     .unlocked_ioctl = rx_ioctl,
 };
 
+#define RX_STAT_ATTR(name)                                                              \
+static ssize_t name##_show(struct device *dev, struct device_attribute *attr, char *buf) { \
+    struct epaper_rx *rx = dev_get_drvdata(dev);                                        \
+    return sysfs_emit(buf, "%lld\n", atomic64_read(&rx->stats.name));                   \
+}                                                                                       \
+static DEVICE_ATTR_RO(name)
+
+RX_STAT_ATTR(frames);
+RX_STAT_ATTR(bytes);
+RX_STAT_ATTR(chunks);
+RX_STAT_ATTR(nacks);
+RX_STAT_ATTR(timeouts);
+RX_STAT_ATTR(crc_failures);
+RX_STAT_ATTR(header_errors);
+RX_STAT_ATTR(aborts);
+RX_STAT_ATTR(last_frame_us);
+RX_STAT_ATTR(last_bits_per_sec);
+
+static struct attribute *rx_stats_attrs[] = {
+    &dev_attr_frames.attr,
+    &dev_attr_bytes.attr,
+    &dev_attr_chunks.attr,
+    &dev_attr_nacks.attr,
+    &dev_attr_timeouts.attr,
+    &dev_attr_crc_failures.attr,
+    &dev_attr_header_errors.attr,
+    &dev_attr_aborts.attr,
+    &dev_attr_last_frame_us.attr,
+    &dev_attr_last_bits_per_sec.attr,
+    NULL
+};
+
+// Appears as /sys/class/epaper_rx/epaper_rxN/stats/
+static const struct attribute_group rx_stats_group = {
+    .name = "stats",
+    .attrs = rx_stats_attrs,
+};
+
+static const struct attribute_group *rx_groups[] = {
+    &rx_stats_group,
+    NULL
+};
+
+static int hist_show(struct seq_file *s, void *unused) {
+    struct epaper_hist *hist = s->private;
+    
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        s64 count = atomic64_read(&hist->buckets[i]);
+        if (!count) continue;
+        if (i == HIST_BUCKETS - 1) {
+            seq_printf(s, "%10llu ..            ns: %lld\n", 1ULL << i, count);
+        } else {
+            seq_printf(s, "%10llu .. %10llu ns: %lld\n", i ? 1ULL << i : 0,
+                       (1ULL << (i + 1)) - 1, count);
+        }
+    }
+    return 0;
+}
+
+static int hist_open(struct inode *inode, struct file *file) {
+    return single_open(file, hist_show, inode->i_private);
+}
+
+// Any write clears the histogram
+static ssize_t hist_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos) {
+    struct epaper_hist *hist = ((struct seq_file *)file->private_data)->private;
+    
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        atomic64_set(&hist->buckets[i], 0);
+    }
+    return count;
+}
+
+static const struct file_operations hist_fops = {
+    .owner = THIS_MODULE,
+    .open = hist_open,
+    .read = seq_read,
+    .write = hist_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
 static int epaper_rx_probe(struct platform_device *pdev) {
+    struct epaper_rx *rx;
     int ret;
     
-    clock_gpio = devm_gpiod_get(&pdev->dev, "clock", GPIOD_IN);
-    if (IS_ERR(clock_gpio)) {
-        dev_err(&pdev->dev, "Failed to get clock GPIO: %ld\n", PTR_ERR(clock_gpio));
-        return PTR_ERR(clock_gpio);
+    rx = kzalloc(sizeof(*rx), GFP_KERNEL);
+    if (!rx) {
+        return -ENOMEM;
     }
+    rx->dev = &pdev->dev;
+    mutex_init(&rx->lock);
+    init_waitqueue_head(&rx->data_waitqueue);
+    timer_setup(&rx->timeout_timer, timeout_handler, 0);
+    INIT_DELAYED_WORK(&rx->delayed_ack, delayed_ack_work);
+    set_rx_state(rx, RX_STATE_HEADER);
     
-    data_gpio = devm_gpiod_get(&pdev->dev, "data", GPIOD_IN);
-    if (IS_ERR(data_gpio)) {
-        dev_err(&pdev->dev, "Failed to get data GPIO: %ld\n", PTR_ERR(data_gpio));
-        return PTR_ERR(data_gpio);
+    rx->clock_gpio = devm_gpiod_get(&pdev->dev, "clock", GPIOD_IN);
+    if (IS_ERR(rx->clock_gpio)) {
+        dev_err(&pdev->dev, "Failed to get clock GPIO: %ld\n", PTR_ERR(rx->clock_gpio));
+        ret = PTR_ERR(rx->clock_gpio);
+        goto err_free;
     }
     
-    start_stop_gpio = devm_gpiod_get(&pdev->dev, "start-stop", GPIOD_IN);
-    if (IS_ERR(start_stop_gpio)) {
-        dev_err(&pdev->dev, "Failed to get start-stop GPIO: %ld\n", PTR_ERR(start_stop_gpio));
-        return PTR_ERR(start_stop_gpio);
+    rx->data_gpio = devm_gpiod_get(&pdev->dev, "data", GPIOD_IN);
+    if (IS_ERR(rx->data_gpio)) {
+        dev_err(&pdev->dev, "Failed to get data GPIO: %ld\n", PTR_ERR(rx->data_gpio));
+        ret = PTR_ERR(rx->data_gpio);
+        goto err_free;
     }
     
-    ack_gpio = devm_gpiod_get(&pdev->dev, "ack", GPIOD_OUT_LOW);
-    if (IS_ERR(ack_gpio)) {
-        dev_err(&pdev->dev, "Failed to get ack GPIO: %ld\n", PTR_ERR(ack_gpio));
-        return PTR_ERR(ack_gpio);
+    rx->start_stop_gpio = devm_gpiod_get(&pdev->dev, "start-stop", GPIOD_IN);
+    if (IS_ERR(rx->start_stop_gpio)) {
+        dev_err(&pdev->dev, "Failed to get start-stop GPIO: %ld\n", PTR_ERR(rx->start_stop_gpio));
+        ret = PTR_ERR(rx->start_stop_gpio);
+        goto err_free;
     }
     
-    nack_gpio = devm_gpiod_get(&pdev->dev, "nack", GPIOD_OUT_LOW);
-    if (IS_ERR(nack_gpio)) {
-        dev_err(&pdev->dev, "Failed to get nack GPIO: %ld\n", PTR_ERR(nack_gpio));
-        return PTR_ERR(nack_gpio);
+    rx->ack_gpio = devm_gpiod_get(&pdev->dev, "ack", GPIOD_OUT_LOW);
+    if (IS_ERR(rx->ack_gpio)) {
+        dev_err(&pdev->dev, "Failed to get ack GPIO: %ld\n", PTR_ERR(rx->ack_gpio));
+        ret = PTR_ERR(rx->ack_gpio);
+        goto err_free;
     }
     
-    clock_irq = gpiod_to_irq(clock_gpio);
-    if (clock_irq < 0) return clock_irq;
+    rx->nack_gpio = devm_gpiod_get(&pdev->dev, "nack", GPIOD_OUT_LOW);
+    if (IS_ERR(rx->nack_gpio)) {
+        dev_err(&pdev->dev, "Failed to get nack GPIO: %ld\n", PTR_ERR(rx->nack_gpio));
+        ret = PTR_ERR(rx->nack_gpio);
+        goto err_free;
+    }
     
-    start_stop_irq = gpiod_to_irq(start_stop_gpio);
-    if (start_stop_irq < 0) return start_stop_irq;
+    rx->clock_irq = gpiod_to_irq(rx->clock_gpio);
+    if (rx->clock_irq < 0) {
+        ret = rx->clock_irq;
+        goto err_free;
+    }
     
-    ret = request_irq(clock_irq, clock_irq_handler, IRQF_TRIGGER_RISING, 
-                      "epaper_rx_clock", NULL);
-    if (ret) return ret;
+    rx->start_stop_irq = gpiod_to_irq(rx->start_stop_gpio);
+    if (rx->start_stop_irq < 0) {
+        ret = rx->start_stop_irq;
+        goto err_free;
+    }
     
-    ret = request_irq(start_stop_irq, start_stop_irq_handler, 
-                      IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING, 
-                      "epaper_rx_start_stop", NULL);
-    if (ret) {
-        free_irq(clock_irq, NULL);
-        return ret;
+    rx->id = ida_alloc_max(&rx_ida, MAX_DEVICES - 1, GFP_KERNEL);
+    if (rx->id < 0) {
+        dev_err(&pdev->dev, "No free minor (at most %d links)\n", MAX_DEVICES);
+        ret = rx->id;
+        goto err_free;
     }
+    rx->devt = MKDEV(MAJOR(rx_base), rx->id);
+    
+    ret = request_irq(rx->clock_irq, clock_irq_handler, IRQF_TRIGGER_RISING, 
+                      dev_name(&pdev->dev), rx);
+    if (ret) goto err_ida;
+    
+    ret = request_irq(rx->start_stop_irq, start_stop_irq_handler, 
+                      IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING, 
+                      dev_name(&pdev->dev), rx);
+    if (ret) goto err_clock_irq;
+    
+    cdev_init(&rx->cdev, &rx_fops);
+    rx->cdev.owner = THIS_MODULE;
     
-    ret = alloc_chrdev_region(&dev_num, 0, 1, DEVICE_NAME);
+    // From here on the struct belongs to char_dev and is freed by its release
+    device_initialize(&rx->char_dev);
+    rx->char_dev.class = rx_class;
+    rx->char_dev.parent = &pdev->dev;
+    rx->char_dev.devt = rx->devt;
+    rx->char_dev.groups = rx_groups;
+    rx->char_dev.release = rx_dev_release;
+    dev_set_drvdata(&rx->char_dev, rx);
+    ret = dev_set_name(&rx->char_dev, DEVICE_NAME "%d", rx->id);
     if (ret) goto err_irq;
     
-    cdev_init(&rx_cdev, &rx_fops);
-    ret = cdev_add(&rx_cdev, dev_num, 1);
-    if (ret) goto err_chrdev;
+    ret = cdev_device_add(&rx->cdev, &rx->char_dev);
+    if (ret) goto err_irq;
     
-    rx_class = class_create(CLASS_NAME);
-    if (IS_ERR(rx_class)) {
-        ret = PTR_ERR(rx_class);
-        goto err_cdev;
-    }
+    // debugfs is best effort, a failure only loses the histogram
+    rx->debugfs = debugfs_create_dir(dev_name(&rx->char_dev), rx_debugfs);
+    debugfs_create_file("clock_interval", 0644, rx->debugfs, &rx->clock_interval, &hist_fops);
+    debugfs_create_u64("late_samples", 0644, rx->debugfs, &rx->late_samples);
     
-    rx_device = device_create(rx_class, NULL, dev_num, NULL, DEVICE_NAME);
-    if (IS_ERR(rx_device)) {
-        ret = PTR_ERR(rx_device);
-        goto err_class;
-    }
+    struct dentry *inject = debugfs_create_dir("inject", rx->debugfs);
+    debugfs_create_u32("drop_clock_ppb", 0644, inject, &rx->faults.drop_clock_ppb);
+    debugfs_create_u32("lost_ack_ppm", 0644, inject, &rx->faults.lost_ack_ppm);
+    debugfs_create_u32("delay_ack_ppm", 0644, inject, &rx->faults.delay_ack_ppm);
+    debugfs_create_u32("ack_delay_ms", 0644, inject, &rx->faults.ack_delay_ms);
+    debugfs_create_u64("injected", 0644, inject, &rx->faults.injected);
     
-    pr_info("E-paper RX driver loaded successfully\n");
+    platform_set_drvdata(pdev, rx);
+    dev_info(&pdev->dev, "E-paper RX link %d ready as /dev/" DEVICE_NAME "%d\n", rx->id, rx->id);
     return 0;
     
-err_class:
-    class_destroy(rx_class);
-err_cdev:
-    cdev_del(&rx_cdev);
-err_chrdev:
-    unregister_chrdev_region(dev_num, 1);
 err_irq:
-    free_irq(start_stop_irq, NULL);
-    free_irq(clock_irq, NULL);
+    free_irq(rx->start_stop_irq, rx);
+err_clock_irq:
+    free_irq(rx->clock_irq, rx);
+err_ida:
+    ida_free(&rx_ida, rx->id);
+err_free:
+    if (rx->char_dev.release) {
+        put_device(&rx->char_dev);
+    } else {
+        kfree(rx);
+    }
     return ret;
 }
 
 static void epaper_rx_remove(struct platform_device *pdev) {
-    del_timer_sync(&timeout_timer);
-    receiving_data = false;
-    if (image_buffer) {
-        kfree(image_buffer);
-        image_buffer = NULL;
+    struct epaper_rx *rx = platform_get_drvdata(pdev);
+    
+    // A reader left open, possibly asleep waiting for a frame, gets -ENODEV
+    rx->removed = true;
+    wake_up_interruptible(&rx->data_waitqueue);
+    debugfs_remove_recursive(rx->debugfs);
+    cdev_device_del(&rx->cdev, &rx->char_dev);
+    free_irq(rx->start_stop_irq, rx);
+    free_irq(rx->clock_irq, rx);
+    del_timer_sync(&rx->timeout_timer);
+    cancel_delayed_work_sync(&rx->delayed_ack);
+    
+    release_bond_block(rx);
+    spin_lock_irq(&rx_bond.lock);
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (rx_bond.links[i] == rx) {
+            rx_bond.links[i] = NULL;
+        }
     }
-    device_destroy(rx_class, dev_num);
-    class_destroy(rx_class);
-    cdev_del(&rx_cdev);
-    unregister_chrdev_region(dev_num, 1);
-    free_irq(start_stop_irq, NULL);
-    free_irq(clock_irq, NULL);
-    pr_info("E-paper RX driver unloaded\n");
+    spin_unlock_irq(&rx_bond.lock);
+
+    rx->receiving_data = false;
+    ida_free(&rx_ida, rx->id);
+    dev_info(&pdev->dev, "E-paper RX link %d removed\n", rx->id);
+    put_device(&rx->char_dev);
 }
 
 static struct platform_driver epaper_rx_driver = {
@@ -421,7 +1016,49 @@ static struct platform_driver epaper_rx_driver = {
     },
 };
 
-module_platform_driver(epaper_rx_driver);
+// The class and the minor range are shared by every link, so they are set
+// up once here rather than in probe()
+static int __init epaper_rx_init(void) {
+    int ret;
+    
+    ret = alloc_chrdev_region(&rx_base, 0, MAX_DEVICES, DEVICE_NAME);
+    if (ret) return ret;
+    
+    rx_class = class_create(CLASS_NAME);
+    if (IS_ERR(rx_class)) {
+        ret = PTR_ERR(rx_class);
+        goto err_chrdev;
+    }
+    
+    rx_debugfs = debugfs_create_dir(CLASS_NAME, NULL);
+    
+    ret = platform_driver_register(&epaper_rx_driver);
+    if (ret) goto err_debugfs;
+    
+    pr_info("E-paper RX driver loaded successfully\n");
+    return 0;
+    
+err_debugfs:
+    debugfs_remove_recursive(rx_debugfs);
+    class_destroy(rx_class);
+err_chrdev:
+    unregister_chrdev_region(rx_base, MAX_DEVICES);
+    return ret;
+}
+
+static void __exit epaper_rx_exit(void) {
+    platform_driver_unregister(&epaper_rx_driver);
+    debugfs_remove_recursive(rx_debugfs);
+    kfree(rx_bond.buffer);
+    kfree(rx_bond.retired);
+    class_destroy(rx_class);
+    unregister_chrdev_region(rx_base, MAX_DEVICES);
+    ida_destroy(&rx_ida);
+    pr_info("E-paper RX driver unloaded\n");
+}
+
+module_init(epaper_rx_init);
+module_exit(epaper_rx_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jeon Mingyu");
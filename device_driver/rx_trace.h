@@ -0,0 +1,96 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM epaper_rx
+
+#if !defined(_RX_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _RX_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// Receive state machine events, all emitted from the IRQ handlers or the
+// timeout timer. state is the rx_state value (0 header, 1 data, 2 crc32).
+
+DECLARE_EVENT_CLASS(epaper_rx_block,
+    TP_PROTO(int link, int state, u32 bytes),
+    TP_ARGS(link, state, bytes),
+    TP_STRUCT__entry(
+        __field(int, link)
+        __field(int, state)
+        __field(u32, bytes)
+    ),
+    TP_fast_assign(
+        __entry->link = link;
+        __entry->state = state;
+        __entry->bytes = bytes;
+    ),
+    TP_printk("link=%d state=%d bytes=%u", __entry->link, __entry->state, __entry->bytes)
+);
+
+DEFINE_EVENT(epaper_rx_block, epaper_rx_block_start,
+    TP_PROTO(int link, int state, u32 bytes),
+    TP_ARGS(link, state, bytes)
+);
+
+DEFINE_EVENT(epaper_rx_block, epaper_rx_block_end,
+    TP_PROTO(int link, int state, u32 bytes),
+    TP_ARGS(link, state, bytes)
+);
+
+DEFINE_EVENT(epaper_rx_block, epaper_rx_timeout,
+    TP_PROTO(int link, int state, u32 bytes),
+    TP_ARGS(link, state, bytes)
+);
+
+TRACE_EVENT(epaper_rx_state,
+    TP_PROTO(int link, int old_state, int new_state),
+    TP_ARGS(link, old_state, new_state),
+    TP_STRUCT__entry(
+        __field(int, link)
+        __field(int, old_state)
+        __field(int, new_state)
+    ),
+    TP_fast_assign(
+        __entry->link = link;
+        __entry->old_state = old_state;
+        __entry->new_state = new_state;
+    ),
+    TP_printk("link=%d %d -> %d", __entry->link, __entry->old_state, __entry->new_state)
+);
+
+TRACE_EVENT(epaper_rx_response,
+    TP_PROTO(int link, bool nack),
+    TP_ARGS(link, nack),
+    TP_STRUCT__entry(
+        __field(int, link)
+        __field(bool, nack)
+    ),
+    TP_fast_assign(
+        __entry->link = link;
+        __entry->nack = nack;
+    ),
+    TP_printk("link=%d %s", __entry->link, __entry->nack ? "nack" : "ack")
+);
+
+TRACE_EVENT(epaper_rx_alloc,
+    TP_PROTO(int link, size_t size, bool ok),
+    TP_ARGS(link, size, ok),
+    TP_STRUCT__entry(
+        __field(int, link)
+        __field(size_t, size)
+        __field(bool, ok)
+    ),
+    TP_fast_assign(
+        __entry->link = link;
+        __entry->size = size;
+        __entry->ok = ok;
+    ),
+    TP_printk("link=%d size=%zu %s", __entry->link, __entry->size,
+              __entry->ok ? "ok" : "failed")
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rx_trace
+#include <trace/define_trace.h>
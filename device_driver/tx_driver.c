@@ -8,23 +8,46 @@
 #include <linux/cdev.h>
 #include <linux/delay.h>
 #include <linux/mutex.h>
+#include <linux/atomic.h>
 #include <linux/wait.h>
 #include <linux/interrupt.h>
 #include <linux/crc32.h>
 #include <linux/platform_device.h>
 #include <linux/of.h>
+#include <linux/idr.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sysfs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
+#include <linux/random.h>
+
+#define CREATE_TRACE_POINTS
+#include "tx_trace.h"
 
 #define CLASS_NAME "epaper_tx"
 #define DEVICE_NAME "epaper_tx"
+#define BOND_DEVICE_NAME "epaper_txbond"
 #define MAX_IMAGE_SIZE (1920 * 1080)
 #define TIMEOUT_MS 2000
 #define MAX_RETRIES 3
 #define MAX_CHUNK_SIZE 1024
+#define MAX_DEVICES 8
+#define HIST_BUCKETS 32
+
+// Abandons the frame being written at the next chunk boundary
+#define EPAPER_TX_IOC_ABORT 0x2001
 
 static bool debug_skip_ack = false;
 module_param(debug_skip_ack, bool, 0644);
 MODULE_PARM_DESC(debug_skip_ack, "Skip ACK/NACK waiting for testing without receiver");
 
+static unsigned int bond_links;
+module_param(bond_links, uint, 0444);
+MODULE_PARM_DESC(bond_links, "Bitmask of TX link ids striped by /dev/" BOND_DEVICE_NAME " (0 = no bonding)");
+
 struct image_header {
     u16 width;
     u16 height;
@@ -32,81 +55,204 @@ struct image_header {
     u16 header_checksum;
 } __packed;
 
+// Header of one link's share of a bonded frame, matching the RX driver.
+// Chunk k of the frame travels on link k % link_count, so the receiver can
+// place every chunk by offset without it being sent.
+struct bond_header {
+    u16 width;
+    u16 height;
+    u32 data_length;            // whole frame
+    u16 chunk_size;
+    u8 link_index;
+    u8 link_count;
+    u16 frame_id;
+    u16 header_checksum;
+} __packed;
+
 static const struct of_device_id epaper_tx_of_match[] = {
     { .compatible = "epaper,gpio-tx" },
     { }
 };
 MODULE_DEVICE_TABLE(of, epaper_tx_of_match);
 
-static struct gpio_desc *clock_gpio;
-static struct gpio_desc *data_gpio;
-static struct gpio_desc *start_stop_gpio;
-static struct gpio_desc *ack_gpio;
-static struct gpio_desc *nack_gpio;
+// Plain atomic64 counters: updated on the transfer path without taking any
+// lock and read individually by sysfs, so a reader may see a frame half
+// accounted but never a torn value
+struct epaper_tx_stats {
+    atomic64_t frames;
+    atomic64_t frames_failed;
+    atomic64_t bytes;
+    atomic64_t chunks;
+    atomic64_t retries_timeout;
+    atomic64_t retries_nack;
+    atomic64_t nacks;
+    atomic64_t timeouts;
+    atomic64_t crc_failures;
+    atomic64_t aborts;
+    atomic64_t last_frame_us;
+    atomic64_t last_bits_per_sec;
+};
+
+// log2 histogram of nanosecond intervals: bucket i counts [2^i, 2^(i+1)),
+// the last bucket also takes everything longer
+struct epaper_hist {
+    atomic64_t buckets[HIST_BUCKETS];
+};
+
+// Fault injection under /sys/kernel/debug/epaper_tx/epaper_txN/inject/, all
+// off by default. The bit error rate is per billion bits, truncation per
+// million blocks.
+struct tx_faults {
+    u32 ber_ppb;                // flip the data bit on the wire
+    u32 truncate_ppm;           // stop a block early, before its last byte
+    u64 injected;
+};
 
-static dev_t dev_num;
-static struct cdev tx_cdev;
+// One instance per "epaper,gpio-tx" node; each link has its own GPIOs,
+// IRQs and lock, so several links can transmit at the same time. The struct
+// is freed by the release of its char device, which open files keep alive
+// through the cdev, so it outlives an unbind until they are closed.
+struct epaper_tx {
+    volatile bool removed;      // unbound, file operations fail with -ENODEV
+    struct device *dev;
+    struct gpio_desc *clock_gpio;
+    struct gpio_desc *data_gpio;
+    struct gpio_desc *start_stop_gpio;
+    struct gpio_desc *ack_gpio;
+    struct gpio_desc *nack_gpio;
+    
+    int id;
+    dev_t devt;
+    struct cdev cdev;
+    struct device char_dev;
+    struct mutex lock;
+    wait_queue_head_t response_waitqueue;
+    
+    volatile bool ack_received, nack_received;
+    u32 write_gen;              // last generation handed to a write, under lock
+    atomic_t active_gen;        // generation of the write in flight, 0 when idle
+    atomic_t abort_gen;         // generation the last abort was aimed at
+    int ack_irq, nack_irq;
+    struct epaper_tx_stats stats;
+    
+    // Timing histograms under /sys/kernel/debug/epaper_tx/epaper_txN/
+    u64 response_ns;            // when the last ACK/NACK edge arrived
+    struct epaper_hist ack_latency;
+    struct epaper_hist bit_period;
+    u64 retry_start_ns;         // first failure of the frame being retried
+    struct epaper_hist recovery;
+    struct tx_faults faults;
+    struct dentry *debugfs;
+};
+
+static dev_t tx_base;
 static struct class *tx_class;
-static struct device *tx_device;
-static DEFINE_MUTEX(tx_mutex);
-static DECLARE_WAIT_QUEUE_HEAD(response_waitqueue);
+static struct dentry *tx_debugfs;
+static DEFINE_IDA(tx_ida);
+
+// Links by id for the bond device; a bonded write holds every member's lock
+static struct epaper_tx *tx_links[MAX_DEVICES];
+static DEFINE_MUTEX(tx_links_lock);
+static struct cdev bond_cdev;
+static struct device *bond_device;
+static u16 bond_frame_id;
+
+struct bond_stripe {
+    struct work_struct work;
+    struct epaper_tx *tx;
+    u32 gen;
+    const u8 *data;
+    struct bond_header header;
+    int ret;
+};
 
-static volatile bool ack_received, nack_received;
-static int ack_irq, nack_irq;
+static void hist_add(struct epaper_hist *hist, u64 ns) {
+    int bucket = ns ? ilog2(ns) : 0;
+    
+    atomic64_inc(&hist->buckets[min(bucket, HIST_BUCKETS - 1)]);
+}
 
 static irqreturn_t ack_irq_handler(int irq, void *dev_id) {
-    ack_received = true;
-    wake_up_interruptible(&response_waitqueue);
+    struct epaper_tx *tx = dev_id;
+    
+    tx->response_ns = ktime_get_ns();
+    trace_epaper_tx_response_irq(tx->id, false);
+    tx->ack_received = true;
+    wake_up_interruptible(&tx->response_waitqueue);
     return IRQ_HANDLED;
 }
 
 static irqreturn_t nack_irq_handler(int irq, void *dev_id) {
-    nack_received = true;
-    wake_up_interruptible(&response_waitqueue);
+    struct epaper_tx *tx = dev_id;
+    
+    tx->response_ns = ktime_get_ns();
+    trace_epaper_tx_response_irq(tx->id, true);
+    tx->nack_received = true;
+    wake_up_interruptible(&tx->response_waitqueue);
     return IRQ_HANDLED;
 }
 
-static void send_bit(int bit) {
-    gpiod_set_value(data_gpio, bit ? 1 : 0);
+static bool inject_fault(u32 rate, u32 scale, u64 *injected) {
+    if (likely(!rate) || get_random_u32_below(scale) >= rate) {
+        return false;
+    }
+    (*injected)++;
+    return true;
+}
+
+static void send_bit(struct epaper_tx *tx, int bit) {
+    gpiod_set_value(tx->data_gpio, bit ? 1 : 0);
     udelay(10);
-    gpiod_set_value(clock_gpio, 1);
+    gpiod_set_value(tx->clock_gpio, 1);
     udelay(20);
-    gpiod_set_value(clock_gpio, 0);
+    gpiod_set_value(tx->clock_gpio, 0);
     udelay(10);
 }
 
-static void send_byte(u8 byte) {
+// bit_period gets the mean of the byte's eight bits, including udelay()
+// overshoot and GPIO write cost; timing each bit would add its own cost to
+// every period it measures
+static void send_byte(struct epaper_tx *tx, u8 byte) {
+    bool inject = unlikely(tx->faults.ber_ppb);
+    u64 start_ns = ktime_get_ns();
+    
     for (int i = 0; i < 8; i++) {
-        send_bit((byte >> i) & 1);
+        int bit = (byte >> i) & 1;
+        
+        if (inject && inject_fault(tx->faults.ber_ppb, 1000000000, &tx->faults.injected)) {
+            bit = !bit;
+        }
+        send_bit(tx, bit);
     }
+    hist_add(&tx->bit_period, (ktime_get_ns() - start_ns) / 8);
 }
 
-static void send_start_signal(void) {
-    gpiod_set_value(start_stop_gpio, 1);
+static void send_start_signal(struct epaper_tx *tx) {
+    gpiod_set_value(tx->start_stop_gpio, 1);
     mdelay(5);
 }
 
-static void send_stop_signal(void) {
-    gpiod_set_value(start_stop_gpio, 0);
+static void send_stop_signal(struct epaper_tx *tx) {
+    gpiod_set_value(tx->start_stop_gpio, 0);
     mdelay(5);
 }
 
-static int wait_for_response(void) {
-    int ret = wait_event_timeout(response_waitqueue, 
-                                ack_received || nack_received,
+static int wait_for_response(struct epaper_tx *tx) {
+    int ret = wait_event_timeout(tx->response_waitqueue, 
+                                tx->ack_received || tx->nack_received,
                                 msecs_to_jiffies(TIMEOUT_MS));
     
     if (ret == 0) {
         return -ETIMEDOUT;
     }
     
-    if (nack_received) {
-        nack_received = false;
+    if (tx->nack_received) {
+        tx->nack_received = false;
         return -ECOMM;
     }
     
-    if (ack_received) {
-        ack_received = false;
+    if (tx->ack_received) {
+        tx->ack_received = false;
         return 0;
     }
     
@@ -117,29 +263,146 @@ static u16 calculate_header_checksum(struct image_header *h) {
     return (u16)(h->width + h->height + (h->data_length & 0xFFFF) + (h->data_length >> 16));
 }
 
-static int send_data_block(u8 *data, size_t length) {
-    send_start_signal();
+static int send_data_block(struct epaper_tx *tx, u8 *data, size_t length) {
+    size_t wire_length = length;
+    
+    // Never down to 0 bytes, which the receiver would take as an abort
+    if (length > 1 && inject_fault(tx->faults.truncate_ppm, 1000000, &tx->faults.injected)) {
+        wire_length = 1 + get_random_u32_below(length - 1);
+    }
+    
+    trace_epaper_tx_block_start(tx->id, length);
+    send_start_signal(tx);
     
-    for (size_t i = 0; i < length; i++) {
-        send_byte(data[i]);
+    for (size_t i = 0; i < wire_length; i++) {
+        send_byte(tx, data[i]);
     }
     
-    send_stop_signal();
+    // The receiver may answer while send_stop_signal() is still holding
+    // the line, so the round trip is timed from the falling edge itself
+    u64 stop_ns = ktime_get_ns();
+    send_stop_signal(tx);
+    trace_epaper_tx_block_end(tx->id, length);
     
     if (debug_skip_ack) {
         return 0;
     }
     
-    return wait_for_response();
+    int ret = wait_for_response(tx);
+    trace_epaper_tx_response(tx->id, ret);
+    if (ret == 0 || ret == -ECOMM) {
+        hist_add(&tx->ack_latency, tx->response_ns - stop_ns);
+    }
+    if (ret == -ETIMEDOUT) {
+        atomic64_inc(&tx->stats.timeouts);
+    } else if (ret == -ECOMM) {
+        atomic64_inc(&tx->stats.nacks);
+    }
+    return ret;
+}
+
+// ret is the failure that made the previous attempt give up
+static void count_retry(struct epaper_tx *tx, int attempt, int ret) {
+    trace_epaper_tx_retry(tx->id, attempt, ret);
+    if (!tx->retry_start_ns) {
+        tx->retry_start_ns = ktime_get_ns();
+    }
+    if (ret == -ETIMEDOUT) {
+        atomic64_inc(&tx->stats.retries_timeout);
+    } else {
+        atomic64_inc(&tx->stats.retries_nack);
+    }
+}
+
+static void record_frame(struct epaper_tx *tx, int ret, size_t bytes, u64 start_ns) {
+    u64 now_ns = ktime_get_ns();
+    u64 elapsed_ns = now_ns - start_ns;
+    
+    trace_epaper_tx_frame_end(tx->id, bytes, ret);
+    // Recovery is how long a frame that did get through spent retrying
+    if (tx->retry_start_ns) {
+        if (!ret) {
+            hist_add(&tx->recovery, now_ns - tx->retry_start_ns);
+        }
+        tx->retry_start_ns = 0;
+    }
+    if (ret == -ECANCELED) {
+        atomic64_inc(&tx->stats.aborts);
+    }
+    if (ret) {
+        atomic64_inc(&tx->stats.frames_failed);
+        return;
+    }
+    atomic64_inc(&tx->stats.frames);
+    atomic64_add(bytes, &tx->stats.bytes);
+    atomic64_set(&tx->stats.last_frame_us, div_u64(elapsed_ns, 1000));
+    if (elapsed_ns) {
+        atomic64_set(&tx->stats.last_bits_per_sec,
+                     div64_u64((u64)bytes * 8 * NSEC_PER_SEC, elapsed_ns));
+    }
+}
+
+// A block with no payload tells the receiver to drop the partial frame and
+// wait for a new header
+static void send_abort_block(struct epaper_tx *tx) {
+    tx->ack_received = tx->nack_received = false;
+    trace_epaper_tx_block_start(tx->id, 0);
+    send_start_signal(tx);
+    send_stop_signal(tx);
+    trace_epaper_tx_block_end(tx->id, 0);
+    if (!debug_skip_ack) {
+        trace_epaper_tx_response(tx->id, wait_for_response(tx));
+    }
+}
+
+// Every write gets its own generation, so an abort only ever reaches the
+// write that was in flight when it was requested. Called with tx->lock held.
+static u32 begin_write(struct epaper_tx *tx) {
+    if (++tx->write_gen == 0) {
+        tx->write_gen = 1;
+    }
+    atomic_set(&tx->active_gen, tx->write_gen);
+    return tx->write_gen;
+}
+
+static void end_write(struct epaper_tx *tx) {
+    atomic_set(&tx->active_gen, 0);
+}
+
+// Dropped when the link is idle; racing with the end of a write it names
+// a generation that no later write will use
+static void request_abort(struct epaper_tx *tx) {
+    u32 gen = atomic_read(&tx->active_gen);
+    
+    if (gen) {
+        atomic_set(&tx->abort_gen, gen);
+    }
+}
+
+static bool abort_requested(struct epaper_tx *tx, u32 gen) {
+    return (u32)atomic_read(&tx->abort_gen) == gen;
+}
+
+// Checked before each header attempt as well as at every chunk boundary
+static bool abort_pending(struct epaper_tx *tx, u32 gen, int retry) {
+    if (!abort_requested(tx, gen)) {
+        return false;
+    }
+    // After a failed attempt the receiver may hold a partial frame
+    if (retry > 0) {
+        send_abort_block(tx);
+    }
+    return true;
 }
 
 static ssize_t tx_write(struct file *file, const char __user *user_buffer, size_t count, loff_t *pos) {
+    struct epaper_tx *tx = file->private_data;
     int ret;
     u8 *buffer;
     struct image_header header;
     u32 crc32_val;
     
-    pr_info("TX write: %zu bytes\n", count);
+    dev_dbg(tx->dev, "TX write: %zu bytes\n", count);
     
     if (count < sizeof(header)) {
         return -EINVAL;
@@ -148,19 +411,23 @@ static ssize_t tx_write(struct file *file, const char __user *user_buffer, size_
         return -EINVAL;
     }
     
-    if (!mutex_trylock(&tx_mutex)) {
+    if (!mutex_trylock(&tx->lock)) {
         return -EBUSY;
     }
+    if (tx->removed) {
+        mutex_unlock(&tx->lock);
+        return -ENODEV;
+    }
     
     buffer = kmalloc(count, GFP_KERNEL);
     if (!buffer) {
-        mutex_unlock(&tx_mutex);
+        mutex_unlock(&tx->lock);
         return -ENOMEM;
     }
     
     if (copy_from_user(buffer, user_buffer, count)) {
         kfree(buffer);
-        mutex_unlock(&tx_mutex);
+        mutex_unlock(&tx->lock);
         return -EFAULT;
     }
     
@@ -168,13 +435,13 @@ static ssize_t tx_write(struct file *file, const char __user *user_buffer, size_
     
     if (header.data_length != count - sizeof(header)) {
         kfree(buffer);
-        mutex_unlock(&tx_mutex);
+        mutex_unlock(&tx->lock);
         return -EINVAL;
     }
     
     if (header.data_length > MAX_IMAGE_SIZE) {
         kfree(buffer);
-        mutex_unlock(&tx_mutex);
+        mutex_unlock(&tx->lock);
         return -EINVAL;
     }
     
@@ -183,10 +450,19 @@ static ssize_t tx_write(struct file *file, const char __user *user_buffer, size_
     
     crc32_val = crc32(0, buffer + sizeof(header), header.data_length);
     
+    u32 gen = begin_write(tx);
+    u64 start_ns = ktime_get_ns();
+    trace_epaper_tx_frame_start(tx->id, count, 0);
+    
     for (int retry = 0; retry < MAX_RETRIES; retry++) {
-        ack_received = nack_received = false;
+        if (abort_pending(tx, gen, retry)) {
+            ret = -ECANCELED;
+            break;
+        }
+        if (retry > 0) count_retry(tx, retry, ret);
+        tx->ack_received = tx->nack_received = false;
         
-        ret = send_data_block((u8*)&header, sizeof(header));
+        ret = send_data_block(tx, (u8*)&header, sizeof(header));
         if (ret) {
             if (ret == -ETIMEDOUT || ret == -ECOMM) continue;
             break;
@@ -199,26 +475,39 @@ static ssize_t tx_write(struct file *file, const char __user *user_buffer, size_
         while (remaining > 0) {
             u32 chunk_size = min(remaining, (u32)MAX_CHUNK_SIZE);
             
-            ret = send_data_block(data_ptr + sent, chunk_size);
+            if (abort_requested(tx, gen)) {
+                send_abort_block(tx);
+                ret = -ECANCELED;
+                break;
+            }
+            
+            ret = send_data_block(tx, data_ptr + sent, chunk_size);
             if (ret) {
                 if (ret == -ETIMEDOUT || ret == -ECOMM) break;
                 break;
             }
+            atomic64_inc(&tx->stats.chunks);
             
             sent += chunk_size;
             remaining -= chunk_size;
         }
         
+        if (ret == -ECANCELED) break;
         if (ret) continue;
         
-        ret = send_data_block((u8*)&crc32_val, sizeof(crc32_val));
+        ret = send_data_block(tx, (u8*)&crc32_val, sizeof(crc32_val));
         if (ret == 0) {
             break;
         }
+        if (ret == -ECOMM) {
+            atomic64_inc(&tx->stats.crc_failures);
+        }
     }
     
+    record_frame(tx, ret, count, start_ns);
+    end_write(tx);
     kfree(buffer);
-    mutex_unlock(&tx_mutex);
+    mutex_unlock(&tx->lock);
     
     if (ret) {
         return ret;
@@ -227,113 +516,464 @@ static ssize_t tx_write(struct file *file, const char __user *user_buffer, size_
     }
 }
 
-static int tx_open(struct inode *inode, struct file *file) {
-    return 0;
+// Runs without the link lock so it can reach a write that is in progress
+static long tx_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    struct epaper_tx *tx = file->private_data;
+    
+    if (tx->removed) {
+        return -ENODEV;
+    }
+    switch (cmd) {
+    case EPAPER_TX_IOC_ABORT:
+        request_abort(tx);
+        return 0;
+    default:
+        return -ENOTTY;
+    }
+}
+
+static void tx_dev_release(struct device *dev) {
+    kfree(container_of(dev, struct epaper_tx, char_dev));
 }
 
-static int tx_release(struct inode *inode, struct file *file) {
+static int tx_open(struct inode *inode, struct file *file) {
+    struct epaper_tx *tx = container_of(inode->i_cdev, struct epaper_tx, cdev);
+    
+    if (tx->removed) {
+        return -ENODEV;
+    }
+    file->private_data = tx;
     return 0;
 }
 
 static const struct file_operations tx_fops = {
     .owner = THIS_MODULE,
     .open = tx_open,
-    .release = tx_release,
     .write = tx_write,
+    .unlocked_ioctl = tx_ioctl,
+};
+
+static u16 calculate_bond_checksum(struct bond_header *h) {
+    return (u16)(h->width + h->height + (h->data_length & 0xFFFF) + (h->data_length >> 16) +
+                 h->chunk_size + h->link_index + h->link_count + h->frame_id);
+}
+
+// Sends this link's share of a bonded frame: its header, chunks
+// link_index, link_index + link_count, ... and the CRC32 of those chunks
+static int send_stripe(struct bond_stripe *stripe) {
+    struct epaper_tx *tx = stripe->tx;
+    struct bond_header *bh = &stripe->header;
+    u32 step = (u32)bh->chunk_size * bh->link_count;
+    u32 first = (u32)bh->chunk_size * bh->link_index;
+    size_t bytes = sizeof(*bh);
+    u32 crc32_val = 0;
+    int ret = 0;
+    
+    for (u32 offset = first; offset < bh->data_length; offset += step) {
+        u32 length = min(bh->data_length - offset, (u32)bh->chunk_size);
+        crc32_val = crc32(crc32_val, stripe->data + offset, length);
+        bytes += length;
+    }
+    
+    u64 start_ns = ktime_get_ns();
+    trace_epaper_tx_frame_start(tx->id, bytes, 0);
+    for (int retry = 0; retry < MAX_RETRIES; retry++) {
+        if (abort_pending(tx, stripe->gen, retry)) {
+            ret = -ECANCELED;
+            break;
+        }
+        if (retry > 0) count_retry(tx, retry, ret);
+        tx->ack_received = tx->nack_received = false;
+        
+        ret = send_data_block(tx, (u8*)bh, sizeof(*bh));
+        if (ret) {
+            if (ret == -ETIMEDOUT || ret == -ECOMM) continue;
+            break;
+        }
+        
+        for (u32 offset = first; offset < bh->data_length; offset += step) {
+            if (abort_requested(tx, stripe->gen)) {
+                send_abort_block(tx);
+                ret = -ECANCELED;
+                break;
+            }
+            
+            ret = send_data_block(tx, (u8*)stripe->data + offset,
+                                  min(bh->data_length - offset, (u32)bh->chunk_size));
+            if (ret) break;
+            atomic64_inc(&tx->stats.chunks);
+        }
+        
+        if (ret == -ECANCELED) break;
+        if (ret) continue;
+        
+        ret = send_data_block(tx, (u8*)&crc32_val, sizeof(crc32_val));
+        if (ret == 0) {
+            break;
+        }
+        if (ret == -ECOMM) {
+            atomic64_inc(&tx->stats.crc_failures);
+        }
+    }
+    record_frame(tx, ret, bytes, start_ns);
+    return ret;
+}
+
+static void stripe_work(struct work_struct *work) {
+    struct bond_stripe *stripe = container_of(work, struct bond_stripe, work);
+    
+    stripe->ret = send_stripe(stripe);
+}
+
+static ssize_t bond_write(struct file *file, const char __user *user_buffer, size_t count, loff_t *pos) {
+    struct bond_stripe *stripes;
+    struct image_header header;
+    int num_links = 0, locked = 0;
+    u8 *buffer = NULL;
+    int ret = 0;
+    
+    if (count < sizeof(header) || count > MAX_IMAGE_SIZE + sizeof(header)) {
+        return -EINVAL;
+    }
+    
+    stripes = kcalloc(MAX_DEVICES, sizeof(*stripes), GFP_KERNEL);
+    if (!stripes) {
+        return -ENOMEM;
+    }
+    
+    mutex_lock(&tx_links_lock);
+    for (int id = 0; id < MAX_DEVICES; id++) {
+        if (!(bond_links & BIT(id))) continue;
+        if (!tx_links[id]) {
+            ret = -ENODEV;
+            break;
+        }
+        stripes[num_links++].tx = tx_links[id];
+    }
+    if (!ret && num_links == 0) {
+        ret = -ENODEV;
+    }
+    for (; !ret && locked < num_links; locked++) {
+        if (!mutex_trylock(&stripes[locked].tx->lock)) {
+            ret = -EBUSY;
+            break;
+        }
+    }
+    mutex_unlock(&tx_links_lock);
+    if (ret) goto out;
+    
+    buffer = kmalloc(count, GFP_KERNEL);
+    if (!buffer) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    if (copy_from_user(buffer, user_buffer, count)) {
+        ret = -EFAULT;
+        goto out;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    if (header.data_length != count - sizeof(header)) {
+        ret = -EINVAL;
+        goto out;
+    }
+    
+    dev_dbg(bond_device, "Bond write: %zu bytes over %d links\n", count, num_links);
+    
+    bond_frame_id++;
+    for (int i = 0; i < num_links; i++) {
+        struct bond_stripe *stripe = &stripes[i];
+        
+        stripe->data = buffer + sizeof(header);
+        stripe->header = (struct bond_header) {
+            .width = header.width,
+            .height = header.height,
+            .data_length = header.data_length,
+            .chunk_size = MAX_CHUNK_SIZE,
+            .link_index = i,
+            .link_count = num_links,
+            .frame_id = bond_frame_id,
+        };
+        stripe->header.header_checksum = calculate_bond_checksum(&stripe->header);
+        stripe->gen = begin_write(stripe->tx);
+        INIT_WORK(&stripe->work, stripe_work);
+        queue_work(system_unbound_wq, &stripe->work);
+    }
+    for (int i = 0; i < num_links; i++) {
+        flush_work(&stripes[i].work);
+        end_write(stripes[i].tx);
+        if (!ret) ret = stripes[i].ret;
+    }
+    
+out:
+    for (int i = 0; i < locked; i++) {
+        mutex_unlock(&stripes[i].tx->lock);
+    }
+    kfree(buffer);
+    kfree(stripes);
+    return ret ? ret : count;
+}
+
+static long bond_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    switch (cmd) {
+    case EPAPER_TX_IOC_ABORT:
+        mutex_lock(&tx_links_lock);
+        for (int id = 0; id < MAX_DEVICES; id++) {
+            if ((bond_links & BIT(id)) && tx_links[id]) {
+                request_abort(tx_links[id]);
+            }
+        }
+        mutex_unlock(&tx_links_lock);
+        return 0;
+    default:
+        return -ENOTTY;
+    }
+}
+
+static int bond_open(struct inode *inode, struct file *file) {
+    return 0;
+}
+
+static const struct file_operations bond_fops = {
+    .owner = THIS_MODULE,
+    .open = bond_open,
+    .write = bond_write,
+    .unlocked_ioctl = bond_ioctl,
+};
+
+#define TX_STAT_ATTR(name)                                                              \
+static ssize_t name##_show(struct device *dev, struct device_attribute *attr, char *buf) { \
+    struct epaper_tx *tx = dev_get_drvdata(dev);                                        \
+    return sysfs_emit(buf, "%lld\n", atomic64_read(&tx->stats.name));                   \
+}                                                                                       \
+static DEVICE_ATTR_RO(name)
+
+TX_STAT_ATTR(frames);
+TX_STAT_ATTR(frames_failed);
+TX_STAT_ATTR(bytes);
+TX_STAT_ATTR(chunks);
+TX_STAT_ATTR(retries_timeout);
+TX_STAT_ATTR(retries_nack);
+TX_STAT_ATTR(nacks);
+TX_STAT_ATTR(timeouts);
+TX_STAT_ATTR(crc_failures);
+TX_STAT_ATTR(aborts);
+TX_STAT_ATTR(last_frame_us);
+TX_STAT_ATTR(last_bits_per_sec);
+
+static struct attribute *tx_stats_attrs[] = {
+    &dev_attr_frames.attr,
+    &dev_attr_frames_failed.attr,
+    &dev_attr_bytes.attr,
+    &dev_attr_chunks.attr,
+    &dev_attr_retries_timeout.attr,
+    &dev_attr_retries_nack.attr,
+    &dev_attr_nacks.attr,
+    &dev_attr_timeouts.attr,
+    &dev_attr_crc_failures.attr,
+    &dev_attr_aborts.attr,
+    &dev_attr_last_frame_us.attr,
+    &dev_attr_last_bits_per_sec.attr,
+    NULL
+};
+
+// Appears as /sys/class/epaper_tx/epaper_txN/stats/
+static const struct attribute_group tx_stats_group = {
+    .name = "stats",
+    .attrs = tx_stats_attrs,
+};
+
+static const struct attribute_group *tx_groups[] = {
+    &tx_stats_group,
+    NULL
+};
+
+static int hist_show(struct seq_file *s, void *unused) {
+    struct epaper_hist *hist = s->private;
+    
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        s64 count = atomic64_read(&hist->buckets[i]);
+        if (!count) continue;
+        if (i == HIST_BUCKETS - 1) {
+            seq_printf(s, "%10llu ..            ns: %lld\n", 1ULL << i, count);
+        } else {
+            seq_printf(s, "%10llu .. %10llu ns: %lld\n", i ? 1ULL << i : 0,
+                       (1ULL << (i + 1)) - 1, count);
+        }
+    }
+    return 0;
+}
+
+static int hist_open(struct inode *inode, struct file *file) {
+    return single_open(file, hist_show, inode->i_private);
+}
+
+// Any write clears the histogram
+static ssize_t hist_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos) {
+    struct epaper_hist *hist = ((struct seq_file *)file->private_data)->private;
+    
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        atomic64_set(&hist->buckets[i], 0);
+    }
+    return count;
+}
+
+static const struct file_operations hist_fops = {
+    .owner = THIS_MODULE,
+    .open = hist_open,
+    .read = seq_read,
+    .write = hist_write,
+    .llseek = seq_lseek,
+    .release = single_release,
 };
 
 static int epaper_tx_probe(struct platform_device *pdev) {
+    struct epaper_tx *tx;
     int ret;
     
-    clock_gpio = devm_gpiod_get(&pdev->dev, "clock", GPIOD_OUT_LOW);
-    if (IS_ERR(clock_gpio)) {
-        dev_err(&pdev->dev, "Failed to get clock GPIO: %ld\n", PTR_ERR(clock_gpio));
-        return PTR_ERR(clock_gpio);
+    tx = kzalloc(sizeof(*tx), GFP_KERNEL);
+    if (!tx) {
+        return -ENOMEM;
     }
+    tx->dev = &pdev->dev;
+    mutex_init(&tx->lock);
+    init_waitqueue_head(&tx->response_waitqueue);
+    atomic_set(&tx->active_gen, 0);
+    atomic_set(&tx->abort_gen, 0);
     
-    data_gpio = devm_gpiod_get(&pdev->dev, "data", GPIOD_OUT_LOW);
-    if (IS_ERR(data_gpio)) {
-        dev_err(&pdev->dev, "Failed to get data GPIO: %ld\n", PTR_ERR(data_gpio));
-        return PTR_ERR(data_gpio);
+    tx->clock_gpio = devm_gpiod_get(&pdev->dev, "clock", GPIOD_OUT_LOW);
+    if (IS_ERR(tx->clock_gpio)) {
+        dev_err(&pdev->dev, "Failed to get clock GPIO: %ld\n", PTR_ERR(tx->clock_gpio));
+        ret = PTR_ERR(tx->clock_gpio);
+        goto err_free;
     }
     
-    start_stop_gpio = devm_gpiod_get(&pdev->dev, "start-stop", GPIOD_OUT_LOW);
-    if (IS_ERR(start_stop_gpio)) {
-        dev_err(&pdev->dev, "Failed to get start-stop GPIO: %ld\n", PTR_ERR(start_stop_gpio));
-        return PTR_ERR(start_stop_gpio);
+    tx->data_gpio = devm_gpiod_get(&pdev->dev, "data", GPIOD_OUT_LOW);
+    if (IS_ERR(tx->data_gpio)) {
+        dev_err(&pdev->dev, "Failed to get data GPIO: %ld\n", PTR_ERR(tx->data_gpio));
+        ret = PTR_ERR(tx->data_gpio);
+        goto err_free;
     }
     
-    ack_gpio = devm_gpiod_get(&pdev->dev, "ack", GPIOD_IN);
-    if (IS_ERR(ack_gpio)) {
-        dev_err(&pdev->dev, "Failed to get ack GPIO: %ld\n", PTR_ERR(ack_gpio));
-        return PTR_ERR(ack_gpio);
+    tx->start_stop_gpio = devm_gpiod_get(&pdev->dev, "start-stop", GPIOD_OUT_LOW);
+    if (IS_ERR(tx->start_stop_gpio)) {
+        dev_err(&pdev->dev, "Failed to get start-stop GPIO: %ld\n", PTR_ERR(tx->start_stop_gpio));
+        ret = PTR_ERR(tx->start_stop_gpio);
+        goto err_free;
     }
     
-    nack_gpio = devm_gpiod_get(&pdev->dev, "nack", GPIOD_IN);
-    if (IS_ERR(nack_gpio)) {
-        dev_err(&pdev->dev, "Failed to get nack GPIO: %ld\n", PTR_ERR(nack_gpio));
-        return PTR_ERR(nack_gpio);
+    tx->ack_gpio = devm_gpiod_get(&pdev->dev, "ack", GPIOD_IN);
+    if (IS_ERR(tx->ack_gpio)) {
+        dev_err(&pdev->dev, "Failed to get ack GPIO: %ld\n", PTR_ERR(tx->ack_gpio));
+        ret = PTR_ERR(tx->ack_gpio);
+        goto err_free;
     }
     
-    ack_irq = gpiod_to_irq(ack_gpio);
-    if (ack_irq < 0) return ack_irq;
+    tx->nack_gpio = devm_gpiod_get(&pdev->dev, "nack", GPIOD_IN);
+    if (IS_ERR(tx->nack_gpio)) {
+        dev_err(&pdev->dev, "Failed to get nack GPIO: %ld\n", PTR_ERR(tx->nack_gpio));
+        ret = PTR_ERR(tx->nack_gpio);
+        goto err_free;
+    }
     
-    nack_irq = gpiod_to_irq(nack_gpio);
-    if (nack_irq < 0) return nack_irq;
+    tx->ack_irq = gpiod_to_irq(tx->ack_gpio);
+    if (tx->ack_irq < 0) {
+        ret = tx->ack_irq;
+        goto err_free;
+    }
     
-    ret = request_irq(ack_irq, ack_irq_handler, IRQF_TRIGGER_RISING, 
-                      "epaper_tx_ack", NULL);
-    if (ret) return ret;
+    tx->nack_irq = gpiod_to_irq(tx->nack_gpio);
+    if (tx->nack_irq < 0) {
+        ret = tx->nack_irq;
+        goto err_free;
+    }
     
-    ret = request_irq(nack_irq, nack_irq_handler, IRQF_TRIGGER_RISING, 
-                      "epaper_tx_nack", NULL);
-    if (ret) {
-        free_irq(ack_irq, NULL);
-        return ret;
+    tx->id = ida_alloc_max(&tx_ida, MAX_DEVICES - 1, GFP_KERNEL);
+    if (tx->id < 0) {
+        dev_err(&pdev->dev, "No free minor (at most %d links)\n", MAX_DEVICES);
+        ret = tx->id;
+        goto err_free;
     }
+    tx->devt = MKDEV(MAJOR(tx_base), tx->id);
+    
+    ret = request_irq(tx->ack_irq, ack_irq_handler, IRQF_TRIGGER_RISING, 
+                      dev_name(&pdev->dev), tx);
+    if (ret) goto err_ida;
     
-    ret = alloc_chrdev_region(&dev_num, 0, 1, DEVICE_NAME);
+    ret = request_irq(tx->nack_irq, nack_irq_handler, IRQF_TRIGGER_RISING, 
+                      dev_name(&pdev->dev), tx);
+    if (ret) goto err_ack_irq;
+    
+    cdev_init(&tx->cdev, &tx_fops);
+    tx->cdev.owner = THIS_MODULE;
+    
+    // From here on the struct belongs to char_dev and is freed by its release
+    device_initialize(&tx->char_dev);
+    tx->char_dev.class = tx_class;
+    tx->char_dev.parent = &pdev->dev;
+    tx->char_dev.devt = tx->devt;
+    tx->char_dev.groups = tx_groups;
+    tx->char_dev.release = tx_dev_release;
+    dev_set_drvdata(&tx->char_dev, tx);
+    ret = dev_set_name(&tx->char_dev, DEVICE_NAME "%d", tx->id);
     if (ret) goto err_irq;
     
-    cdev_init(&tx_cdev, &tx_fops);
-    ret = cdev_add(&tx_cdev, dev_num, 1);
-    if (ret) goto err_chrdev;
+    ret = cdev_device_add(&tx->cdev, &tx->char_dev);
+    if (ret) goto err_irq;
     
-    tx_class = class_create(CLASS_NAME);
-    if (IS_ERR(tx_class)) {
-        ret = PTR_ERR(tx_class);
-        goto err_cdev;
-    }
+    mutex_lock(&tx_links_lock);
+    tx_links[tx->id] = tx;
+    mutex_unlock(&tx_links_lock);
     
-    tx_device = device_create(tx_class, NULL, dev_num, NULL, DEVICE_NAME);
-    if (IS_ERR(tx_device)) {
-        ret = PTR_ERR(tx_device);
-        goto err_class;
-    }
+    // debugfs is best effort, a failure only loses the histograms
+    tx->debugfs = debugfs_create_dir(dev_name(&tx->char_dev), tx_debugfs);
+    debugfs_create_file("ack_latency", 0644, tx->debugfs, &tx->ack_latency, &hist_fops);
+    debugfs_create_file("bit_period", 0644, tx->debugfs, &tx->bit_period, &hist_fops);
+    debugfs_create_file("recovery", 0644, tx->debugfs, &tx->recovery, &hist_fops);
     
-    pr_info("E-paper TX driver loaded successfully\n");
+    struct dentry *inject = debugfs_create_dir("inject", tx->debugfs);
+    debugfs_create_u32("ber_ppb", 0644, inject, &tx->faults.ber_ppb);
+    debugfs_create_u32("truncate_ppm", 0644, inject, &tx->faults.truncate_ppm);
+    debugfs_create_u64("injected", 0644, inject, &tx->faults.injected);
+    
+    platform_set_drvdata(pdev, tx);
+    dev_info(&pdev->dev, "E-paper TX link %d ready as /dev/" DEVICE_NAME "%d\n", tx->id, tx->id);
     return 0;
     
-err_class:
-    class_destroy(tx_class);
-err_cdev:
-    cdev_del(&tx_cdev);
-err_chrdev:
-    unregister_chrdev_region(dev_num, 1);
 err_irq:
-    free_irq(nack_irq, NULL);
-    free_irq(ack_irq, NULL);
+    free_irq(tx->nack_irq, tx);
+err_ack_irq:
+    free_irq(tx->ack_irq, tx);
+err_ida:
+    ida_free(&tx_ida, tx->id);
+err_free:
+    if (tx->char_dev.release) {
+        put_device(&tx->char_dev);
+    } else {
+        kfree(tx);
+    }
     return ret;
 }
 
 static void epaper_tx_remove(struct platform_device *pdev) {
-    device_destroy(tx_class, dev_num);
-    class_destroy(tx_class);
-    cdev_del(&tx_cdev);
-    unregister_chrdev_region(dev_num, 1);
-    free_irq(nack_irq, NULL);
-    free_irq(ack_irq, NULL);
-    pr_info("E-paper TX driver unloaded\n");
+    struct epaper_tx *tx = platform_get_drvdata(pdev);
+    
+    mutex_lock(&tx_links_lock);
+    tx_links[tx->id] = NULL;
+    mutex_unlock(&tx_links_lock);
+    // Files left open see -ENODEV from here on; a write in progress is cut
+    // short at its next chunk and waited for
+    tx->removed = true;
+    request_abort(tx);
+    mutex_lock(&tx->lock);
+    mutex_unlock(&tx->lock);
+    
+    debugfs_remove_recursive(tx->debugfs);
+    cdev_device_del(&tx->cdev, &tx->char_dev);
+    free_irq(tx->nack_irq, tx);
+    free_irq(tx->ack_irq, tx);
+    ida_free(&tx_ida, tx->id);
+    dev_info(&pdev->dev, "E-paper TX link %d removed\n", tx->id);
+    put_device(&tx->char_dev);
 }
 
 static struct platform_driver epaper_tx_driver = {
@@ -345,7 +985,73 @@ static struct platform_driver epaper_tx_driver = {
     },
 };
 
-module_platform_driver(epaper_tx_driver);
+// The class and the minor range are shared by every link, so they are set
+// up once here rather than in probe()
+static int __init epaper_tx_init(void) {
+    int ret;
+    
+    // Minor MAX_DEVICES is the bond device
+    ret = alloc_chrdev_region(&tx_base, 0, MAX_DEVICES + 1, DEVICE_NAME);
+    if (ret) return ret;
+    
+    tx_class = class_create(CLASS_NAME);
+    if (IS_ERR(tx_class)) {
+        ret = PTR_ERR(tx_class);
+        goto err_chrdev;
+    }
+    
+    if (bond_links) {
+        dev_t devt = MKDEV(MAJOR(tx_base), MAX_DEVICES);
+        
+        cdev_init(&bond_cdev, &bond_fops);
+        bond_cdev.owner = THIS_MODULE;
+        ret = cdev_add(&bond_cdev, devt, 1);
+        if (ret) goto err_class;
+        
+        bond_device = device_create(tx_class, NULL, devt, NULL, BOND_DEVICE_NAME);
+        if (IS_ERR(bond_device)) {
+            ret = PTR_ERR(bond_device);
+            cdev_del(&bond_cdev);
+            goto err_class;
+        }
+    }
+    
+    tx_debugfs = debugfs_create_dir(CLASS_NAME, NULL);
+    
+    ret = platform_driver_register(&epaper_tx_driver);
+    if (ret) goto err_bond;
+    
+    pr_info("E-paper TX driver loaded successfully\n");
+    return 0;
+    
+err_bond:
+    debugfs_remove_recursive(tx_debugfs);
+    if (bond_links) {
+        device_destroy(tx_class, MKDEV(MAJOR(tx_base), MAX_DEVICES));
+        cdev_del(&bond_cdev);
+    }
+err_class:
+    class_destroy(tx_class);
+err_chrdev:
+    unregister_chrdev_region(tx_base, MAX_DEVICES + 1);
+    return ret;
+}
+
+static void __exit epaper_tx_exit(void) {
+    if (bond_links) {
+        device_destroy(tx_class, MKDEV(MAJOR(tx_base), MAX_DEVICES));
+        cdev_del(&bond_cdev);
+    }
+    platform_driver_unregister(&epaper_tx_driver);
+    debugfs_remove_recursive(tx_debugfs);
+    class_destroy(tx_class);
+    unregister_chrdev_region(tx_base, MAX_DEVICES + 1);
+    ida_destroy(&tx_ida);
+    pr_info("E-paper TX driver unloaded\n");
+}
+
+module_init(epaper_tx_init);
+module_exit(epaper_tx_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jeon Mingyu");
@@ -0,0 +1,116 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM epaper_tx
+
+#if !defined(_TX_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TX_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// Frame and block boundaries on the TX side. Pairing block_start with
+// block_end gives the bit time of a block, block_end with response the
+// receiver's ACK round trip.
+
+DECLARE_EVENT_CLASS(epaper_tx_frame,
+    TP_PROTO(int link, size_t bytes, int ret),
+    TP_ARGS(link, bytes, ret),
+    TP_STRUCT__entry(
+        __field(int, link)
+        __field(size_t, bytes)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->link = link;
+        __entry->bytes = bytes;
+        __entry->ret = ret;
+    ),
+    TP_printk("link=%d bytes=%zu ret=%d", __entry->link, __entry->bytes, __entry->ret)
+);
+
+DEFINE_EVENT(epaper_tx_frame, epaper_tx_frame_start,
+    TP_PROTO(int link, size_t bytes, int ret),
+    TP_ARGS(link, bytes, ret)
+);
+
+DEFINE_EVENT(epaper_tx_frame, epaper_tx_frame_end,
+    TP_PROTO(int link, size_t bytes, int ret),
+    TP_ARGS(link, bytes, ret)
+);
+
+DECLARE_EVENT_CLASS(epaper_tx_block,
+    TP_PROTO(int link, size_t bytes),
+    TP_ARGS(link, bytes),
+    TP_STRUCT__entry(
+        __field(int, link)
+        __field(size_t, bytes)
+    ),
+    TP_fast_assign(
+        __entry->link = link;
+        __entry->bytes = bytes;
+    ),
+    TP_printk("link=%d bytes=%zu", __entry->link, __entry->bytes)
+);
+
+DEFINE_EVENT(epaper_tx_block, epaper_tx_block_start,
+    TP_PROTO(int link, size_t bytes),
+    TP_ARGS(link, bytes)
+);
+
+DEFINE_EVENT(epaper_tx_block, epaper_tx_block_end,
+    TP_PROTO(int link, size_t bytes),
+    TP_ARGS(link, bytes)
+);
+
+// ret: 0 = ACK, -ECOMM = NACK, -ETIMEDOUT = no answer
+TRACE_EVENT(epaper_tx_response,
+    TP_PROTO(int link, int ret),
+    TP_ARGS(link, ret),
+    TP_STRUCT__entry(
+        __field(int, link)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->link = link;
+        __entry->ret = ret;
+    ),
+    TP_printk("link=%d %s", __entry->link,
+              __entry->ret == 0 ? "ack" : __entry->ret == -ECOMM ? "nack" : "timeout")
+);
+
+// The ACK/NACK edge itself, from the IRQ handler
+TRACE_EVENT(epaper_tx_response_irq,
+    TP_PROTO(int link, bool nack),
+    TP_ARGS(link, nack),
+    TP_STRUCT__entry(
+        __field(int, link)
+        __field(bool, nack)
+    ),
+    TP_fast_assign(
+        __entry->link = link;
+        __entry->nack = nack;
+    ),
+    TP_printk("link=%d %s", __entry->link, __entry->nack ? "nack" : "ack")
+);
+
+TRACE_EVENT(epaper_tx_retry,
+    TP_PROTO(int link, int attempt, int cause),
+    TP_ARGS(link, attempt, cause),
+    TP_STRUCT__entry(
+        __field(int, link)
+        __field(int, attempt)
+        __field(int, cause)
+    ),
+    TP_fast_assign(
+        __entry->link = link;
+        __entry->attempt = attempt;
+        __entry->cause = cause;
+    ),
+    TP_printk("link=%d attempt=%d cause=%d", __entry->link, __entry->attempt, __entry->cause)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE tx_trace
+#include <trace/define_trace.h>